@@ -0,0 +1,139 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "byte_source.h"
+
+// Helpers shared by the host benchmarks (see run.sh). Timings are wall
+// clock on the build machine: compare the rows of one run against each
+// other, not against the ESP32.
+namespace bench
+{
+    // Bytes allocated right now (operator new and heap_caps_*)
+    size_t heapInUse();
+
+    // Start a new high-water mark at the current use; returns it
+    size_t resetHeapPeak();
+
+    // Most bytes allocated at once since resetHeapPeak()
+    size_t heapHighWater();
+
+    // Whether xTaskCreatePinnedToCore() starts tasks (a thread each) or
+    // fails, as it does on a device out of memory
+    bool tasksEnabled();
+    void enableTasks(bool on);
+
+    // Milliseconds on a monotonic clock
+    inline double nowMs()
+    {
+        using namespace std::chrono;
+        return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Fastest of runs calls of f, in ms (the least disturbed by the OS)
+    template <typename F>
+    double fastest(int runs, F &&f)
+    {
+        double best = 1e300;
+        for (int i = 0; i < runs; i++)
+        {
+            double t0 = nowMs();
+            f();
+            best = std::min(best, nowMs() - t0);
+        }
+        return best;
+    }
+
+    // Whole file, or empty if it can't be read
+    inline std::vector<uint8_t> readFile(const std::string &path)
+    {
+        std::vector<uint8_t> data;
+        if (FILE *f = fopen(path.c_str(), "rb"))
+        {
+            uint8_t block[65536];
+            for (size_t n; (n = fread(block, 1, sizeof(block), f)) > 0;)
+                data.insert(data.end(), block, block + n);
+            fclose(f);
+        }
+        return data;
+    }
+
+    // File name without its directory
+    inline std::string baseName(const std::string &path)
+    {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    // A body already downloaded; remaining() hands it out like a
+    // DownloadBuffer whose fetch task has finished, when allowed
+    class MemorySource : public ByteSource
+    {
+    public:
+        MemorySource(const std::vector<uint8_t> &data, bool inMemory = true)
+            : data(data), inMemory(inMemory)
+        {
+        }
+
+        size_t read(uint8_t *dst, size_t len) override
+        {
+            len = std::min(len, data.size() - pos);
+            memcpy(dst, data.data() + pos, len);
+            pos += len;
+            return len;
+        }
+
+        const uint8_t *remaining(size_t &len) override
+        {
+            len = inMemory ? data.size() - pos : 0;
+            return inMemory ? data.data() + pos : nullptr;
+        }
+
+    private:
+        const std::vector<uint8_t> &data;
+        size_t pos = 0;
+        bool inMemory;
+    };
+
+    // Binary PPM (RGB) or PGM (gray) file: pixels, size and channels;
+    // false if it isn't one
+    inline bool readPnm(const std::string &path, std::vector<uint8_t> &pixels, int &width, int &height,
+                        int &channels)
+    {
+        FILE *f = fopen(path.c_str(), "rb");
+        if (!f)
+            return false;
+        int type = 0, max = 0;
+        bool ok = fscanf(f, "P%d %d %d %d", &type, &width, &height, &max) == 4 && (type == 5 || type == 6) &&
+                  max == 255 && width > 0 && height > 0 && fgetc(f) != EOF;
+        if (ok)
+        {
+            channels = type == 6 ? 3 : 1;
+            pixels.resize((size_t)width * height * channels);
+            ok = fread(pixels.data(), 1, pixels.size(), f) == pixels.size();
+        }
+        fclose(f);
+        return ok;
+    }
+
+    // Binary PPM (RGB) or PGM (gray) file
+    inline bool writePnm(const std::string &path, int width, int height, int channels, const uint8_t *pixels)
+    {
+        FILE *f = fopen(path.c_str(), "wb");
+        if (!f)
+            return false;
+        fprintf(f, "P%d\n%d %d\n255\n", channels == 3 ? 6 : 5, width, height);
+        fwrite(pixels, 1, (size_t)width * height * channels, f);
+        return fclose(f) == 0;
+    }
+}
+
+#endif
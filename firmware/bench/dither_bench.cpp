@@ -0,0 +1,206 @@
+// Dithering cost and quality: every mode of dither::Ditherer over whole
+// images, row by row as the decoders feed it. The Inkplate 10 gets luma (as
+// the JPEG decoder hands it over) in 3-bit and 1-bit mode, the 6COLOR gets
+// RGB.
+//
+// Cost is ns per pixel. Quality is the mean CIELAB difference (deltaE 1976)
+// between the input and the panel's rendering of the output, both blurred
+// in linear light first as the eye blurs the dots at reading distance: the
+// lower, the closer the panel gets. With -o, each output is also written
+// there as a PPM in the ink colors for a side by side look.
+//
+//   dither_bench [-o dir] image.ppm...
+
+#include <Arduino.h>
+#include <cmath>
+
+#include "bench.h"
+#include "dither.h"
+
+static constexpr int RUNS = 15;
+
+static const dither::Mode MODES[] = {dither::Mode::NONE, dither::Mode::FLOYD_STEINBERG, dither::Mode::ATKINSON,
+                                     dither::Mode::SIERRA_LITE, dither::Mode::ORDERED};
+
+#ifdef ARDUINO_INKPLATECOLOR
+// RGB the panel shows for each ink id, as dither.cpp assumes
+static const uint8_t INKS[][3] = {
+    {0, 0, 0}, {255, 255, 255}, {67, 138, 28}, {42, 42, 126}, {190, 60, 42}, {255, 222, 51}, {220, 112, 40},
+};
+#endif
+
+// Box blur radius in pixels, applied twice (close to a Gaussian of sigma
+// 1.4: about what the eye merges of a 0.2 mm dot pitch at 40 cm)
+static constexpr int BLUR_RADIUS = 2;
+
+// Quantize a whole image
+static void ditherImage(const std::vector<uint8_t> &pixels, int width, int height, int channels, dither::Mode mode,
+                        bool bilevel, std::vector<uint8_t> &out)
+{
+    dither::Ditherer ditherer;
+    ditherer.begin(mode, width, 0, dither::panelTone(), bilevel);
+    for (int y = 0; y < height; y++)
+        ditherer.row(&pixels[(size_t)y * width * channels], channels, &out[(size_t)y * width]);
+    ditherer.end();
+}
+
+// What the panel shows for the output, as RGB
+static std::vector<uint8_t> render(const std::vector<uint8_t> &out)
+{
+    std::vector<uint8_t> rgb(out.size() * 3);
+    for (size_t p = 0; p < out.size(); p++)
+    {
+#ifdef ARDUINO_INKPLATECOLOR
+        memcpy(&rgb[p * 3], INKS[out[p]], 3);
+#else
+        memset(&rgb[p * 3], out[p] * 255 / 7, 3);
+#endif
+    }
+    return rgb;
+}
+
+// One pass of a box blur along rows or along columns
+static void boxBlur(std::vector<float> &plane, int width, int height, bool columns)
+{
+    int lines = columns ? width : height, length = columns ? height : width;
+    size_t step = columns ? width : 1, next = columns ? 1 : width;
+    std::vector<float> line(length);
+    for (int l = 0; l < lines; l++)
+    {
+        float *p = &plane[l * next];
+        for (int i = 0; i < length; i++)
+            line[i] = p[i * step];
+        for (int i = 0; i < length; i++)
+        {
+            float sum = 0;
+            for (int k = -BLUR_RADIUS; k <= BLUR_RADIUS; k++)
+                sum += line[std::min(std::max(i + k, 0), length - 1)];
+            p[i * step] = sum / (2 * BLUR_RADIUS + 1);
+        }
+    }
+}
+
+// RGB blurred in linear light, as CIELAB (D65), 3 floats per pixel
+static std::vector<float> blurredLab(const std::vector<uint8_t> &rgb, int width, int height)
+{
+    size_t n = (size_t)width * height;
+    std::vector<float> planes[3];
+    for (int ch = 0; ch < 3; ch++)
+    {
+        planes[ch].resize(n);
+        for (size_t p = 0; p < n; p++)
+        {
+            float v = rgb[p * 3 + ch] / 255.0f;
+            planes[ch][p] = v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int pass = 0; pass < 2; pass++)
+        {
+            boxBlur(planes[ch], width, height, false);
+            boxBlur(planes[ch], width, height, true);
+        }
+    }
+
+    auto f = [](float t) { return t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.0f / 116; };
+    std::vector<float> lab(n * 3);
+    for (size_t p = 0; p < n; p++)
+    {
+        float r = planes[0][p], g = planes[1][p], b = planes[2][p];
+        float fx = f((0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.9505f);
+        float fy = f(0.2126f * r + 0.7152f * g + 0.0722f * b);
+        float fz = f((0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.089f);
+        lab[p * 3] = 116 * fy - 16;
+        lab[p * 3 + 1] = 500 * (fx - fy);
+        lab[p * 3 + 2] = 200 * (fy - fz);
+    }
+    return lab;
+}
+
+// Mean deltaE 1976 between two CIELAB images
+static double meanDeltaE(const std::vector<float> &a, const std::vector<float> &b)
+{
+    double sum = 0;
+    for (size_t i = 0; i < a.size(); i += 3)
+        sum += std::sqrt(std::pow(a[i] - b[i], 2) + std::pow(a[i + 1] - b[i + 1], 2) +
+                         std::pow(a[i + 2] - b[i + 2], 2));
+    return sum / (a.size() / 3);
+}
+
+int main(int argc, char **argv)
+{
+    const char *outDir = nullptr;
+    int first = 1;
+    if (argc > 2 && !strcmp(argv[1], "-o"))
+    {
+        outDir = argv[2];
+        first = 3;
+    }
+    if (argc <= first)
+    {
+        fprintf(stderr, "usage: %s [-o dir] image.ppm...\n", argv[0]);
+        return 1;
+    }
+
+#ifdef ARDUINO_INKPLATECOLOR
+    const bool bilevels[] = {false};
+    const int channels = 3;
+#else
+    const bool bilevels[] = {false, true};
+    const int channels = 1;
+#endif
+
+    printf("ns per pixel (fastest of %d) / mean deltaE of the blurred output\n\n%-24s %-6s", RUNS, "image", "panel");
+    for (dither::Mode mode : MODES)
+        printf("  %14s", dither::name(mode));
+    printf("\n");
+
+    for (int i = first; i < argc; i++)
+    {
+        std::string name = bench::baseName(argv[i]);
+        std::vector<uint8_t> pixels;
+        int width, height, got;
+        if (!bench::readPnm(argv[i], pixels, width, height, got))
+        {
+            printf("%-24s not a binary PPM or PGM\n", name.c_str());
+            continue;
+        }
+
+        // The channels this panel's decoder delivers, and the same as RGB
+        std::vector<uint8_t> input((size_t)width * height * channels), seen((size_t)width * height * 3);
+        for (size_t p = 0; p < (size_t)width * height; p++)
+        {
+            const uint8_t *px = &pixels[p * got];
+            if (channels == got)
+                memcpy(&input[p * channels], px, channels);
+            else if (channels == 1)
+                input[p] = (px[0] * 77 + px[1] * 150 + px[2] * 29) >> 8;
+            else
+                memset(&input[p * channels], px[0], channels);
+            for (int ch = 0; ch < 3; ch++)
+                seen[p * 3 + ch] = input[p * channels + (channels == 3 ? ch : 0)];
+        }
+        std::vector<float> reference = blurredLab(seen, width, height);
+
+        std::vector<uint8_t> out((size_t)width * height);
+        for (bool bilevel : bilevels)
+        {
+            const char *panel = channels == 3 ? "color" : bilevel ? "1-bit" : "3-bit";
+            printf("%-24s %-6s", name.c_str(), panel);
+            for (dither::Mode mode : MODES)
+            {
+                double ms =
+                    bench::fastest(RUNS, [&] { ditherImage(input, width, height, channels, mode, bilevel, out); });
+                std::vector<uint8_t> shown = render(out);
+                double deltaE = meanDeltaE(reference, blurredLab(shown, width, height));
+                printf("  %6.2f / %5.2f", ms * 1e6 / ((double)width * height), deltaE);
+                if (outDir)
+                {
+                    std::string stem = name.substr(0, name.rfind('.'));
+                    bench::writePnm(std::string(outDir) + "/" + stem + "_" + panel + "_" + dither::name(mode) + ".ppm",
+                                    width, height, 3, shown.data());
+                }
+            }
+            printf("\n");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,261 @@
+// Receive path: the DownloadBuffer (socket reads straight into one region)
+// against the readStream() it replaced (256-byte stack chunks appended to a
+// growing std::vector), over identity and chunked bodies from a socket that
+// always has a TCP window of data ready. Reports bytes/s and peak heap.
+//
+//   download_bench [body KiB ...]
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <esp32/rom/crc.h>
+
+#include "bench.h"
+#include "definitions.h"
+#include "download_buffer.h"
+#include "http_stream.h"
+
+// lwIP's default receive window on the ESP32
+static constexpr size_t TCP_WINDOW = 5744;
+
+// Chunk size of the Worker's streamed responses
+static constexpr size_t CHUNK = 4096;
+
+// A socket replaying a response body from memory
+class ReplayClient : public WiFiClient
+{
+public:
+    explicit ReplayClient(const std::vector<uint8_t> &wire) : wire(wire) {}
+
+    int available() override { return std::min(wire.size() - pos, TCP_WINDOW); }
+    uint8_t connected() override { return pos < wire.size(); }
+    int read(uint8_t *dst, size_t len) override
+    {
+        calls++;
+        len = std::min<size_t>(len, available());
+        memcpy(dst, wire.data() + pos, len);
+        pos += len;
+        return len;
+    }
+
+    // Socket reads issued; each is a trip through lwIP on the device
+    size_t calls = 0;
+
+private:
+    const std::vector<uint8_t> &wire;
+    size_t pos = 0;
+};
+
+// readStream() as networking.cpp had it before the DownloadBuffer
+static std::vector<uint8_t> readStream(WiFiClient &stream, unsigned long timeoutMillis, bool isChunked,
+                                       size_t contentLength)
+{
+    std::vector<uint8_t> out;
+    unsigned long start = millis();
+    unsigned long deadline = start + timeoutMillis;
+
+    // Reserve memory if size is known to avoid reallocations
+    if (!isChunked && contentLength > 0)
+    {
+        out.reserve(contentLength);
+    }
+
+    // Buffer for reading data
+    constexpr size_t BUF_SIZE = 256;
+    uint8_t buf[BUF_SIZE];
+
+    // Read loop
+    while (millis() < deadline)
+    {
+        // Check availability
+        if (stream.available() <= 0)
+        {
+            if (!stream.connected())
+                break;
+            delay(5);
+            continue;
+        }
+
+        // Handle standard (non-chunked) transfer
+        if (!isChunked)
+        {
+            // Determine how much to read
+            size_t want = (contentLength > 0)
+                              ? min<size_t>({BUF_SIZE, (size_t)stream.available(), contentLength - out.size()})
+                              : min<size_t>(BUF_SIZE, (size_t)stream.available());
+
+            // Read data and append to output vector
+            int n = stream.readBytes(buf, want);
+            if (n > 0)
+            {
+                out.insert(out.end(), buf, buf + n);
+                // Reset timeout on successful read
+                deadline = millis() + timeoutMillis;
+            }
+
+            // Stop if we have read the expected length
+            if (contentLength > 0 && out.size() >= contentLength)
+                break;
+        }
+        // Handle chunked transfer
+        else
+        {
+            // Buffer for reading the hex-size line
+            constexpr size_t LINE_BUF = 32;
+            char line[LINE_BUF];
+
+            // Read chunk-size line (up to '\n')
+            int len = stream.readBytesUntil('\n', (uint8_t *)line, LINE_BUF - 1);
+            if (len <= 0)
+                break;
+            line[len] = '\0';
+
+            // Strip any trailing '\r'
+            if (char *cr = strchr(line, '\r'))
+                *cr = '\0';
+
+            // Parse hex length from the line
+            size_t chunkSize = strtoul(line, nullptr, 16);
+            // Size 0 indicates end of chunks
+            if (chunkSize == 0)
+                break;
+
+            size_t remaining = chunkSize;
+            // Read the chunk data
+            while (remaining && millis() < deadline)
+            {
+                size_t toRead = min<size_t>(remaining, BUF_SIZE);
+                int n = stream.readBytes(buf, toRead);
+                if (n <= 0)
+                    break;
+
+                out.insert(out.end(), buf, buf + n);
+                remaining -= n;
+                deadline = millis() + timeoutMillis;
+            }
+
+            // Consume the trailing CRLF after the chunk data
+            if (stream.available() >= 2)
+            {
+                char discard[2];
+                stream.readBytes((uint8_t *)discard, 2);
+            }
+            else
+            {
+                stream.readBytesUntil('\n', (uint8_t *)line, LINE_BUF - 1);
+            }
+        }
+    }
+    return out;
+}
+
+// A body as it comes off the wire, with or without chunked framing
+static std::vector<uint8_t> frame(const std::vector<uint8_t> &body, bool chunked)
+{
+    if (!chunked)
+        return body;
+    std::vector<uint8_t> wire;
+    for (size_t pos = 0; pos < body.size(); pos += CHUNK)
+    {
+        size_t n = std::min(CHUNK, body.size() - pos);
+        char line[16];
+        int len = snprintf(line, sizeof(line), "%zx\r\n", n);
+        wire.insert(wire.end(), line, line + len);
+        wire.insert(wire.end(), body.begin() + pos, body.begin() + pos + n);
+        wire.insert(wire.end(), {'\r', '\n'});
+    }
+    const char *last = "0\r\n\r\n";
+    wire.insert(wire.end(), last, last + strlen(last));
+    return wire;
+}
+
+struct Run
+{
+    double ms;
+    size_t peak;
+    size_t reads;
+    bool ok;
+};
+
+// Time one way of receiving a body and note the heap it took at its peak;
+// receive(client) returns whether the body came out intact
+template <typename F>
+static Run measure(const std::vector<uint8_t> &wire, F &&receive)
+{
+    Run run = {1e300, 0, 0, true};
+    for (int i = 0; i < 5; i++)
+    {
+        ReplayClient client(wire);
+        size_t base = bench::resetHeapPeak();
+        double t0 = bench::nowMs();
+        run.ok &= receive(client);
+        run.ms = std::min(run.ms, bench::nowMs() - t0);
+        run.peak = bench::heapHighWater() - base;
+        run.reads = client.calls;
+    }
+    return run;
+}
+
+static void report(const char *name, size_t bytes, const Run &run)
+{
+    printf("  %-28s %8.1f MB/s %9zu B peak heap %6zu socket reads%s\n", name, bytes / run.ms / 1000, run.peak,
+           run.reads, run.ok ? "" : "  (BODY MISMATCH)");
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<size_t> sizes = {60, 250, 1024};
+    if (argc > 1)
+        sizes.clear();
+    for (int i = 1; i < argc; i++)
+        sizes.push_back(strtoul(argv[i], nullptr, 10));
+
+    for (size_t kib : sizes)
+    {
+        std::vector<uint8_t> body(kib * 1024);
+        uint32_t seed = 1;
+        for (uint8_t &b : body)
+            b = (seed = seed * 1103515245 + 12345) >> 16;
+
+        for (bool chunked : {false, true})
+        {
+            std::vector<uint8_t> wire = frame(body, chunked);
+            size_t length = chunked ? 0 : body.size();
+            printf("%zu KiB body, %s:\n", kib, chunked ? "chunked" : "Content-Length");
+
+            report("readStream()", body.size(), measure(wire, [&](ReplayClient &client) {
+                       return readStream(client, 1500, chunked, length) == body;
+                   }));
+
+            // Drained in place, as the JPEG and QOI decoders do; once inline
+            // and once with the fetch task on the other core
+            for (bool producer : {false, true})
+            {
+                report(producer ? "DownloadBuffer, fetch task" : "DownloadBuffer, inline", body.size(),
+                       measure(wire, [&](ReplayClient &client) {
+                           HttpBodyStream stream(client, 1500, chunked, length);
+                           DownloadBuffer download;
+                           download.reserve(length, DOWNLOAD_BUFFER_SIZE);
+                           download.begin(stream);
+                           if (producer)
+                               download.startProducer();
+                           bool same = true;
+                           size_t pos = 0, avail;
+                           while (const uint8_t *data = download.peek(avail))
+                           {
+                               same &= pos + avail <= body.size() && !memcmp(data, &body[pos], avail);
+                               pos += avail;
+                               download.consume(avail);
+                           }
+                           download.cancel();
+                           return same && pos == body.size();
+                       }));
+            }
+        }
+
+        // The DownloadBuffer also hashes what it receives for the frame
+        // hash, which readStream() didn't; this is that share on its own
+        double crcMs = bench::fastest(5, [&] { crc32_le(0, body.data(), body.size()); });
+        printf("  %-28s %8.1f MB/s\n", "crc32_le() alone", body.size() / crcMs / 1000);
+    }
+    return 0;
+}
@@ -0,0 +1,120 @@
+// Framebuffer writes: framebuffer::writeRows() against the library's
+// per-pixel drawPixel(), for a full screen of dithered colors drawn in
+// 16-row bands (a 4:2:0 JPEG's MCU rows) at the build's ROTATION, in 3-bit
+// and 1-bit mode. Both must leave the same framebuffer. In portrait, the
+// 3-bit writer is also timed against the one it replaced, which swept down
+// the framebuffer once per row pair.
+//
+//   framebuffer_bench [band rows]
+
+#include <Arduino.h>
+#include <Inkplate.h>
+
+#include "bench.h"
+#include "framebuffer.h"
+
+static constexpr int RUNS = 25;
+
+// The portrait writer before bands were written transposed, for the row
+// pairs of bands starting on an even row at x = 0 (as drawScreen() makes)
+static void writePortraitPairs(uint8_t *fb, int y, const uint8_t *src, size_t pitch, int n, int rows)
+{
+    constexpr int W = E_INK_WIDTH, H = E_INK_HEIGHT;
+    constexpr size_t ROW_BYTES = W / 2;
+    constexpr bool right = ROTATION == 1;
+    auto nativeX = [](int ly) { return right ? W - 1 - ly : ly; };
+    auto nativeY = [](int lx) { return right ? lx : H - 1 - lx; };
+
+    for (int r = 0; r + 2 <= rows; r += 2)
+    {
+        const uint8_t *even = src + r * pitch, *odd = even + pitch;
+        const int X = nativeX(y + r);
+        uint8_t *p = fb + nativeY(0) * ROW_BYTES + (right ? X - 1 : X) / 2;
+        const ptrdiff_t step = right ? ROW_BYTES : -(ptrdiff_t)ROW_BYTES;
+        for (int i = 0; i < n; i++, p += step)
+        {
+            uint8_t hi = right ? odd[i] : even[i];
+            uint8_t lo = right ? even[i] : odd[i];
+            *p = ((hi & 0x07) << 4) | (lo & 0x07);
+        }
+    }
+}
+
+enum class Writer
+{
+    DRAW_PIXEL,
+    WRITE_ROWS,
+    ROW_PAIRS,
+};
+
+// Draw the whole screen band by band, one way or another
+static void drawScreen(Inkplate &display, const std::vector<uint8_t> &colors, int band, Writer writer)
+{
+    const int w = display.width(), h = display.height();
+    for (int y = 0; y < h; y += band)
+    {
+        int rows = std::min(band, h - y);
+        const uint8_t *src = &colors[(size_t)y * w];
+        if (writer == Writer::WRITE_ROWS)
+        {
+            framebuffer::writeRows(display, 0, y, src, w, w, rows);
+            continue;
+        }
+        if (writer == Writer::ROW_PAIRS)
+        {
+            writePortraitPairs(display.DMemory4Bit, y, src, w, w, rows);
+            continue;
+        }
+        for (int r = 0; r < rows; r++)
+            for (int x = 0; x < w; x++)
+                display.drawPixel(x, y + r, framebuffer::color(display, src[(size_t)r * w + x]));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int band = argc > 1 ? atoi(argv[1]) : 16;
+    Inkplate display;
+    display.setRotation(ROTATION);
+    const int w = display.width(), h = display.height();
+    const double pixels = (double)w * h;
+
+    // Panel colors as a dither leaves them: every level, no long runs
+    std::vector<uint8_t> colors((size_t)w * h);
+    uint32_t seed = 1;
+    for (uint8_t &c : colors)
+        c = ((seed = seed * 1103515245 + 12345) >> 16) % 7;
+
+    printf("%dx%d, rotation %d, %d-row bands; fastest of %d\n", w, h, ROTATION, band, RUNS);
+    const bool modes[] = {false, true};
+    for (bool bilevel : modes)
+    {
+#ifdef ARDUINO_INKPLATECOLOR
+        if (bilevel)
+            break;
+#endif
+        framebuffer::setBilevel(display, bilevel);
+        std::vector<uint8_t> viaPixel, viaRows;
+        const uint8_t *fb = bilevel ? display._partial : display.DMemory4Bit;
+        const size_t bytes = bilevel ? (size_t)E_INK_WIDTH * E_INK_HEIGHT / 8 : (size_t)E_INK_WIDTH * E_INK_HEIGHT / 2;
+
+        double slow = bench::fastest(RUNS, [&] { drawScreen(display, colors, band, Writer::DRAW_PIXEL); });
+        viaPixel.assign(fb, fb + bytes);
+        double fast = bench::fastest(RUNS, [&] { drawScreen(display, colors, band, Writer::WRITE_ROWS); });
+        viaRows.assign(fb, fb + bytes);
+
+        printf("  %s mode\n", bilevel ? "1-bit" : "3-bit");
+        printf("    drawPixel()   %7.2f ms %8.1f Mpixel/s\n", slow, pixels / slow / 1000);
+        printf("    writeRows()   %7.2f ms %8.1f Mpixel/s  %5.1fx%s\n", fast, pixels / fast / 1000, slow / fast,
+               viaPixel == viaRows ? "" : "  (FRAMEBUFFERS DIFFER)");
+
+        // Odd bands would leave rows to the old writer's pixel path
+        if (ROTATION % 2 && !bilevel && band % 2 == 0)
+        {
+            double pairs = bench::fastest(RUNS, [&] { drawScreen(display, colors, band, Writer::ROW_PAIRS); });
+            printf("    row pairs     %7.2f ms %8.1f Mpixel/s  %5.1fx%s\n", pairs, pixels / pairs / 1000, slow / pairs,
+                   memcmp(fb, viaRows.data(), bytes) ? "  (FRAMEBUFFERS DIFFER)" : "");
+        }
+    }
+    return 0;
+}
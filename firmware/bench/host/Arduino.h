@@ -0,0 +1,65 @@
+#ifndef BENCH_ARDUINO_H
+#define BENCH_ARDUINO_H
+
+// Just enough of the Arduino core for the firmware's decode, dither and
+// download modules to build on a PC (see bench/run.sh)
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <strings.h>
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define PROGMEM
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+using std::max;
+using std::min;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+// Only named by logger.h
+class Stream;
+
+class String
+{
+public:
+    String() = default;
+    String(const char *text) : s(text ? text : "") {}
+    String(int v) : s(std::to_string(v)) {}
+    String(unsigned v) : s(std::to_string(v)) {}
+    String(long v) : s(std::to_string(v)) {}
+    String(unsigned long v) : s(std::to_string(v)) {}
+    String(float v, unsigned places = 2) : s(fixed(v, places)) {}
+    String(double v, unsigned places = 2) : s(fixed(v, places)) {}
+
+    const char *c_str() const { return s.c_str(); }
+    size_t length() const { return s.size(); }
+    bool operator==(const char *other) const { return s == other; }
+    bool operator==(const String &other) const { return s == other.s; }
+    String &operator+=(const String &other) { s += other.s; return *this; }
+    friend String operator+(String a, const String &b) { return a += b; }
+    friend String operator+(String a, const char *b) { return a += String(b); }
+    friend String operator+(String a, unsigned char b) { return a += String(unsigned(b)); }
+
+private:
+    static std::string fixed(double v, unsigned places)
+    {
+        char text[32];
+        snprintf(text, sizeof(text), "%.*f", int(places), v);
+        return text;
+    }
+
+    std::string s;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef BENCH_INKPLATE_H
+#define BENCH_INKPLATE_H
+
+// An Inkplate with the library's framebuffers and its drawPixel() path
+// (Adafruit_GFX virtual call, rotation, bounds checks, read-modify-write of
+// one nibble or bit), so direct writes can be timed against it
+
+#include <Arduino.h>
+#include <vector>
+
+#define INKPLATE_1BIT 0
+#define INKPLATE_3BIT 1
+
+#ifdef ARDUINO_INKPLATECOLOR
+#define E_INK_WIDTH 600
+#define E_INK_HEIGHT 448
+#else
+#define E_INK_WIDTH 1200
+#define E_INK_HEIGHT 825
+#endif
+
+#define INKPLATE_BLACK 0
+#define INKPLATE_WHITE 1
+#define INKPLATE_GREEN 2
+#define INKPLATE_BLUE 3
+#define INKPLATE_RED 4
+#define INKPLATE_YELLOW 5
+#define INKPLATE_ORANGE 6
+
+class Adafruit_GFX
+{
+public:
+    virtual ~Adafruit_GFX() = default;
+    virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+
+    uint8_t getRotation() const { return rotation; }
+    void setRotation(uint8_t r) { rotation = r & 3; }
+    int16_t width() const { return rotation % 2 ? E_INK_HEIGHT : E_INK_WIDTH; }
+    int16_t height() const { return rotation % 2 ? E_INK_WIDTH : E_INK_HEIGHT; }
+
+protected:
+    uint8_t rotation = 0;
+};
+
+class Inkplate : public Adafruit_GFX
+{
+public:
+    Inkplate() : gray(E_INK_WIDTH * E_INK_HEIGHT / 2), bits(E_INK_WIDTH * E_INK_HEIGHT / 8)
+    {
+        DMemory4Bit = gray.data();
+        _partial = bits.data();
+        clearDisplay();
+    }
+
+    void drawPixel(int16_t x, int16_t y, uint16_t color) override
+    {
+        if (x < 0 || y < 0 || x >= width() || y >= height())
+            return;
+        switch (rotation)
+        {
+        case 1:
+            std::swap(x, y);
+            x = E_INK_WIDTH - x - 1;
+            break;
+        case 2:
+            x = E_INK_WIDTH - x - 1;
+            y = E_INK_HEIGHT - y - 1;
+            break;
+        case 3:
+            std::swap(x, y);
+            y = E_INK_HEIGHT - y - 1;
+            break;
+        }
+        if (mode == INKPLATE_1BIT)
+        {
+            uint8_t *p = _partial + E_INK_WIDTH / 8 * y + x / 8;
+            *p = (*p & ~(1 << (x & 7))) | (color ? 1 << (x & 7) : 0);
+        }
+        else
+        {
+            uint8_t *p = DMemory4Bit + E_INK_WIDTH / 2 * y + x / 2;
+            color &= 7;
+            *p = x & 1 ? (*p & 0xF0) | color : (*p & 0x0F) | (color << 4);
+        }
+    }
+
+    void clearDisplay()
+    {
+        std::fill(gray.begin(), gray.end(), 0x11 * WHITE);
+        std::fill(bits.begin(), bits.end(), 0);
+    }
+
+    void selectDisplayMode(uint8_t m)
+    {
+        mode = m;
+        clearDisplay();
+    }
+    uint8_t getDisplayMode() const { return mode; }
+
+    uint8_t *DMemory4Bit = nullptr;
+    uint8_t *_partial = nullptr;
+
+private:
+#ifdef ARDUINO_INKPLATECOLOR
+    static constexpr uint8_t WHITE = INKPLATE_WHITE;
+#else
+    static constexpr uint8_t WHITE = 7;
+#endif
+    std::vector<uint8_t> gray, bits;
+    uint8_t mode = INKPLATE_3BIT;
+};
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef BENCH_PUBSUBCLIENT_H
+#define BENCH_PUBSUBCLIENT_H
+
+class PubSubClient
+{
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef BENCH_WIFICLIENT_H
+#define BENCH_WIFICLIENT_H
+
+// A socket as HttpBodyStream and the old readStream() see it; the
+// benchmarks feed it from memory
+
+#include <Arduino.h>
+
+class WiFiClient
+{
+public:
+    virtual ~WiFiClient() = default;
+
+    // Bytes the TCP stack has ready
+    virtual int available() = 0;
+    virtual uint8_t connected() = 0;
+    virtual int read(uint8_t *dst, size_t len) = 0;
+
+    // As in the ESP32 core: readBytes() is a bulk read, readBytesUntil()
+    // goes byte by byte
+    int read()
+    {
+        uint8_t c;
+        return available() > 0 && read(&c, 1) == 1 ? c : -1;
+    }
+    size_t readBytes(uint8_t *dst, size_t len)
+    {
+        int n = read(dst, len);
+        return n > 0 ? n : 0;
+    }
+    size_t readBytesUntil(char end, uint8_t *dst, size_t len)
+    {
+        size_t n = 0;
+        for (int c; n < len && (c = read()) >= 0 && c != end;)
+            dst[n++] = c;
+        return n;
+    }
+};
+
+#endif
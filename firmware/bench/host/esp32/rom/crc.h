@@ -0,0 +1,8 @@
+#ifndef BENCH_ROM_CRC_H
+#define BENCH_ROM_CRC_H
+
+#include <cstdint>
+
+uint32_t crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif
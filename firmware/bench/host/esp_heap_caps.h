@@ -0,0 +1,18 @@
+#ifndef BENCH_ESP_HEAP_CAPS_H
+#define BENCH_ESP_HEAP_CAPS_H
+
+// The heap_caps allocator on malloc, counted by the benchmarks' heap meter
+// (see bench.h)
+
+#include <cstddef>
+
+#define MALLOC_CAP_32BIT (1 << 1)
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+void *heap_caps_malloc(size_t size, unsigned caps);
+void *heap_caps_calloc(size_t count, size_t size, unsigned caps);
+void heap_caps_free(void *p);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef BENCH_FREERTOS_H
+#define BENCH_FREERTOS_H
+
+// FreeRTOS tasks and binary semaphores on std::thread (see host.cpp); ticks
+// are milliseconds and the "cores" are whatever the OS schedules
+
+#include <cstdint>
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void *TaskHandle_t;
+typedef void *SemaphoreHandle_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFFu
+#define pdMS_TO_TICKS(ms) (ms)
+#define portNUM_PROCESSORS 2
+
+BaseType_t xPortGetCoreID();
+
+#endif
@@ -0,0 +1,245 @@
+#include <Arduino.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <esp32/rom/crc.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#include "bench.h"
+#include "logger.h"
+
+// Time since the first call
+static std::chrono::steady_clock::duration sinceStart()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::steady_clock::now() - start;
+}
+
+unsigned long millis()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(sinceStart()).count();
+}
+
+unsigned long micros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(sinceStart()).count();
+}
+
+int64_t esp_timer_get_time()
+{
+    return micros();
+}
+
+void delay(unsigned long ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield()
+{
+    std::this_thread::yield();
+}
+
+// Heap meter: every allocation carries its size in front of it
+static std::atomic<size_t> heapLive{0}, heapPeak{0};
+static constexpr size_t HEADER = alignof(std::max_align_t);
+
+static void *allocate(size_t size)
+{
+    uint8_t *p = static_cast<uint8_t *>(malloc(size + HEADER));
+    if (!p)
+        return nullptr;
+    memcpy(p, &size, sizeof(size));
+    size_t live = heapLive += size;
+    for (size_t peak = heapPeak; live > peak && !heapPeak.compare_exchange_weak(peak, live);)
+        ;
+    return p + HEADER;
+}
+
+static void release(void *p)
+{
+    if (!p)
+        return;
+    uint8_t *block = static_cast<uint8_t *>(p) - HEADER;
+    size_t size;
+    memcpy(&size, block, sizeof(size));
+    heapLive -= size;
+    free(block);
+}
+
+void *operator new(size_t size)
+{
+    if (void *p = allocate(size))
+        return p;
+    throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+void operator delete(void *p) noexcept { release(p); }
+void operator delete[](void *p) noexcept { release(p); }
+void operator delete(void *p, size_t) noexcept { release(p); }
+void operator delete[](void *p, size_t) noexcept { release(p); }
+
+void *heap_caps_malloc(size_t size, unsigned)
+{
+    return allocate(size);
+}
+
+void *heap_caps_calloc(size_t count, size_t size, unsigned)
+{
+    void *p = allocate(count * size);
+    if (p)
+        memset(p, 0, count * size);
+    return p;
+}
+
+void heap_caps_free(void *p)
+{
+    release(p);
+}
+
+namespace bench
+{
+    static bool tasks = true;
+
+    bool tasksEnabled()
+    {
+        return tasks;
+    }
+
+    void enableTasks(bool on)
+    {
+        tasks = on;
+    }
+
+    size_t heapInUse()
+    {
+        return heapLive;
+    }
+
+    size_t resetHeapPeak()
+    {
+        return heapPeak = heapLive.load();
+    }
+
+    size_t heapHighWater()
+    {
+        return heapPeak;
+    }
+}
+
+// The ROM's CRC32 (reflected, polynomial 0xEDB88320), a byte per lookup
+uint32_t crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    static const auto table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? (c >> 1) ^ 0xEDB88320 : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    while (len--)
+        crc = table[(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// Binary semaphore
+struct Semaphore
+{
+    std::mutex lock;
+    std::condition_variable changed;
+    bool given = false;
+};
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+    return new Semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t handle, TickType_t ticks)
+{
+    Semaphore *sem = static_cast<Semaphore *>(handle);
+    std::unique_lock<std::mutex> hold(sem->lock);
+    auto given = [sem] { return sem->given; };
+    if (ticks == portMAX_DELAY)
+        sem->changed.wait(hold, given);
+    else if (!sem->changed.wait_for(hold, std::chrono::milliseconds(ticks), given))
+        return pdFALSE;
+    sem->given = false;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t handle)
+{
+    // Notify under the lock: the taker may delete the semaphore as soon as
+    // it wakes
+    Semaphore *sem = static_cast<Semaphore *>(handle);
+    std::lock_guard<std::mutex> hold(sem->lock);
+    if (sem->given)
+        return pdFALSE;
+    sem->given = true;
+    sem->changed.notify_one();
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t handle)
+{
+    delete static_cast<Semaphore *>(handle);
+}
+
+// Tasks run on detached threads; vTaskDelete(nullptr) is the last thing
+// every firmware task does, so returning from it ends the thread
+static thread_local BaseType_t core = 0;
+
+BaseType_t xPortGetCoreID()
+{
+    return core;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *, uint32_t, void *arg, UBaseType_t,
+                                   TaskHandle_t *handle, BaseType_t pinned)
+{
+    if (!bench::tasksEnabled())
+        return pdFAIL;
+    std::thread([code, arg, pinned] {
+        core = pinned;
+        code(arg);
+    }).detach();
+    if (handle)
+        *handle = reinterpret_cast<TaskHandle_t>(1);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t)
+{
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t)
+{
+    return 1;
+}
+
+// Logging goes nowhere; the benchmarks print their own results
+namespace Logger
+{
+    void log(LogLevel, const char *)
+    {
+    }
+
+    void logf(LogLevel, const char *, ...)
+    {
+    }
+}
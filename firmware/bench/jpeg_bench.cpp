@@ -0,0 +1,179 @@
+// JPEG decode time per frame: the firmware's decoder on its own (full color
+// and luma only) and the whole draw (decode, dither, framebuffer writes) on
+// one core and split across two, against libjpeg-turbo as the reference
+// decoder when it is installed. TJpgDec, the ROM decoder behind the
+// library's drawJpegFromBuffer(), has no host build; libjpeg-turbo runs
+// with its SIMD off and in the modes closest to the firmware's (AAN integer
+// IDCT, chroma replicated), so both sides do the same work in plain C.
+//
+//   jpeg_bench image.jpg...
+
+#include <Arduino.h>
+#include <Inkplate.h>
+#include <thread>
+
+#include "bench.h"
+#include "jpeg_decoder.h"
+#include "jpeg_stream.h"
+
+#ifdef BENCH_LIBJPEG
+#include <jpeglib.h>
+#endif
+
+// Timed runs per measurement; the fastest counts
+static constexpr int RUNS = 25;
+
+// Keeps the decoded image, or just lets the rows go by
+class ImageSink : public jpeg_decoder::PixelSink
+{
+public:
+    explicit ImageSink(bool keep) : keep(keep) {}
+
+    bool begin(uint16_t w, uint16_t h, uint8_t c) override
+    {
+        width = w;
+        components = c;
+        if (keep)
+            pixels.assign((size_t)w * h * c, 0);
+        return true;
+    }
+
+    bool rows(uint16_t y, uint16_t count, const uint8_t *src, size_t stride) override
+    {
+        if (keep)
+            for (uint16_t r = 0; r < count; r++)
+                memcpy(&pixels[(size_t)(y + r) * width * components], src + r * stride, (size_t)width * components);
+        return true;
+    }
+
+    bool keep;
+    uint16_t width = 0;
+    uint8_t components = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// Decode with the firmware decoder into sink; false if it failed
+static bool decode(const std::vector<uint8_t> &jpeg, bool luma, ImageSink &sink)
+{
+    bench::MemorySource src(jpeg, false);
+    jpeg_decoder::Decoder decoder;
+    if (decoder.prepare(src) != DecodeResult::OK)
+        return false;
+    decoder.setLumaOnly(luma);
+    return decoder.decode(sink) == DecodeResult::OK;
+}
+
+#ifdef BENCH_LIBJPEG
+// Decode with libjpeg-turbo to RGB or gray, rows kept in out if not null
+static bool referenceDecode(const std::vector<uint8_t> &jpeg, bool luma, std::vector<uint8_t> *out)
+{
+    jpeg_decompress_struct cinfo;
+    jpeg_error_mgr err;
+    cinfo.err = jpeg_std_error(&err);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, jpeg.data(), jpeg.size());
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = luma ? JCS_GRAYSCALE : JCS_RGB;
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+    jpeg_start_decompress(&cinfo);
+    size_t pitch = (size_t)cinfo.output_width * cinfo.output_components;
+    std::vector<uint8_t> rows(pitch * cinfo.rec_outbuf_height);
+    if (out)
+        out->resize(pitch * cinfo.output_height);
+    while (cinfo.output_scanline < cinfo.output_height)
+    {
+        uint8_t *dst = out ? out->data() + pitch * cinfo.output_scanline : rows.data();
+        JSAMPROW lines[4];
+        for (int i = 0; i < cinfo.rec_outbuf_height; i++)
+            lines[i] = dst + pitch * i;
+        jpeg_read_scanlines(&cinfo, lines, cinfo.rec_outbuf_height);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
+
+// Mean absolute difference and largest difference between two images
+static void compare(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b, double &mean, int &worst)
+{
+    uint64_t sum = 0;
+    worst = 0;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        int d = abs(a[i] - b[i]);
+        sum += d;
+        worst = std::max(worst, d);
+    }
+    mean = a.empty() ? 0 : double(sum) / a.size();
+}
+#endif
+
+// Draw the image the way the firmware does, the input in memory (so it may
+// split across both cores) or not
+static bool draw(Inkplate &display, const std::vector<uint8_t> &jpeg, bool inMemory)
+{
+    bench::MemorySource src(jpeg, inMemory);
+    jpeg_stream::Decoder decoder;
+    return decoder.prepare(src) == DecodeResult::OK &&
+           decoder.draw(display, 0, 0, dither::Mode::FLOYD_STEINBERG) == DecodeResult::OK;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s image.jpg...\n", argv[0]);
+        return 1;
+    }
+#ifdef BENCH_LIBJPEG
+    setenv("JSIMD_FORCENONE", "1", 1);
+#endif
+
+    // The split only pays off with a second CPU to run on
+    const bool twoCores = std::thread::hardware_concurrency() >= 2;
+
+    Inkplate display;
+    display.setRotation(ROTATION);
+    printf("%dx%d display, rotation %d; ms per frame, fastest of %d%s\n\n", display.width(), display.height(),
+           ROTATION, RUNS, twoCores ? "" : " (one CPU: no 2-core draw)");
+    printf("%-24s %9s %9s %9s %9s %9s %9s  %s\n", "image", "libjpeg", "decoder", "libjpeg", "decoder", "draw",
+           "draw", "decoder vs");
+    printf("%-24s %9s %9s %9s %9s %9s %9s  %s\n", "", "RGB", "RGB", "gray", "luma", "1 core", "2 cores",
+           "libjpeg RGB");
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::vector<uint8_t> jpeg = bench::readFile(argv[i]);
+        ImageSink keep(true), pass(false);
+        if (jpeg.empty() || !decode(jpeg, false, keep))
+        {
+            printf("%-24s unreadable or unsupported\n", bench::baseName(argv[i]).c_str());
+            continue;
+        }
+
+        double ours = bench::fastest(RUNS, [&] { decode(jpeg, false, pass); });
+        double oursLuma = bench::fastest(RUNS, [&] { decode(jpeg, true, pass); });
+        double drawOne = bench::fastest(RUNS, [&] { draw(display, jpeg, false); });
+        char drawTwo[16] = "-";
+        if (twoCores)
+            snprintf(drawTwo, sizeof(drawTwo), "%.2f", bench::fastest(RUNS, [&] { draw(display, jpeg, true); }));
+
+        char ref[16] = "-", refLuma[16] = "-", diff[48] = "";
+#ifdef BENCH_LIBJPEG
+        std::vector<uint8_t> expected;
+        referenceDecode(jpeg, false, &expected);
+        double mean;
+        int worst;
+        compare(keep.pixels, expected, mean, worst);
+        double lib = bench::fastest(RUNS, [&] { referenceDecode(jpeg, false, nullptr); });
+        double libLuma = bench::fastest(RUNS, [&] { referenceDecode(jpeg, true, nullptr); });
+        snprintf(ref, sizeof(ref), "%.2f", lib);
+        snprintf(refLuma, sizeof(refLuma), "%.2f", libLuma);
+        snprintf(diff, sizeof(diff), "%.2fx (output off by %.2f avg, %d max)", lib / ours, mean, worst);
+#endif
+        printf("%-24s %9s %9.2f %9s %9.2f %9.2f %9s  %s\n", bench::baseName(argv[i]).c_str(), ref, ours, refLuma,
+               oursLuma, drawOne, drawTwo, diff);
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+// Browser renders as QOI against the quality 100 JPEG they replaced:
+// payload size and time to draw on the panel (decode, dither, framebuffer
+// writes), undithered and with Floyd-Steinberg. Each image.qoi is paired
+// with the image.jpg next to it; capture both from the Worker, e.g.
+//
+//   curl -H 'Accept: image/qoi' -o hn.qoi  .../api/v1/render/hn?w=1200&h=825
+//   curl -H 'Accept: image/jpeg' -o hn.jpg .../api/v1/render/hn?w=1200&h=825
+//
+//   qoi_bench image.qoi...
+
+#include <Arduino.h>
+#include <Inkplate.h>
+
+#include "bench.h"
+#include "jpeg_stream.h"
+#include "qoi_stream.h"
+
+static constexpr int RUNS = 25;
+
+// Draw a QOI image as the firmware does
+static bool drawQoi(Inkplate &display, const std::vector<uint8_t> &qoi, dither::Mode mode)
+{
+    bench::MemorySource src(qoi, false);
+    qoi_stream::Decoder decoder;
+    return decoder.prepare(src) == DecodeResult::OK && decoder.draw(display, 0, 0, mode) == DecodeResult::OK;
+}
+
+// Draw a JPEG as the firmware does, on one core
+static bool drawJpeg(Inkplate &display, const std::vector<uint8_t> &jpeg, dither::Mode mode)
+{
+    bench::MemorySource src(jpeg, false);
+    jpeg_stream::Decoder decoder;
+    return decoder.prepare(src) == DecodeResult::OK && decoder.draw(display, 0, 0, mode) == DecodeResult::OK;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s image.qoi...\n", argv[0]);
+        return 1;
+    }
+
+    Inkplate display;
+    display.setRotation(ROTATION);
+    printf("%dx%d display, rotation %d; ms per frame, fastest of %d\n\n", display.width(), display.height(), ROTATION,
+           RUNS);
+    printf("%-20s %9s %9s %9s %9s %9s %9s\n", "image", "QOI", "JPEG", "QOI", "JPEG", "QOI", "JPEG");
+    printf("%-20s %9s %9s %9s %9s %9s %9s\n", "", "KiB", "KiB", "none", "none", "FS", "FS");
+
+    const dither::Mode modes[] = {dither::Mode::NONE, dither::Mode::FLOYD_STEINBERG};
+    for (int i = 1; i < argc; i++)
+    {
+        std::string path = argv[i];
+        std::vector<uint8_t> qoi = bench::readFile(path);
+        std::vector<uint8_t> jpeg = bench::readFile(path.substr(0, path.rfind('.')) + ".jpg");
+        std::string name = bench::baseName(path);
+        if (qoi.empty() || jpeg.empty() || !drawQoi(display, qoi, dither::Mode::NONE) ||
+            !drawJpeg(display, jpeg, dither::Mode::NONE))
+        {
+            printf("%-20s missing, unreadable or unsupported (QOI and JPEG both needed)\n", name.c_str());
+            continue;
+        }
+
+        printf("%-20s %9.1f %9.1f", name.c_str(), qoi.size() / 1024.0, jpeg.size() / 1024.0);
+        for (dither::Mode mode : modes)
+        {
+            printf(" %9.2f", bench::fastest(RUNS, [&] { drawQoi(display, qoi, mode); }));
+            printf(" %9.2f", bench::fastest(RUNS, [&] { drawJpeg(display, jpeg, mode); }));
+        }
+        printf("\n");
+    }
+    return 0;
+}
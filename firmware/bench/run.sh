@@ -0,0 +1,52 @@
+#!/bin/sh
+# Host benchmarks for the firmware's hot paths. The modules are built for the
+# PC with g++ against the shims in host/ (Arduino core, Inkplate buffers,
+# FreeRTOS tasks on threads), so the numbers compare implementations against
+# each other on one machine; they are not ESP32 timings.
+#
+#   bench/run.sh <bench> [args...]
+#
+#   download [KiB...]   DownloadBuffer against the old readStream()
+#   jpeg image.jpg...   JPEG decode and draw, against libjpeg-turbo if found
+#   framebuffer [rows]  framebuffer::writeRows() against drawPixel()
+#   dither [-o dir] image.ppm...
+#                       Cost and quality of each dithering mode
+#   qoi image.qoi...    QOI renders against their JPEG twins (image.jpg)
+#
+# BOARD (ARDUINO_INKPLATE10V2 or ARDUINO_INKPLATECOLOR) and ROTATION pick the
+# build, as the PlatformIO flags do; binaries go to $BUILD (bench/build).
+set -e
+cd "$(dirname "$0")"
+
+BOARD=${BOARD:-ARDUINO_INKPLATE10V2}
+ROTATION=${ROTATION:-0}
+BUILD=${BUILD:-build}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2}
+
+bench=$1
+[ -n "$bench" ] || { awk 'NR > 1 && !/^#/ { exit } NR > 1 { sub(/^# ?/, ""); print }' "$0"; exit 1; }
+shift
+
+case $bench in
+download) sources="download_bench.cpp ../src/download_buffer.cpp ../src/http_stream.cpp" ;;
+jpeg)
+    sources="jpeg_bench.cpp ../src/jpeg_decoder.cpp ../src/jpeg_utils.cpp ../src/jpeg_stream.cpp
+        ../src/box_filter.cpp ../src/dither.cpp ../src/framebuffer.cpp ../src/decode_result.cpp"
+    if echo '#include <jpeglib.h>' | $CXX -xc++ -E - >/dev/null 2>&1; then
+        defines="-DBENCH_LIBJPEG"
+        libs="-ljpeg"
+    fi ;;
+framebuffer) sources="framebuffer_bench.cpp ../src/framebuffer.cpp" ;;
+dither) sources="dither_bench.cpp ../src/dither.cpp" ;;
+qoi)
+    sources="qoi_bench.cpp ../src/qoi_stream.cpp ../src/jpeg_decoder.cpp ../src/jpeg_utils.cpp ../src/jpeg_stream.cpp
+        ../src/box_filter.cpp ../src/dither.cpp ../src/framebuffer.cpp ../src/decode_result.cpp" ;;
+*) echo "unknown bench: $bench" >&2; exit 1 ;;
+esac
+
+mkdir -p "$BUILD"
+out="$BUILD/${bench}_${BOARD}_r$ROTATION"
+$CXX -std=gnu++17 $CXXFLAGS -pthread -D"$BOARD" -DROTATION="$ROTATION" $defines -Ihost -I. -I../include \
+    -o "$out" host/host.cpp $sources $libs
+exec "$out" "$@"
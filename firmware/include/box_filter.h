@@ -0,0 +1,42 @@
+#ifndef BOX_FILTER_H
+#define BOX_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Streaming box-filter downscale: each output pixel is the average of the
+// source pixels it covers. Source rows go in one at a time and output rows
+// come out as soon as they are complete, so only one row of sums is kept.
+//
+// Used to finish shrinking oversized JPEGs after the decoder's power-of-two
+// IDCT scaling, which gets within 2x of the target size.
+class BoxFilter
+{
+public:
+    // Start shrinking a srcWidth x srcHeight image to dstWidth x dstHeight
+    // (no larger than the source); false if out of memory
+    bool begin(uint16_t srcWidth, uint16_t srcHeight, uint16_t dstWidth, uint16_t dstHeight, uint8_t components);
+
+    // Add the next source row; returns the finished output row, or nullptr
+    // when it still needs more source rows
+    const uint8_t *push(const uint8_t *row);
+
+    // Release the row buffers
+    void end();
+
+    uint16_t width() const { return dstWidth; }
+
+private:
+    uint16_t srcWidth = 0, srcHeight = 0;
+    uint16_t dstWidth = 0, dstHeight = 0;
+    uint8_t components = 3;
+    uint16_t srcY = 0;                 // Next source row
+    uint16_t dstY = 0;                 // Output row being summed
+    uint16_t rowsSummed = 0;           // Source rows in the sums so far
+    std::vector<uint16_t> columnEnds;  // Last source column (exclusive) of each output column
+    std::vector<uint32_t> sums;        // Running sums of the output row
+    std::vector<uint8_t> out;          // Finished output row
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef BYTE_SOURCE_H
+#define BYTE_SOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Minimal pull interface used by the streaming decoders to read their input
+// without caring where the bytes come from (socket, buffer, file, ...)
+class ByteSource
+{
+public:
+    virtual ~ByteSource() = default;
+
+    // Read up to len bytes into dst; returns the number of bytes read, or 0 at
+    // the end of the input (or on timeout / error)
+    virtual size_t read(uint8_t *dst, size_t len) = 0;
+
+    // Discard up to len bytes; returns the number of bytes skipped
+    virtual size_t skip(size_t len)
+    {
+        uint8_t scratch[64];
+        size_t total = 0;
+        while (total < len)
+        {
+            size_t want = len - total < sizeof(scratch) ? len - total : sizeof(scratch);
+            size_t n = read(scratch, want);
+            if (n == 0)
+                break;
+            total += n;
+        }
+        return total;
+    }
+
+    // The rest of the input, when all of it is already in memory and stays
+    // put until the reader is done with it; nullptr otherwise. Lets decoders
+    // hand part of the remaining work to another core.
+    virtual const uint8_t *remaining(size_t &len)
+    {
+        len = 0;
+        return nullptr;
+    }
+};
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef DECODE_RESULT_H
+#define DECODE_RESULT_H
+
+#include <cstdint>
+
+// Outcome of a streaming image decode, shared by every body format
+enum class DecodeResult : uint8_t
+{
+    OK = 0,
+    UNSUPPORTED, // Valid, but a variant we can't decode (e.g. arithmetic-coded JPEG)
+    INVALID,     // Not the expected format, or corrupted headers/data
+    INPUT,       // The source ran dry or timed out
+    MEMORY       // Failed to allocate working buffers
+};
+
+// Human readable name for a DecodeResult
+const char *decodeResultName(DecodeResult result);
+
+#endif
@@ -25,6 +25,25 @@
 #define DITHERING 1
 #endif
 
+// Panel tone curve: input black and white points, midtone gamma
+#ifndef TONE_BLACK
+#define TONE_BLACK 0
+#endif
+#ifndef TONE_WHITE
+#define TONE_WHITE 255
+#endif
+#ifndef TONE_GAMMA
+#define TONE_GAMMA 1.0
+#endif
+
+#ifndef DOWNLOAD_BUFFER_SIZE
+#define DOWNLOAD_BUFFER_SIZE (512 * 1024)
+#endif
+
+#ifndef TLS_SESSION_RTC_SIZE
+#define TLS_SESSION_RTC_SIZE 2048
+#endif
+
 #ifndef INKY_RENDERER_VERSION
 #define INKY_RENDERER_VERSION "0.0.1-beta.1"
 #endif
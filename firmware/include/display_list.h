@@ -0,0 +1,40 @@
+#ifndef DISPLAY_LIST_H
+#define DISPLAY_LIST_H
+
+#include <Inkplate.h>
+
+#include "byte_source.h"
+#include "decode_result.h"
+
+// Display lists: text, rectangles, lines and 1-bit bitmaps that the Worker
+// (routes/libs/display_list.mjs) sends for text-heavy renders instead of a
+// screenshot, drawn here with the fonts built into the firmware. A few KB
+// instead of hundreds, and text crisp at the panel's own resolution.
+//
+//   header:    "INKL" | u8 version | u16 width | u16 height
+//   commands:  u8 opcode and its operands, until END
+//     FILL_RECT  i16 x | i16 y | u16 w | u16 h | u8 gray
+//     RECT       i16 x | i16 y | u16 w | u16 h | u8 gray
+//     LINE       i16 x0 | i16 y0 | i16 x1 | i16 y1 | u8 gray
+//     TEXT       i16 x | i16 y (baseline) | u8 font | u8 scale | u8 gray |
+//                u8 length | length bytes of ASCII
+//     BITMAP     u8 id | u16 w | u16 h | ceil(w / 8) * h bytes, rows MSB first
+//     DRAW       u8 id | i16 x | i16 y | u8 scale | u8 gray
+// Integers are little-endian; gray is 0 (black) to 255 (white). Fonts are
+// Adafruit GFX's classic 6x8 font (0) and FreeSansBoldOblique24pt7b (1).
+//
+// Commands are drawn as they arrive, through Adafruit_GFX and so in the
+// display's rotation, on a cleared (white) display.
+namespace display_list
+{
+    // Content-Type of a display list response
+    constexpr const char *CONTENT_TYPE = "application/x-inky-dl";
+
+    // Format version this firmware draws
+    constexpr uint8_t VERSION = 1;
+
+    // Clear the display and draw the list read from src
+    DecodeResult draw(Inkplate &display, ByteSource &src);
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef DITHER_H
+#define DITHER_H
+
+#include <Arduino.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Quantizes decoded rows to panel colors: 3-bit gray levels on the Inkplate
+// 10, ink ids on the 6COLOR. The mode is picked per image by the server
+// (X-Inky-Dither), trading quality for wake time:
+//
+//   floyd-steinberg  4 taps, smoothest gradients (the default)
+//   sierra-lite      3 taps, close to Floyd-Steinberg and cheaper
+//   atkinson         6 taps, only 3/4 of the error spread: crisp, high contrast
+//   ordered          blue-noise threshold map, no error state at all
+//   none             nearest color
+//
+// In the Inkplate 10's 1-bit mode the same modes dither to black and white
+// (none is a plain threshold).
+//
+// Samples go through a 256-entry tone curve on their way in (see Tone), so
+// panel calibration costs one lookup per sample and no pass of its own.
+//
+// Error diffusion keeps the undivided weighted errors in ring buffers of
+// rows (fixed point, divided once when read back). routes/libs/dither.mjs
+// mirrors this for packed frames; keep the two in sync.
+namespace dither
+{
+    // Mode ids double as the dither bits of bundle frame flags
+    enum class Mode : uint8_t
+    {
+        NONE = 0,
+        FLOYD_STEINBERG = 1,
+        ATKINSON = 2,
+        SIERRA_LITE = 3,
+        ORDERED = 4,
+    };
+
+    // Mode for images that don't ask for one (the DITHERING build flag)
+    Mode defaultMode();
+
+    // Parse a mode name as sent in X-Inky-Dither; fallback if unknown
+    Mode parse(const char *name, Mode fallback);
+
+    // Name of a mode
+    const char *name(Mode mode);
+
+    // Mode from its id; fallback if out of range
+    Mode fromId(uint8_t id, Mode fallback);
+
+    // Tone curve for calibrating a panel: the input levels between the black
+    // and white points are stretched to the full range, then a midtone gamma
+    // is applied (above 1 lightens, as in an image editor's levels)
+    struct Tone
+    {
+        uint8_t black = 0;
+        uint8_t white = 255;
+        float gamma = 1.0f;
+    };
+
+    // This panel's tone, from the TONE_BLACK, TONE_WHITE and TONE_GAMMA build
+    // flags; its curve is built by the compiler
+    Tone panelTone();
+
+    // Parse "black=16, white=240, gamma=1.2" (any of them) over fallback, as
+    // given by renderer.tone in config.json or X-Inky-Tone; fallback if the
+    // result is unusable
+    Tone parseTone(const char *text, const Tone &fallback);
+
+    // A tone in the form parseTone() reads
+    String formatTone(const Tone &tone);
+
+    // Whether two tones give the same curve
+    bool sameTone(const Tone &a, const Tone &b);
+
+    class Ditherer
+    {
+    public:
+        // Start an image of the given width, at row firstLine (for a band
+        // of an image drawn in parts), through the given tone curve; false
+        // if out of memory. Bilevel images (the Inkplate 10's 1-bit mode)
+        // are quantized to gray levels 0 and 7 only.
+        bool begin(Mode mode, uint16_t width, uint32_t firstLine = 0, const Tone &tone = panelTone(),
+                   bool bilevel = false);
+
+        // Quantize the next row; components is 1 (gray) or 3 (RGB)
+        void row(const uint8_t *pixels, uint8_t components, uint8_t *out);
+
+        // Release the error rows
+        void end();
+
+    private:
+        // Error diffusion with one of the kernels in dither.cpp
+        template <typename Kernel>
+        void diffuse(const uint8_t *pixels, uint8_t components, uint8_t *out);
+
+        // Threshold map lookup
+        void ordered(const uint8_t *pixels, uint8_t components, uint8_t *out);
+
+        Mode mode = Mode::NONE;
+        uint8_t curve[256];       // Tone curve, applied as samples are read
+        uint8_t levels = 7;       // Steps between black and white (gray)
+        uint8_t step = 1;         // Gray levels per step
+        uint16_t width = 0;
+        uint32_t line = 0;        // Rows done so far
+        size_t stride = 0;        // One channel of one error row
+        std::vector<int16_t> err; // ERROR_ROWS rows x channels x stride
+    };
+}
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef DOWNLOAD_BUFFER_H
+#define DOWNLOAD_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "byte_source.h"
+#include "http_stream.h"
+
+// A single download region, allocated once (in PSRAM when available) and
+// reused for every request and retry during a wake. Socket reads land
+// directly in the region in large blocks; consumers either copy out with
+// read() or decode in place with peek()/consume().
+//
+// The region is a lock-free single-producer/single-consumer ring. With
+// startProducer() a fetch task on the other core fills it from the socket
+// while the calling task drains it through the decoder; when the ring is full
+// the fetch task blocks (back-pressure) and when it is empty the decoder
+// blocks. Without a producer task the consumer fills it inline.
+class DownloadBuffer : public ByteSource
+{
+public:
+    // Per-stage busy/idle time for the current body, in microseconds
+    struct Stats
+    {
+        uint32_t fetchBusyUs;   // Fetch task inside socket reads
+        uint32_t fetchStallUs;  // Fetch task blocked on a full ring
+        uint32_t renderBusyUs;  // Consumer working (decode, dither, draw)
+        uint32_t renderStallUs; // Consumer blocked on an empty ring
+    };
+
+    DownloadBuffer();
+    ~DownloadBuffer();
+    DownloadBuffer(const DownloadBuffer &) = delete;
+    DownloadBuffer &operator=(const DownloadBuffer &) = delete;
+
+    // Make sure the region can hold a body of contentLength bytes, capped at
+    // maxBytes (contentLength 0 means unknown/chunked and reserves the cap).
+    // The region only ever grows, so retries reuse the same allocation.
+    bool reserve(size_t contentLength, size_t maxBytes);
+
+    // Start a new body: reset positions and pull from the given stream
+    void begin(HttpBodyStream &body);
+
+    // Spawn the fetch task on the core not running the caller; falls back to
+    // inline filling (and returns false) if the task can't be created
+    bool startProducer();
+
+    // Stop the fetch task (if any) and wait for it to exit. Must be called
+    // before the underlying connection is closed or reused.
+    void cancel();
+
+    // Copy up to len bytes out of the region, waiting for the socket
+    size_t read(uint8_t *dst, size_t len) override;
+
+    // Drop up to len bytes without copying them
+    size_t skip(size_t len) override;
+
+    // Expose the next contiguous run of buffered bytes (waiting if empty);
+    // returns nullptr with avail == 0 at the end of the body
+    const uint8_t *peek(size_t &avail);
+
+    // Mark n bytes returned by peek() as consumed
+    void consume(size_t n);
+
+    // The unconsumed rest of the body, once it has all arrived and sits in
+    // one contiguous run of the region
+    const uint8_t *remaining(size_t &len) override;
+
+    // Allocated size of the region
+    size_t capacity() const { return cap; }
+
+    // Largest number of unconsumed bytes held at once for the current body
+    size_t highWater() const { return peak; }
+
+    // Number of socket reads issued for the current body
+    size_t reads() const { return fills; }
+
+    // Stage timing for the current body (complete after cancel())
+    Stats stats() const { return timing; }
+
+    // CRC32 of every byte received for the current body so far (covers the
+    // whole body once it has been drained and cancel() has returned)
+    uint32_t checksum() const { return crc; }
+
+private:
+    // Read the next block from the socket into the free space of the ring
+    size_t fill();
+
+    // Block the consumer until data arrives or the producer is finished
+    bool waitForData();
+
+    // Fetch task entry point
+    static void producerTask(void *arg);
+
+    uint8_t *region = nullptr;
+    size_t cap = 0;
+    std::atomic<size_t> head{0}; // Total bytes consumed
+    std::atomic<size_t> tail{0}; // Total bytes produced
+    std::atomic<bool> finished{false};
+    std::atomic<bool> cancelled{false};
+    size_t peak = 0;
+    size_t fills = 0;
+    HttpBodyStream *body = nullptr;
+
+    TaskHandle_t producer = nullptr;
+    SemaphoreHandle_t dataReady = nullptr;
+    SemaphoreHandle_t spaceReady = nullptr;
+    SemaphoreHandle_t exited = nullptr;
+    uint32_t started = 0;
+    Stats timing = {};
+    uint32_t crc = 0;
+};
+
+#endif
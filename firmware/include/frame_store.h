@@ -0,0 +1,78 @@
+#ifndef FRAME_STORE_H
+#define FRAME_STORE_H
+
+#include <Inkplate.h>
+#include <esp_err.h>
+#include <time.h>
+
+#include "byte_source.h"
+#include "decode_result.h"
+#include "dither.h"
+
+// Frames for upcoming wakes, downloaded together as one bundle and kept in
+// flash (LittleFS) so later wakes can show them without turning the radio on.
+// Each frame is stored as /frames/<wake epoch>: one flags byte followed by
+// the JPEG.
+//
+// Bundle container (little-endian, produced by routes/libs/bundle.mjs):
+//   header:  "INKB" | u8 version | u8 count | u16 reserved
+//   frame:   u32 epoch | u32 length | u8 flags | u8[3] reserved | JPEG bytes
+//
+// It also keeps the base frame for delta updates: the last full packed frame
+// (see packed_frame.h) received with an id, as /keyframe. The device sends
+// that id with each request, and the server answers with only the tiles that
+// differ from it.
+namespace FrameStore
+{
+    // Frame flags; the high nibble holds a dither::Mode id (0 = default)
+    constexpr uint8_t FRAME_NO_DITHERING = 0x01;
+    constexpr uint8_t FRAME_BILEVEL = 0x02; // Shown in 1-bit mode
+    constexpr uint8_t FRAME_DITHER_SHIFT = 4;
+
+    // Drop every stored frame
+    void clear();
+
+    // Flash space available for new frames
+    size_t freeBytes();
+
+    // Store the frames of a bundle read from src; returns the number of
+    // frames stored, or -1 if src is not a bundle. Frames that don't fit in
+    // flash are skipped along with every frame after them.
+    int storeBundle(ByteSource &src);
+
+    // Whether a frame is stored for the wake at epoch
+    bool has(time_t epoch);
+
+    // Draw the frame stored for the wake at epoch through the given tone
+    // curve, then delete it
+    esp_err_t show(Inkplate &display, time_t epoch, const dither::Tone &tone);
+
+    // Id of the stored base frame, or nullptr if there is none
+    const char *baseId();
+
+    // Draw the stored base frame into the framebuffer
+    DecodeResult drawBase(Inkplate &display);
+
+    // Passes a packed frame through from src while saving it as the next
+    // base frame, replacing the current one. The copy is dropped unless
+    // commit() is called once the frame was read in full. Only one can be
+    // active at a time.
+    class BaseRecorder : public ByteSource
+    {
+    public:
+        // expected is the size of the frame, 0 if unknown
+        BaseRecorder(ByteSource &src, const String &id, size_t expected);
+        ~BaseRecorder();
+
+        size_t read(uint8_t *dst, size_t len) override;
+
+        // Keep the copy as the base frame; false if it could not be saved
+        bool commit();
+
+    private:
+        ByteSource &src;
+        bool recording = false;
+    };
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <Inkplate.h>
+#include <cstddef>
+#include <cstdint>
+
+// Direct writes into the Inkplate's 4-bit framebuffer (DMemory4Bit: two
+// pixels per byte, even x in the high nibble), bypassing Adafruit_GFX's
+// per-pixel drawPixel() with its rotation math and bounds checks. In the
+// Inkplate 10's 1-bit mode they go to its 1-bit buffer instead (_partial:
+// eight pixels per byte, lowest x in the lowest bit, set for black).
+//
+// The rotation is the ROTATION build flag and the panel size is the board's,
+// both known at compile time, so each build gets one specialized copy:
+// unrotated and upside-down rows are packed 8 pixels per 32-bit store,
+// portrait rows pair up into whole bytes and a band of them is written
+// transposed, one run of bytes per native row, so the framebuffer is still
+// filled in order.
+namespace framebuffer
+{
+    // Whether the display is in 1-bit (black and white) mode; never on the
+    // 6COLOR
+    bool bilevel(Inkplate &display);
+
+    // Switch the Inkplate 10 between 3-bit gray and 1-bit mode, which
+    // refreshes several times faster; the framebuffer is cleared when the
+    // mode changes. Nothing to switch on the 6COLOR.
+    void setBilevel(Inkplate &display, bool on);
+
+    // Adafruit_GFX color for a panel color in the display's current mode:
+    // in 1-bit mode, gray levels 0-3 are black and 4-7 white
+    uint16_t color(Inkplate &display, uint8_t level);
+
+    // Whether direct writes are possible: the buffer exists and the display
+    // is still at the compiled-in rotation
+    bool available(Inkplate &display);
+
+    // Write rows of panel colors (one byte per pixel: gray level 0-7 on the
+    // Inkplate 10, ink id on the 6COLOR) at logical (x, y), pitch bytes
+    // apart, clipped to the display; thresholded as color() does in 1-bit
+    // mode
+    void writeRows(Inkplate &display, int x, int y, const uint8_t *colors, size_t pitch, int width, int rows);
+}
+
+#endif
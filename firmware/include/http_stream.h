@@ -0,0 +1,61 @@
+#ifndef HTTP_STREAM_H
+#define HTTP_STREAM_H
+
+#include <WiFiClient.h>
+#include <atomic>
+
+#include "byte_source.h"
+
+// Pull-based reader for an HTTP response body that transparently handles both
+// identity (Content-Length / read-until-close) and chunked transfer encoding
+class HttpBodyStream : public ByteSource
+{
+public:
+    // timeoutMillis is an idle timeout; it is reset every time data arrives
+    HttpBodyStream(WiFiClient &stream, unsigned long timeoutMillis,
+                   bool isChunked, size_t contentLength);
+
+    // Read exactly len body bytes into dst unless the body ends first
+    size_t read(uint8_t *dst, size_t len) override;
+
+    // Read whatever is already buffered by the socket (at least one byte,
+    // waiting for it if needed) up to len; returns 0 once the body is exhausted
+    size_t readSome(uint8_t *dst, size_t len);
+
+    // Make any pending or future read return 0; safe to call from another task
+    void abort() { aborted.store(true); }
+
+    // True once the whole body has been delivered (or the stream gave up)
+    bool finished() const { return done; }
+
+    // True only if the body ended where the framing said it would, leaving
+    // the connection clean for a keep-alive reuse
+    bool complete() const { return ended; }
+
+    // Number of body bytes delivered so far
+    size_t delivered() const { return total; }
+
+    // Declared body length (0 when unknown)
+    size_t length() const { return contentLength; }
+
+private:
+    // Wait for the socket to have data; false on disconnect or idle timeout
+    bool waitAvailable();
+
+    // Parse the next chunk-size line; false on the terminating zero chunk
+    bool nextChunk();
+
+    WiFiClient &stream;
+    unsigned long timeoutMillis;
+    unsigned long deadline;
+    bool isChunked;
+    size_t contentLength;
+    size_t chunkRemaining = 0;
+    size_t total = 0;
+    bool inChunk = false;
+    bool done = false;
+    bool ended = false;
+    std::atomic<bool> aborted{false};
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef HTTPS_SESSION_H
+#define HTTPS_SESSION_H
+
+#include <HTTPClient.h>
+
+#include "tls_client.h"
+#include "urlparser.h"
+
+// A keep-alive HTTPS connection to the configured API host, shared by every
+// request made during a wake (timezone lookup, image fetch, retries, ...) so
+// the TLS handshake is only paid once. The TLS session itself outlives deep
+// sleep (see TlsClient), so the first request of the next wake resumes it.
+class HttpsSession
+{
+public:
+    HttpsSession();
+
+    // Prepare a request for url, reusing the open connection when it points
+    // at the same host; closes it first when the host differs
+    bool begin(const URLParser::Parser &url);
+
+    // Finish the current request. Pass reusable = false when the response
+    // body was not fully consumed, so the connection is dropped instead of
+    // handing the leftovers to the next request.
+    void end(bool reusable = true);
+
+    // Close the underlying connection
+    void close();
+
+    // Number of requests that reused an already open connection
+    uint32_t reused() const { return reuseCount; }
+
+    // Access the HTTP client for headers, timeouts and the response stream
+    HTTPClient &http() { return client; }
+
+private:
+    TlsClient tls;
+    HTTPClient client;
+    String host;
+    uint32_t reuseCount = 0;
+};
+
+// Shared session against the configured "api" host
+extern HttpsSession apiSession;
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef JPEG_DECODER_H
+#define JPEG_DECODER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "byte_source.h"
+#include "decode_result.h"
+#include "jpeg_utils.h"
+
+// Baseline and progressive JPEG decoder owned by the firmware (replacing the
+// ROM TJpgDec), so it can be profiled, specialized and streamed into.
+//
+// Bytes are pulled from a ByteSource as the entropy decoder needs them, and
+// each completed MCU row is handed to a PixelSink, so decoding overlaps the
+// download and the output side (dithering, framebuffer writes, ...) can be
+// swapped without touching the decoder.
+//
+// Huffman codes of up to LOOKAHEAD_BITS bits resolve with one table lookup,
+// the IDCT is libjpeg's integer AAN (jidctfst.c) with dequantization folded
+// into its scale factors, and the per-block loops are placed in IRAM.
+// Chroma is upsampled by replication.
+//
+// Grayscale panels can ask for luma only, which skips two thirds of the
+// IDCTs of a 4:4:4 image along with all of the color conversion.
+//
+// Images can be decoded at 1/2, 1/4 or 1/8 size with libjpeg's reduced
+// IDCTs (jidctred.c), which is much cheaper than decoding oversized images at
+// full size and shrinking them afterwards.
+//
+// Progressive images can't be drawn until their last scan is in: every scan
+// is decoded into per-component coefficient planes (2 bytes a coefficient,
+// in PSRAM when there is any), which go through the same transforms and
+// output once the image ends. Grayscale panels keep no chroma planes, and
+// skip the chroma AC scans without decoding them.
+//
+// Baseline images with restart markers aligned to MCU rows are split across both
+// cores: once the rest of the input is in memory (ByteSource::remaining()),
+// the RSTn markers ahead are indexed and the rows past the one halfway down
+// what is left are decoded by a task on the other core into a second sink.
+namespace jpeg_decoder
+{
+    // Receives the decoded image, one MCU row at a time
+    class PixelSink
+    {
+    public:
+        virtual ~PixelSink() = default;
+
+        // Called once before any rows (for progressive images, once their
+        // last scan is in); components is 1 (gray) or 3 (RGB888). Return
+        // false to abort the decode.
+        virtual bool begin(uint16_t width, uint16_t height, uint8_t components) = 0;
+
+        // Image rows [y, y + count), each width * components bytes, stride
+        // bytes apart. Return false to abort the decode.
+        virtual bool rows(uint16_t y, uint16_t count, const uint8_t *pixels, size_t stride) = 0;
+
+        // Rows from y on are about to be decoded on the other core: return a
+        // sink for them that can run alongside this one (begin() is not
+        // called on it), or nullptr to keep decoding them here
+        virtual PixelSink *split(uint16_t y) { return nullptr; }
+    };
+
+    class Decoder
+    {
+    public:
+        Decoder();
+        ~Decoder();
+
+        // Read the JPEG headers (up to the start of the first scan) from src
+        // and parse them with jpeg_utils::parseHeader(). Reading stops as
+        // soon as they show the image can't be decoded: UNSUPPORTED right
+        // after an unusable frame header, or for oversized headers.
+        DecodeResult prepare(ByteSource &src);
+
+        // Take headers already parsed from header; src continues from
+        // info.scanOffset, with the entropy-coded data
+        DecodeResult prepare(const jpeg_utils::JpegInfo &info, const uint8_t *header, ByteSource &src);
+
+        // OK if the frame header (SOFn) in info is one this decoder handles:
+        // baseline or progressive, 8-bit, gray or YCbCr with chroma
+        // subsampled at most 2x each way
+        static DecodeResult checkFrame(const jpeg_utils::JpegInfo &info);
+
+        // Decode the scan (all of them, if progressive), handing every MCU
+        // row to sink. MEMORY when a progressive image's coefficients don't
+        // fit.
+        DecodeResult decode(PixelSink &sink);
+
+        // Decode at 1/scale of the full size (1, 2, 4 or 8; rounded down);
+        // call after prepare(), which resets it to 1
+        void setScale(uint8_t scale);
+
+        // Hand color images over as gray (their luma): chroma blocks are
+        // entropy-decoded to get past them, but never transformed,
+        // upsampled or converted. Call after prepare(), which turns it off.
+        void setLumaOnly(bool on);
+
+        // The parsed headers of the first scan, valid after prepare() got
+        // that far (the table offsets refer to bytes that are not kept)
+        const jpeg_utils::JpegInfo &header() const { return info; }
+
+        // Image properties, valid after a successful prepare()
+        uint16_t width() const { return imageWidth; }
+        uint16_t height() const { return imageHeight; }
+        uint8_t components() const { return componentCount == 1 || lumaOnly ? 1 : 3; }
+
+        // Size of the decoded image at the current scale
+        uint16_t outputWidth() const { return (imageWidth + (1 << scaleBits) - 1) >> scaleBits; }
+        uint16_t outputHeight() const { return (imageHeight + (1 << scaleBits) - 1) >> scaleBits; }
+
+    private:
+        static constexpr int LOOKAHEAD_BITS = 9;
+
+        // Huffman table: direct lookup for short codes, canonical decode for
+        // the rest
+        struct Huffman
+        {
+            uint16_t lookup[1 << LOOKAHEAD_BITS]; // (length << 8) | symbol, 0 if longer
+            int32_t maxCode[18];
+            int32_t valueOffset[17];
+            uint8_t values[256];
+        };
+
+        struct Component
+        {
+            uint8_t id;
+            uint8_t h, v;       // Sampling factors
+            uint8_t quant;      // Quantization table
+            uint8_t dcTable;    // Huffman tables, from the scan header
+            uint8_t acTable;
+            int32_t dc;         // DC predictor
+            uint8_t block;      // IDCT output size (8 at full scale)
+            uint8_t upX, upY;   // Replication to the luma grid, as shifts
+            size_t stride;      // Width of the MCU row plane, in samples
+            std::vector<uint8_t> plane; // One MCU row of samples
+            int16_t *coefs = nullptr;   // Progressive: every block, natural order
+            uint16_t blocksX = 0;       // Coefficient plane size, in blocks
+            uint16_t blocksY = 0;
+        };
+
+        // Tables are kept off the (small) task stack
+        struct Tables
+        {
+            int32_t quant[4][64]; // Dequantization, AAN-scaled, natural order
+            uint16_t raw[4][64];  // Dequantization as sent, for the reduced IDCTs
+            Huffman dc[4];
+            Huffman ac[4];
+        };
+
+        // Input
+        bool fetch();
+        int readByte();
+
+        // Second-core decode of the bottom rows (see jpeg_decoder.cpp)
+        struct Split;
+        static void splitTask(void *arg);
+        bool trySplit(PixelSink &sink, uint16_t row);
+        void finishSplit(DecodeResult &res);
+
+        // Tables and markers
+        void buildQuantTable(int id, const uint8_t *values, bool wide);
+        bool buildHuffman(Huffman &table, const uint8_t *counts);
+        bool buildTables(const jpeg_utils::JpegInfo &parsed, const uint8_t *data);
+        bool restart();
+        bool findMarker();
+        size_t readBytes(uint8_t *dst, size_t len);
+
+        // Entropy decoding
+        void fillBits();
+        int decodeSymbol(const Huffman &table);
+        int receive(int size);
+        int receiveExtend(int size);
+        bool decodeBlock(Component &c, int16_t *coef);
+
+        // Progressive scans (see jpeg_decoder.cpp)
+        bool decodeScanBlock(Component &c, int16_t *coef);
+        bool decodeDcFirst(Component &c, int16_t *coef);
+        bool decodeDcRefine(int16_t *coef);
+        bool decodeAcFirst(const Component &c, int16_t *coef);
+        bool decodeAcRefine(const Component &c, int16_t *coef);
+        DecodeResult startScan();
+        DecodeResult decodeScan();
+        DecodeResult nextScan();
+        bool allocateCoefficients();
+        void releaseCoefficients();
+        DecodeResult decodeProgressive(PixelSink &sink);
+
+        // Transform and output
+        void idct(const int16_t *coef, const int32_t *quant, uint8_t *out, size_t stride);
+        void transform(const Component &c, const int16_t *coef, uint8_t *out);
+        void convertRows(uint16_t rows);
+        void allocate();
+        bool emitRows(PixelSink &sink, uint16_t mcuRow);
+        DecodeResult decodeRows(PixelSink &sink, uint16_t firstRow);
+
+        ByteSource *src = nullptr;     // nullptr when decoding from memory
+        uint8_t buffer[512];
+        const uint8_t *input = buffer; // Current block of input
+        size_t inputPos = 0;
+        size_t inputLen = 0;
+
+        uint32_t bits = 0;    // Bit buffer, MSB first
+        int bitCount = 0;
+        bool atMarker = false; // Hit a marker (or the end); feeding zeros
+        bool inputEnded = false;
+        uint8_t marker = 0;
+        uint32_t restarts = 0; // RSTn markers passed
+
+        jpeg_utils::JpegInfo info; // Headers up to the first scan
+        std::shared_ptr<Tables> tables; // Shared with the split decoder
+        Component comps[3];
+        uint8_t componentCount = 0;
+        uint16_t imageWidth = 0;
+        uint16_t imageHeight = 0;
+        uint8_t hMax = 1, vMax = 1;
+        uint16_t mcusX = 0, mcusY = 0;
+        uint16_t restartInterval = 0;
+        uint8_t scaleBits = 0; // Output scale, as log2 of the divisor
+        bool lumaOnly = false; // Skip everything but entropy decoding for chroma
+
+        // Progressive scans
+        bool progressive = false;
+        jpeg_utils::JpegInfo scan; // The scan being decoded
+        uint8_t quantReady = 0, dcReady = 0, acReady = 0; // Tables built, by bit
+        uint8_t scanComps[3] = {}; // Components of the current scan
+        uint32_t eobRun = 0;       // Blocks left in an end-of-band run
+        std::vector<uint8_t> band; // RGB888 output rows of one MCU row
+
+        uint16_t rowLimit = 0; // MCU rows past this one are not decoded here
+        std::unique_ptr<Split> split;
+        bool splitTried = false;
+        const std::atomic<bool> *stop = nullptr; // Set to abandon a split decode
+    };
+}
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef JPEG_STREAM_H
+#define JPEG_STREAM_H
+
+#include <Inkplate.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "box_filter.h"
+#include "byte_source.h"
+#include "decode_result.h"
+#include "dither.h"
+#include "jpeg_decoder.h"
+
+namespace jpeg_stream
+{
+    // Outcome of a streaming decode step; UNSUPPORTED covers arithmetic,
+    // lossless and 12-bit JPEGs
+    using Result = DecodeResult;
+
+    // Incremental JPEG decoder that pulls bytes from a ByteSource as the
+    // decoder needs them and draws each completed MCU row straight into the
+    // display's framebuffer, so download and decode overlap (progressive
+    // images are only drawn once their last scan is in). Images
+    // larger than the display are shrunk to fit it, and grayscale boards
+    // only decode their luma. When the decoder splits the image across both
+    // cores, each half is drawn as its own band.
+    class Decoder : private jpeg_decoder::PixelSink
+    {
+    public:
+        // Parse the JPEG headers (up to the start of scan) from src
+        Result prepare(ByteSource &src);
+
+        // Decode the entropy-coded data and draw it at (x, y), through the
+        // tone curve, quantized with the given dithering mode and shrunk to
+        // fit the display. The display is cleared first, once the decoder
+        // has what it needs to draw.
+        Result draw(Inkplate &display, int x, int y, dither::Mode mode,
+                    const dither::Tone &tone = dither::panelTone());
+
+        // The parsed headers, valid once prepare() got that far; enough to
+        // reject an image before touching the display
+        const jpeg_utils::JpegInfo &header() const { return jpeg.header(); }
+
+        // Source image dimensions, valid after a successful prepare()
+        uint16_t width() const { return jpeg.width(); }
+        uint16_t height() const { return jpeg.height(); }
+
+    private:
+        // Choose the IDCT scale and final size for the space available
+        void fit(int maxWidth, int maxHeight);
+
+        // Rows drawn from one core: their own dithering state and buffer
+        class Band : public jpeg_decoder::PixelSink
+        {
+        public:
+            // Start at output row firstRow of an image width pixels wide
+            bool start(Decoder &owner, uint16_t width, uint16_t firstRow);
+            void end();
+
+            // PixelSink: convert rows to display colors and draw them
+            bool begin(uint16_t, uint16_t, uint8_t) override { return true; }
+            bool rows(uint16_t y, uint16_t count, const uint8_t *pixels, size_t stride) override;
+
+        private:
+            Decoder *owner = nullptr;
+            uint16_t width = 0;
+            dither::Ditherer ditherer;
+            std::vector<uint8_t> quantized; // Panel colors of one MCU row
+        };
+
+        // PixelSink: shrink if needed, then draw through the top band
+        bool begin(uint16_t width, uint16_t height, uint8_t components) override;
+        bool rows(uint16_t y, uint16_t count, const uint8_t *pixels, size_t stride) override;
+        PixelSink *split(uint16_t y) override;
+
+        jpeg_decoder::Decoder jpeg;
+        Inkplate *display = nullptr;
+        int originX = 0;
+        int originY = 0;
+        dither::Mode mode = dither::Mode::NONE;
+        dither::Tone tone;
+        Band top;    // Rows decoded on this core
+        Band bottom; // Rows decoded on the other core, if split
+        BoxFilter filter;
+        bool direct = false;   // Write the framebuffer directly
+        bool bilevel = false;  // Display in 1-bit mode
+        bool resizing = false; // Shrink through the box filter
+        uint8_t components = 3;
+        uint16_t fitWidth = 0;  // Size drawn on the display
+        uint16_t fitHeight = 0;
+        uint16_t nextRow = 0;   // Next shrunk row to draw
+        std::vector<uint8_t> shrunk; // Box filter output of one MCU row
+    };
+}
+
+#endif
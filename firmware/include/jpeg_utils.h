@@ -5,6 +5,8 @@
 #include <cstdint>
 #include <cstddef>
 
+#include "decode_result.h"
+
 namespace jpeg_utils
 {
     // JPEG classifications
@@ -16,59 +18,72 @@ namespace jpeg_utils
         OTHER
     };
 
-    // Inspect raw JPEG bytes and return its kind
-    JpegKind probeKind(const uint8_t *data, std::size_t len);
-
-    // Generic predicate: true if probeKind(...) == Kind
-    template <JpegKind Kind>
-    inline bool isKind(const uint8_t *data, std::size_t len)
+    // What the headers of a JPEG say, up to the start of its (first) scan
+    struct JpegInfo
     {
-        return probeKind(data, len) == Kind;
-    }
+        // OK once the start of scan is reached; INPUT when the headers go on
+        // past the data given, INVALID when they are malformed
+        DecodeResult status = DecodeResult::INVALID;
+        std::size_t needed = 0; // With INPUT: bytes to have before parsing again
+        JpegKind kind = JpegKind::INVALID;
 
-    // Overload for std::vector buffers
-    template <JpegKind Kind>
-    inline bool isKind(const std::vector<uint8_t> &buf)
-    {
-        return isKind<Kind>(buf.data(), buf.size());
-    }
+        // Frame (SOFn)
+        struct Component
+        {
+            uint8_t id;
+            uint8_t h, v;  // Sampling factors
+            uint8_t quant; // Quantization table
+        };
+        uint8_t precision = 0;
+        uint16_t width = 0;
+        uint16_t height = 0;
+        uint8_t componentCount = 0;
+        Component components[4] = {};
 
-    // Convenience aliases
-    inline bool isProgressive(const uint8_t *d, std::size_t l)
-    {
-        return isKind<JpegKind::PROGRESSIVE>(d, l);
-    }
-    inline bool isProgressive(const std::vector<uint8_t> &b)
-    {
-        return isKind<JpegKind::PROGRESSIVE>(b);
-    }
+        // Tables defined before the scan, as offsets into the parsed data (0
+        // if undefined): DQT entries are 64 values in zig-zag order, 16-bit
+        // if wide; DHT entries are 16 code counts followed by the symbols
+        struct QuantTable
+        {
+            uint32_t offset;
+            bool wide;
+        };
+        QuantTable quant[4] = {};
+        uint32_t dcTables[4] = {};
+        uint32_t acTables[4] = {};
 
-    inline bool isBaseline(const uint8_t *d, std::size_t l)
-    {
-        return isKind<JpegKind::BASELINE>(d, l);
-    }
-    inline bool isBaseline(const std::vector<uint8_t> &b)
-    {
-        return isKind<JpegKind::BASELINE>(b);
-    }
+        uint16_t restartInterval = 0; // MCUs, 0 without restart markers
 
-    inline bool isInvalid(const uint8_t *d, std::size_t l)
-    {
-        return isKind<JpegKind::INVALID>(d, l);
-    }
-    inline bool isInvalid(const std::vector<uint8_t> &b)
-    {
-        return isKind<JpegKind::INVALID>(b);
-    }
+        // Scan (SOS)
+        struct ScanComponent
+        {
+            uint8_t id;
+            uint8_t dcTable, acTable; // Huffman (or arithmetic) tables
+        };
+        uint8_t scanCount = 0;
+        ScanComponent scan[4] = {};
+        uint8_t spectralStart = 0, spectralEnd = 0; // Ss, Se
+        uint8_t approxHigh = 0, approxLow = 0;      // Ah, Al
+        std::size_t scanOffset = 0; // First byte of the entropy-coded data
+    };
 
-    inline bool isOther(const uint8_t *d, std::size_t l)
-    {
-        return isKind<JpegKind::OTHER>(d, l);
-    }
-    inline bool isOther(const std::vector<uint8_t> &b)
-    {
-        return isKind<JpegKind::OTHER>(b);
-    }
+    // Parse JPEG headers from SOI up to the end of the first SOS segment in
+    // one pass, without copying any tables
+    JpegInfo parseHeader(const uint8_t *data, std::size_t len);
+
+    // Parse what follows a scan of a progressive JPEG, from the marker that
+    // ended it up to the end of the next SOS segment. Only tables defined
+    // in data are recorded; the frame and restart interval carry over from
+    // previous. At EOI, status is OK and scanCount 0.
+    JpegInfo parseNextScan(const JpegInfo &previous, const uint8_t *data, std::size_t len);
+
+    // Human readable name for a JpegKind
+    const char *kindName(JpegKind kind);
+
+    // Index the RSTn markers in entropy-coded scan data: offsets of the
+    // segments that follow them, in order, up to the end of the scan (any
+    // other marker) or max entries
+    std::vector<std::size_t> restartOffsets(const uint8_t *data, std::size_t len, std::size_t max = SIZE_MAX);
 }
 
 #endif
\ No newline at end of file
@@ -5,6 +5,14 @@
 #include <Inkplate.h>
 #include <PubSubClient.h>
 #include <esp_err.h>
+#include <vector>
+
+#include "time_utils.h"
+
+// DisplayImage result when the panel already shows the requested image (the
+// server answered 304 Not Modified, or sent a byte-identical image); the
+// caller should skip the refresh
+#define IMAGE_UNCHANGED ((esp_err_t)0x1304)
 
 // Global network clients
 extern WiFiClient wifiClient;
@@ -18,11 +26,19 @@ esp_err_t WifiConnect(Inkplate &display, int timeoutSeconds,
 // Connects to the MQTT broker using the provided configuration
 esp_err_t MqttConnect(const JsonVariant &mqttConfig);
 
-// Fetches a JPEG image from a URL and renders it to the Inkplate
+// Fetches an image (JPEG, QOI or packed frame) from a URL and renders it to
+// the Inkplate. Returns IMAGE_UNCHANGED (and draws nothing) when the image on
+// the panel is current.
 esp_err_t DisplayImage(Inkplate &display, int rotation, const char *api,
                        const JsonVariant &imageConfig,
                        const char *renderEndpoint);
 
+// Fetches the frames for the given upcoming wakes in one request and stores
+// them in flash for radio-free wakes
+esp_err_t FetchFrameBundle(int rotation, const char *api,
+                           const JsonVariant &imageConfig,
+                           const std::vector<WakeEntry> &wakes);
+
 // Starts the OTA web server and blocks execution until timeout or reboot
 void StartOTAServer(Inkplate &display, int rotation);
 
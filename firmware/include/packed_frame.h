@@ -0,0 +1,52 @@
+#ifndef PACKED_FRAME_H
+#define PACKED_FRAME_H
+
+#include <Inkplate.h>
+#include <cstddef>
+
+#include "byte_source.h"
+#include "decode_result.h"
+
+// Pre-dithered frames in the panel's native framebuffer layout, produced by
+// the Worker (routes/libs/framebuffer.mjs) so the device skips JPEG decoding
+// and dithering altogether.
+//
+// The frame is the raw DMemory4Bit contents: unrotated E_INK_WIDTH x
+// E_INK_HEIGHT, 4 bits per pixel, two pixels per byte with the even x in the
+// high nibble; values are 3-bit gray levels (0 = black, 7 = white) on the
+// Inkplate 10 and ink ids (INKPLATE_BLACK .. INKPLATE_ORANGE) on the 6COLOR.
+// It is sent as a single LZ4 block, which decodes straight into the
+// framebuffer using the already written pixels as the match window.
+//
+// A delta frame only carries the tiles that differ from a base frame the
+// device kept from an earlier wake (see Keyframe):
+//   header:  "INKD" | u8 version | u8 tile size (pixels) | u16 count
+//   tiles:   count x u16 tile index, row-major over the native panel
+//   pixels:  one LZ4 block with the rows of each tile, tile after tile;
+//            tiles on the right and bottom edges are clipped to the panel
+// Integers are little-endian.
+namespace packed_frame
+{
+    // Content-Type of a packed frame response
+    constexpr const char *CONTENT_TYPE = "application/x-inky-fb";
+
+    // Content-Type of a delta frame response
+    constexpr const char *DELTA_CONTENT_TYPE = "application/x-inky-delta";
+
+    // Value of the X-Inky-Framebuffer request header advertising support
+    // for this board's layout at the given rotation and dithering setting,
+    // and for delta frames if requested
+    String acceptHeader(int rotation, bool delta);
+
+    // Size in bytes of the raw framebuffer
+    size_t frameSize();
+
+    // Decompress a packed frame from src straight into the framebuffer
+    DecodeResult draw(Inkplate &display, ByteSource &src);
+
+    // Apply a delta frame from src on top of the base frame already in the
+    // framebuffer
+    DecodeResult drawDelta(Inkplate &display, ByteSource &src);
+}
+
+#endif
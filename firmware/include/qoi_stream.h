@@ -0,0 +1,81 @@
+#ifndef QOI_STREAM_H
+#define QOI_STREAM_H
+
+#include <Inkplate.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "byte_source.h"
+#include "decode_result.h"
+#include "dither.h"
+
+// Lossless QOI images ("The Quite OK Image Format", qoiformat.org), which the
+// Worker sends for text-heavy browser renders instead of a quality 100 JPEG:
+// smaller on flat colors, free of ringing around glyphs and decoded with a
+// handful of byte operations per pixel.
+//
+//   header:  "qoif" | u32 width | u32 height | u8 channels (3 or 4) |
+//            u8 colorspace
+//   pixels:  QOI_OP_* chunks, row after row
+//   end:     seven 0x00 bytes and a 0x01
+// Integers are big-endian.
+//
+// Rows are decoded as they arrive, dithered through the tone curve and
+// written to the framebuffer in bands, so download and decode overlap as
+// they do for JPEGs. Alpha is composited over white; images larger than
+// the display are clipped to it.
+namespace qoi_stream
+{
+    // Content-Type of a QOI response
+    constexpr const char *CONTENT_TYPE = "image/qoi";
+
+    class Decoder
+    {
+    public:
+        // Read and check the header from src
+        DecodeResult prepare(ByteSource &src);
+
+        // Decode the pixels and draw them at (x, y), through the tone curve,
+        // quantized with the given dithering mode; the display is cleared
+        // first
+        DecodeResult draw(Inkplate &display, int x, int y, dither::Mode mode,
+                          const dither::Tone &tone = dither::panelTone());
+
+        // Image properties, valid after a successful prepare()
+        uint32_t width() const { return imageWidth; }
+        uint32_t height() const { return imageHeight; }
+        uint8_t channels() const { return imageChannels; }
+
+    private:
+        // Input
+        bool fetch();
+        int readByte();
+
+        // Decode the next row into rgb (RGB888, width pixels)
+        bool decodeRow(uint8_t *rgb);
+
+        // Draw a band of dithered rows at display row y
+        void flush(Inkplate &display, int x, int y, int width, int rows);
+
+        ByteSource *src = nullptr;
+        uint8_t buffer[512];
+        size_t inputPos = 0;
+        size_t inputLen = 0;
+
+        uint32_t imageWidth = 0;
+        uint32_t imageHeight = 0;
+        uint8_t imageChannels = 0;
+
+        // Decoder state, carried across rows
+        uint8_t px[4] = {0, 0, 0, 255}; // Previous pixel, RGBA
+        uint8_t index[64][4] = {};      // Recently seen pixels, by hash
+        uint32_t run = 0;               // Repeats of px still to emit
+
+        bool direct = false;           // Write the framebuffer directly
+        dither::Ditherer ditherer;
+        std::vector<uint8_t> quantized; // Panel colors of one band
+    };
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef SCREEN_STATE_H
+#define SCREEN_STATE_H
+
+#include <Arduino.h>
+
+// Tracks which fetched image the e-ink panel is currently showing, in RTC
+// memory so it survives deep sleep. The panel keeps its picture without power,
+// so when the server says the image for an endpoint hasn't changed the wake
+// can skip the download, decode and refresh entirely.
+namespace ScreenState
+{
+    // HTTP validators (ETag / Last-Modified) of the image on the panel, if
+    // that image was fetched from endpoint; false if the panel shows
+    // anything else
+    bool validators(const char *endpoint, String &etag, String &lastModified);
+
+    // Whether the panel shows a frame with this content hash
+    bool showsFrame(uint32_t frame);
+
+    // A new image fetched from endpoint, with the given content hash, was
+    // drawn into the framebuffer and will be shown on the next refresh
+    void imageDrawn(const char *endpoint, const String &etag, const String &lastModified, uint32_t frame);
+
+    // Count a wake that left the panel untouched because its image was
+    // current; returns the total since power-on
+    uint32_t refreshSkipped();
+
+    // The panel was refreshed; unless it showed the image passed to
+    // imageDrawn() the stored validators no longer describe the screen
+    void refreshed();
+
+    // Something other than a fetched image is being put on the panel
+    void invalidate();
+}
+
+#endif
@@ -51,6 +51,10 @@ WakeEntry calculateNextWake(
     const String &defaultEndpoint,
     const String &intervalStr = "");
 
+// Re-apply the timezone of the last NTP sync (kept in RTC memory) on a wake
+// that skips NTP; false if there was none
+bool restoreTimezone();
+
 // Synchronizes the system time using NTP
 esp_err_t NTPSync(Inkplate &display, const char *api, const JsonVariant &ntpConfig);
 
@@ -0,0 +1,64 @@
+#ifndef TLS_CLIENT_H
+#define TLS_CLIENT_H
+
+#include <WiFiClient.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ssl.h>
+
+// TLS client on top of a plain WiFiClient socket with session resumption.
+// The session (ticket or session ID) negotiated with a host is kept in RTC
+// slow memory, or in NVS when it doesn't fit, so the next wake can resume it
+// with an abbreviated handshake instead of a full key exchange.
+//
+// Like WiFiClientSecure::setInsecure(), the server certificate is not
+// verified.
+class TlsClient : public WiFiClient
+{
+public:
+    TlsClient();
+    ~TlsClient();
+
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(IPAddress ip, uint16_t port, int32_t timeout) override;
+    int connect(const char *host, uint16_t port) override;
+    int connect(const char *host, uint16_t port, int32_t timeout) override;
+
+    size_t write(uint8_t data) override;
+    size_t write(const uint8_t *buf, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t *buf, size_t size) override;
+    int peek() override;
+    void flush() override;
+    void stop() override;
+    uint8_t connected() override;
+
+    // Duration of the last handshake and whether it resumed a saved session
+    uint32_t handshakeMillis() const { return lastHandshakeMs; }
+    bool resumed() const { return lastResumed; }
+
+    // Forget any saved session (RTC and NVS)
+    static void clearSavedSession();
+
+private:
+    // mbedtls BIO callbacks over the underlying TCP socket
+    static int bioSend(void *ctx, const unsigned char *buf, size_t len);
+    static int bioRecv(void *ctx, unsigned char *buf, size_t len);
+
+    // Run the TLS handshake on an already connected socket
+    bool handshake(const char *host, uint16_t port, int32_t timeout);
+
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_entropy_context entropy;
+    bool seeded = false;
+    bool active = false;
+    int peeked = -1;
+    int32_t timeoutMs = 0;
+    uint32_t lastHandshakeMs = 0;
+    bool lastResumed = false;
+};
+
+#endif
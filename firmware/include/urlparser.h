@@ -52,6 +52,9 @@ namespace URLParser
         // Get the basic auth
         BasicAuth getBasicAuth() const;
 
+        // Get the domain (host and optional port)
+        String getDomain() const;
+
         // Get the path
         String getPath() const;
 
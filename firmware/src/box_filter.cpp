@@ -0,0 +1,70 @@
+#include <Arduino.h>
+#include <algorithm>
+
+#include "box_filter.h"
+
+// Start shrinking a srcWidth x srcHeight image to dstWidth x dstHeight
+bool BoxFilter::begin(uint16_t sw, uint16_t sh, uint16_t dw, uint16_t dh, uint8_t count)
+{
+    srcWidth = sw;
+    srcHeight = sh;
+    dstWidth = std::max<uint16_t>(1, std::min(dw, sw));
+    dstHeight = std::max<uint16_t>(1, std::min(dh, sh));
+    components = count;
+    srcY = dstY = rowsSummed = 0;
+
+    // Output column x covers source columns [x * sw / dw, (x + 1) * sw / dw)
+    columnEnds.resize(dstWidth);
+    for (uint16_t x = 0; x < dstWidth; x++)
+        columnEnds[x] = (uint32_t)(x + 1) * srcWidth / dstWidth;
+    sums.assign((size_t)dstWidth * components, 0);
+    out.resize((size_t)dstWidth * components);
+    return sums.size() == (size_t)dstWidth * components;
+}
+
+// Add the next source row; returns the finished output row, if any
+IRAM_ATTR const uint8_t *BoxFilter::push(const uint8_t *row)
+{
+    if (srcY >= srcHeight)
+        return nullptr;
+
+    // Sum the row into its output columns
+    uint32_t *sum = sums.data();
+    uint16_t sx = 0;
+    for (uint16_t x = 0; x < dstWidth; x++, sum += components)
+    {
+        for (; sx < columnEnds[x]; sx++, row += components)
+            for (uint8_t c = 0; c < components; c++)
+                sum[c] += row[c];
+    }
+    rowsSummed++;
+
+    // Output row y covers source rows [y * sh / dh, (y + 1) * sh / dh)
+    if (++srcY < (uint32_t)(dstY + 1) * srcHeight / dstHeight)
+        return nullptr;
+
+    sum = sums.data();
+    uint8_t *px = out.data();
+    uint16_t first = 0;
+    for (uint16_t x = 0; x < dstWidth; x++)
+    {
+        uint32_t area = (uint32_t)(columnEnds[x] - first) * rowsSummed;
+        for (uint8_t c = 0; c < components; c++, sum++)
+        {
+            *px++ = (*sum + area / 2) / area;
+            *sum = 0;
+        }
+        first = columnEnds[x];
+    }
+    rowsSummed = 0;
+    dstY++;
+    return out.data();
+}
+
+// Release the row buffers
+void BoxFilter::end()
+{
+    std::vector<uint16_t>().swap(columnEnds);
+    std::vector<uint32_t>().swap(sums);
+    std::vector<uint8_t>().swap(out);
+}
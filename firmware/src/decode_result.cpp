@@ -0,0 +1,20 @@
+#include "decode_result.h"
+
+// Human readable name for a DecodeResult
+const char *decodeResultName(DecodeResult result)
+{
+    switch (result)
+    {
+    case DecodeResult::OK:
+        return "ok";
+    case DecodeResult::UNSUPPORTED:
+        return "unsupported format variant";
+    case DecodeResult::INVALID:
+        return "invalid image data";
+    case DecodeResult::INPUT:
+        return "input stream ended early";
+    case DecodeResult::MEMORY:
+        return "out of memory";
+    }
+    return "unknown";
+}
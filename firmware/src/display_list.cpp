@@ -0,0 +1,235 @@
+#include <Arduino.h>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "display_list.h"
+#include "fonts/FreeSansBoldOblique24pt7b.h"
+#include "framebuffer.h"
+
+namespace display_list
+{
+    // Opcodes
+    enum : uint8_t
+    {
+        END = 0x00,
+        FILL_RECT = 0x01,
+        RECT = 0x02,
+        LINE = 0x03,
+        TEXT = 0x04,
+        BITMAP = 0x05,
+        DRAW = 0x06,
+    };
+
+    // Fonts, by id
+    enum : uint8_t
+    {
+        FONT_SYSTEM = 0,              // Adafruit GFX classic 6x8
+        FONT_SANS_BOLD_OBLIQUE_24 = 1 // FreeSansBoldOblique24pt7b
+    };
+
+    // Bitmaps a list can define, and the largest one (a full panel)
+    static constexpr int MAX_BITMAPS = 32;
+    static constexpr size_t MAX_BITMAP_PIXELS = (size_t)E_INK_WIDTH * E_INK_HEIGHT;
+
+    // Rows above the baseline in the classic font's 8-row cells
+    static constexpr int SYSTEM_ASCENT = 7;
+
+    // A bitmap defined by the list, kept until it ends
+    struct Bitmap
+    {
+        uint16_t width = 0;
+        uint16_t height = 0;
+        std::vector<uint8_t> rows; // ceil(width / 8) bytes each, MSB first
+    };
+
+    // Read exactly len bytes; false if the input ends first
+    static bool readAll(ByteSource &src, uint8_t *dst, size_t len)
+    {
+        while (len)
+        {
+            size_t n = src.read(dst, len);
+            if (n == 0)
+                return false;
+            dst += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    // Little-endian integers from an operand buffer
+    static inline uint16_t u16(const uint8_t *p)
+    {
+        return p[0] | p[1] << 8;
+    }
+    static inline int16_t i16(const uint8_t *p)
+    {
+        return (int16_t)u16(p);
+    }
+
+    // Panel color for a gray level: 3-bit gray on the Inkplate 10 (black or
+    // white in its 1-bit mode), black or white ink on the 6COLOR
+    static inline uint16_t color(Inkplate &display, uint8_t gray)
+    {
+#ifdef ARDUINO_INKPLATECOLOR
+        return gray < 128 ? INKPLATE_BLACK : INKPLATE_WHITE;
+#else
+        return framebuffer::color(display, gray >> 5);
+#endif
+    }
+
+    // Draw a bitmap's set bits, each as a scale x scale square
+    static void drawBitmap(Inkplate &display, const Bitmap &bitmap, int16_t x, int16_t y, uint8_t scale,
+                           uint16_t c)
+    {
+        if (scale <= 1)
+        {
+            display.drawBitmap(x, y, bitmap.rows.data(), bitmap.width, bitmap.height, c);
+            return;
+        }
+        const size_t stride = (bitmap.width + 7) / 8;
+        for (uint16_t r = 0; r < bitmap.height; r++)
+        {
+            const uint8_t *row = &bitmap.rows[r * stride];
+            for (uint16_t b = 0; b < bitmap.width; b++)
+            {
+                // Runs of set bits as one rectangle
+                if (!(row[b >> 3] & (0x80 >> (b & 7))))
+                    continue;
+                uint16_t end = b + 1;
+                while (end < bitmap.width && (row[end >> 3] & (0x80 >> (end & 7))))
+                    end++;
+                display.fillRect(x + b * scale, y + r * scale, (end - b) * scale, scale, c);
+                b = end;
+            }
+        }
+    }
+
+    // Clear the display and draw the list read from src
+    DecodeResult draw(Inkplate &display, ByteSource &src)
+    {
+        uint8_t header[9];
+        if (!readAll(src, header, sizeof(header)))
+            return DecodeResult::INPUT;
+        if (memcmp(header, "INKL", 4))
+            return DecodeResult::INVALID;
+        if (header[4] != VERSION)
+            return DecodeResult::UNSUPPORTED;
+
+        // Bitmaps are rare and can be large; keep their table off the stack
+        std::unique_ptr<Bitmap[]> bitmaps(new (std::nothrow) Bitmap[MAX_BITMAPS]);
+        if (!bitmaps)
+            return DecodeResult::MEMORY;
+
+        display.clearDisplay();
+        display.setTextWrap(false);
+
+        DecodeResult res = DecodeResult::OK;
+        uint8_t op, args[9];
+        char text[256];
+        while (res == DecodeResult::OK)
+        {
+            if (!readAll(src, &op, 1))
+            {
+                res = DecodeResult::INPUT;
+                break;
+            }
+            if (op == END)
+                break;
+
+            switch (op)
+            {
+            case FILL_RECT:
+            case RECT:
+                if (!readAll(src, args, 9))
+                    res = DecodeResult::INPUT;
+                else if (op == FILL_RECT)
+                    display.fillRect(i16(args), i16(args + 2), u16(args + 4), u16(args + 6), color(display, args[8]));
+                else
+                    display.drawRect(i16(args), i16(args + 2), u16(args + 4), u16(args + 6), color(display, args[8]));
+                break;
+
+            case LINE:
+                if (!readAll(src, args, 9))
+                    res = DecodeResult::INPUT;
+                else
+                    display.drawLine(i16(args), i16(args + 2), i16(args + 4), i16(args + 6), color(display, args[8]));
+                break;
+
+            case TEXT:
+            {
+                if (!readAll(src, args, 8) || !readAll(src, (uint8_t *)text, args[7]))
+                {
+                    res = DecodeResult::INPUT;
+                    break;
+                }
+                text[args[7]] = '\0';
+                uint8_t font = args[4], scale = max<uint8_t>(args[5], 1);
+                if (font > FONT_SANS_BOLD_OBLIQUE_24)
+                {
+                    res = DecodeResult::INVALID;
+                    break;
+                }
+                // GFX fonts are positioned at their baseline, the classic
+                // font at the top of its cell
+                int16_t y = i16(args + 2);
+                if (font == FONT_SYSTEM)
+                {
+                    display.setFont();
+                    y -= SYSTEM_ASCENT * scale;
+                }
+                else
+                {
+                    display.setFont(&FreeSansBoldOblique24pt7b);
+                }
+                display.setTextSize(scale);
+                display.setTextColor(color(display, args[6]));
+                display.setCursor(i16(args), y);
+                display.print(text);
+                break;
+            }
+
+            case BITMAP:
+            {
+                if (!readAll(src, args, 5))
+                {
+                    res = DecodeResult::INPUT;
+                    break;
+                }
+                uint8_t id = args[0];
+                uint16_t w = u16(args + 1), h = u16(args + 3);
+                if (id >= MAX_BITMAPS || (size_t)w * h > MAX_BITMAP_PIXELS)
+                {
+                    res = DecodeResult::INVALID;
+                    break;
+                }
+                Bitmap &bitmap = bitmaps[id];
+                bitmap.width = w;
+                bitmap.height = h;
+                bitmap.rows.resize((size_t)(w + 7) / 8 * h);
+                if (!readAll(src, bitmap.rows.data(), bitmap.rows.size()))
+                    res = DecodeResult::INPUT;
+                break;
+            }
+
+            case DRAW:
+                if (!readAll(src, args, 7))
+                    res = DecodeResult::INPUT;
+                else if (args[0] >= MAX_BITMAPS || bitmaps[args[0]].rows.empty())
+                    res = DecodeResult::INVALID;
+                else
+                    drawBitmap(display, bitmaps[args[0]], i16(args + 1), i16(args + 3), args[5], color(display, args[6]));
+                break;
+
+            default:
+                res = DecodeResult::INVALID;
+                break;
+            }
+        }
+
+        // Leave the text settings as the logger expects them
+        display.setFont();
+        display.setTextSize(1);
+        return res;
+    }
+}
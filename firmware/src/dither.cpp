@@ -0,0 +1,422 @@
+#include <Arduino.h>
+#include <algorithm>
+#include <cstring>
+
+#include "definitions.h"
+#include "dither.h"
+
+namespace dither
+{
+#ifdef ARDUINO_INKPLATECOLOR
+    // Approximate RGB of the 6COLOR panel inks, indexed by Inkplate color id
+    static constexpr uint8_t palette[][3] = {
+        {0, 0, 0},       // INKPLATE_BLACK
+        {255, 255, 255}, // INKPLATE_WHITE
+        {67, 138, 28},   // INKPLATE_GREEN
+        {42, 42, 126},   // INKPLATE_BLUE
+        {190, 60, 42},   // INKPLATE_RED
+        {255, 222, 51},  // INKPLATE_YELLOW
+        {220, 112, 40},  // INKPLATE_ORANGE
+    };
+    static constexpr int CHANNELS = 3;
+
+    // How far the ordered thresholds push each channel
+    static constexpr int ORDERED_SPREAD = 64;
+
+    // Bits per channel of the palette lookup
+    static constexpr int LUT_BITS = 5;
+    static constexpr int LUT_SHIFT = 8 - LUT_BITS;
+
+    // Perceptual distance between two colors: squared RGB weighted by the
+    // mean red level ("redmean"), which tracks CIELAB closely for a fraction
+    // of the cost
+    static constexpr int32_t colorDistance(int r1, int g1, int b1, int r2, int g2, int b2)
+    {
+        int32_t rmean = (r1 + r2) / 2, dr = r1 - r2, dg = g1 - g2, db = b1 - b2;
+        return (((512 + rmean) * dr * dr) >> 8) + 4 * dg * dg + (((767 - rmean) * db * db) >> 8);
+    }
+
+    // Closest ink for every LUT_BITS-per-channel RGB cell (matched at the
+    // cell center), built by the compiler and kept in flash
+    struct PaletteLut
+    {
+        uint8_t index[1 << (3 * LUT_BITS)];
+
+        constexpr PaletteLut() : index()
+        {
+            constexpr int cells = 1 << LUT_BITS, half = (1 << LUT_SHIFT) / 2;
+            for (int i = 0; i < cells * cells * cells; i++)
+            {
+                int r = ((i >> (2 * LUT_BITS)) << LUT_SHIFT) + half;
+                int g = (((i >> LUT_BITS) & (cells - 1)) << LUT_SHIFT) + half;
+                int b = ((i & (cells - 1)) << LUT_SHIFT) + half;
+                int32_t bestDist = INT32_MAX;
+                for (uint8_t c = 0; c < sizeof(palette) / sizeof(palette[0]); c++)
+                {
+                    int32_t dist = colorDistance(r, g, b, palette[c][0], palette[c][1], palette[c][2]);
+                    if (dist < bestDist)
+                    {
+                        bestDist = dist;
+                        index[i] = c;
+                    }
+                }
+            }
+        }
+    };
+    static constexpr PaletteLut paletteLut;
+
+    // Closest palette entry to an RGB value: one lookup
+    static inline uint8_t nearestColor(int r, int g, int b)
+    {
+        return paletteLut.index[((r >> LUT_SHIFT) << (2 * LUT_BITS)) | ((g >> LUT_SHIFT) << LUT_BITS) |
+                                (b >> LUT_SHIFT)];
+    }
+#else
+    static constexpr int CHANNELS = 1;
+#endif
+
+    // Natural logarithm, usable by the compiler (<cmath> isn't constexpr)
+    static constexpr double logC(double x)
+    {
+        // ln(x) = k ln(2) + 2 atanh((m - 1) / (m + 1)), m in [1, 2)
+        int k = 0;
+        for (; x >= 2; x /= 2)
+            k++;
+        for (; x < 1; x *= 2)
+            k--;
+        double y = (x - 1) / (x + 1), y2 = y * y, term = y, sum = 0;
+        for (int n = 1; n < 40; n += 2, term *= y2)
+            sum += term / n;
+        return 2 * sum + k * 0.6931471805599453;
+    }
+
+    // Exponential, usable by the compiler
+    static constexpr double expC(double x)
+    {
+        // e^x = (e^(x / 2^k))^(2^k), the Taylor series for |x| <= 1/2
+        int k = 0;
+        for (; x > 0.5 || x < -0.5; x /= 2)
+            k++;
+        double sum = 1, term = 1;
+        for (int n = 1; n < 20; n++)
+        {
+            term *= x / n;
+            sum += term;
+        }
+        for (; k > 0; k--)
+            sum *= sum;
+        return sum;
+    }
+
+    // A sample through a tone curve
+    static constexpr uint8_t toneLevel(int v, const Tone &tone)
+    {
+        if (v <= tone.black)
+            return 0;
+        if (v >= tone.white)
+            return 255;
+        double t = double(v - tone.black) / (tone.white - tone.black);
+        if (tone.gamma != 1.0f)
+            t = expC(logC(t) / tone.gamma);
+        return static_cast<uint8_t>(t * 255 + 0.5);
+    }
+
+    // The panel's tone curve, built by the compiler and kept in flash
+    static constexpr Tone PANEL_TONE = {TONE_BLACK, TONE_WHITE, TONE_GAMMA};
+    struct ToneLut
+    {
+        uint8_t level[256];
+
+        constexpr ToneLut() : level()
+        {
+            for (int v = 0; v < 256; v++)
+                level[v] = toneLevel(v, PANEL_TONE);
+        }
+    };
+    static constexpr ToneLut panelLut;
+
+    // Error rows kept: the current one and two below (Atkinson reaches y + 2)
+    static constexpr int ERROR_ROWS = 3;
+
+    // Columns of padding on each side of an error row
+    static constexpr int PAD = 2;
+
+    // Where a share of the error goes, relative to the current pixel
+    struct Tap
+    {
+        int8_t dx, dy;
+        uint8_t weight;
+    };
+
+    // Error diffusion kernels; weights sum to at most 1 << SHIFT
+    struct FloydSteinberg
+    {
+        static constexpr int SHIFT = 4;
+        static constexpr Tap TAPS[] = {{1, 0, 7}, {-1, 1, 3}, {0, 1, 5}, {1, 1, 1}};
+    };
+    struct Atkinson
+    {
+        static constexpr int SHIFT = 3;
+        static constexpr Tap TAPS[] = {{1, 0, 1}, {2, 0, 1}, {-1, 1, 1}, {0, 1, 1}, {1, 1, 1}, {0, 2, 1}};
+    };
+    struct SierraLite
+    {
+        static constexpr int SHIFT = 2;
+        static constexpr Tap TAPS[] = {{1, 0, 2}, {-1, 1, 1}, {0, 1, 1}};
+    };
+
+    // 32x32 blue-noise threshold map (void-and-cluster), values 0-255
+    static constexpr int MAP_SIZE = 32;
+    static const uint8_t BLUE_NOISE[MAP_SIZE * MAP_SIZE] = {
+        27, 184, 243, 116, 28, 224, 181, 238, 49, 206, 103, 62, 203, 150, 45, 182, 131, 71, 177, 114, 88, 234, 24, 212, 76, 161, 96, 175, 210, 158, 112, 198,
+        125, 157, 90, 50, 136, 78, 11, 111, 162, 74, 229, 179, 10, 95, 230, 22, 209, 8, 154, 30, 207, 139, 49, 175, 241, 36, 231, 3, 134, 32, 224, 58,
+        212, 40, 233, 176, 199, 252, 148, 218, 34, 135, 19, 122, 252, 68, 166, 120, 82, 250, 97, 224, 63, 186, 83, 126, 14, 150, 115, 84, 247, 75, 178, 100,
+        22, 141, 73, 9, 102, 39, 60, 93, 176, 244, 89, 160, 38, 141, 205, 56, 187, 142, 46, 166, 120, 1, 254, 100, 200, 67, 217, 187, 53, 145, 12, 242,
+        189, 110, 168, 226, 128, 164, 192, 123, 4, 201, 57, 217, 183, 104, 2, 241, 28, 113, 232, 23, 193, 151, 37, 226, 166, 47, 136, 24, 108, 206, 161, 85,
+        230, 47, 202, 30, 83, 239, 20, 216, 73, 143, 115, 25, 75, 225, 134, 94, 170, 67, 201, 81, 102, 214, 73, 138, 17, 91, 246, 173, 227, 38, 124, 60,
+        6, 136, 69, 154, 209, 55, 106, 156, 236, 44, 190, 246, 155, 52, 192, 37, 215, 152, 7, 137, 241, 52, 178, 110, 212, 193, 120, 4, 68, 95, 253, 174,
+        217, 100, 245, 119, 1, 185, 133, 34, 91, 172, 8, 88, 126, 17, 233, 77, 121, 249, 55, 172, 31, 126, 9, 248, 59, 33, 78, 160, 138, 202, 19, 148,
+        43, 191, 28, 171, 90, 255, 70, 222, 195, 122, 63, 221, 167, 101, 177, 146, 21, 98, 209, 87, 225, 197, 159, 94, 149, 181, 237, 217, 49, 183, 114, 79,
+        164, 131, 64, 228, 46, 146, 13, 163, 25, 246, 148, 201, 40, 253, 61, 204, 45, 188, 158, 13, 113, 72, 41, 232, 21, 131, 103, 16, 90, 229, 30, 238,
+        95, 10, 210, 108, 196, 124, 214, 83, 111, 50, 99, 15, 79, 137, 5, 108, 237, 129, 65, 247, 142, 185, 211, 122, 65, 204, 42, 171, 152, 124, 66, 205,
+        52, 248, 156, 78, 22, 167, 40, 235, 138, 188, 215, 165, 116, 183, 213, 155, 81, 17, 175, 32, 94, 54, 2, 167, 86, 254, 188, 58, 243, 0, 178, 140,
+        189, 118, 35, 184, 242, 99, 63, 178, 10, 72, 33, 227, 51, 240, 70, 34, 229, 193, 118, 221, 155, 240, 107, 220, 140, 13, 112, 137, 80, 219, 106, 26,
+        87, 230, 61, 132, 3, 223, 119, 208, 153, 251, 128, 88, 152, 20, 130, 169, 96, 140, 49, 75, 198, 26, 179, 61, 38, 160, 213, 28, 192, 45, 156, 208,
+        8, 172, 150, 90, 199, 147, 29, 86, 50, 107, 203, 0, 186, 105, 203, 47, 4, 255, 210, 15, 114, 135, 82, 236, 195, 101, 74, 240, 94, 127, 249, 66,
+        104, 214, 25, 253, 44, 71, 172, 238, 191, 27, 169, 231, 56, 248, 80, 223, 180, 110, 84, 162, 245, 42, 153, 6, 123, 230, 53, 167, 6, 180, 36, 141,
+        236, 52, 123, 163, 108, 211, 134, 6, 97, 149, 66, 117, 139, 24, 150, 125, 62, 154, 32, 184, 68, 218, 191, 93, 173, 18, 144, 206, 110, 228, 79, 198,
+        13, 182, 76, 194, 12, 235, 55, 121, 218, 245, 42, 84, 216, 176, 40, 196, 12, 231, 205, 100, 9, 127, 54, 252, 70, 220, 35, 130, 62, 18, 164, 120,
+        96, 145, 244, 35, 89, 151, 184, 78, 20, 180, 130, 197, 7, 101, 242, 71, 96, 132, 50, 143, 235, 170, 109, 27, 158, 105, 187, 87, 251, 147, 220, 42,
+        174, 213, 59, 133, 223, 105, 39, 207, 159, 93, 29, 228, 163, 54, 117, 208, 170, 247, 19, 190, 74, 37, 209, 140, 202, 48, 237, 164, 26, 102, 194, 68,
+        29, 112, 1, 198, 170, 18, 239, 138, 60, 250, 113, 69, 142, 235, 15, 151, 33, 82, 113, 221, 160, 92, 240, 14, 85, 125, 3, 75, 205, 51, 131, 246,
+        159, 234, 77, 119, 48, 72, 193, 117, 15, 174, 213, 43, 192, 81, 129, 185, 61, 216, 136, 57, 0, 119, 187, 65, 175, 215, 153, 226, 111, 177, 8, 89,
+        39, 188, 143, 210, 255, 162, 91, 225, 51, 84, 151, 2, 102, 218, 29, 253, 93, 195, 27, 177, 251, 145, 46, 229, 103, 24, 56, 137, 31, 234, 149, 215,
+        99, 62, 16, 97, 31, 145, 4, 181, 134, 200, 232, 121, 169, 51, 155, 111, 5, 147, 234, 98, 71, 211, 18, 133, 166, 241, 199, 92, 189, 76, 56, 124,
+        247, 165, 225, 183, 125, 63, 233, 43, 107, 23, 69, 35, 245, 197, 73, 227, 171, 55, 122, 36, 161, 109, 190, 88, 32, 69, 118, 11, 254, 163, 22, 195,
+        5, 116, 45, 79, 244, 196, 98, 207, 162, 252, 179, 146, 95, 10, 126, 41, 207, 80, 182, 203, 7, 226, 59, 249, 157, 219, 176, 47, 130, 103, 224, 139,
+        67, 200, 148, 25, 168, 16, 154, 67, 11, 86, 127, 222, 59, 186, 236, 144, 104, 16, 248, 132, 85, 144, 43, 128, 106, 21, 142, 211, 66, 181, 34, 86,
+        168, 242, 92, 222, 114, 48, 135, 239, 115, 216, 46, 17, 112, 161, 83, 23, 221, 156, 64, 44, 237, 173, 208, 12, 196, 82, 233, 97, 1, 243, 152, 214,
+        14, 39, 128, 60, 182, 212, 81, 174, 31, 190, 157, 200, 243, 36, 206, 57, 179, 116, 199, 98, 19, 115, 72, 159, 239, 58, 37, 168, 204, 117, 53, 101,
+        232, 189, 158, 21, 250, 104, 7, 228, 58, 133, 77, 99, 65, 141, 123, 255, 89, 3, 231, 153, 186, 219, 33, 91, 132, 180, 107, 149, 74, 26, 194, 135,
+        48, 109, 219, 85, 143, 41, 202, 157, 109, 250, 0, 222, 173, 14, 194, 30, 165, 139, 38, 76, 129, 57, 251, 191, 5, 223, 20, 249, 129, 227, 171, 80,
+        147, 70, 2, 204, 169, 64, 127, 87, 23, 185, 146, 41, 118, 238, 77, 106, 220, 54, 244, 201, 11, 165, 105, 144, 53, 121, 197, 64, 44, 92, 9, 254,
+    };
+
+    // Mode names, indexed by Mode
+    static const char *const NAMES[] = {"none", "floyd-steinberg", "atkinson", "sierra-lite", "ordered"};
+
+    // Mode for images that don't ask for one
+    Mode defaultMode()
+    {
+        return DITHERING ? Mode::FLOYD_STEINBERG : Mode::NONE;
+    }
+
+    // Parse a mode name as sent in X-Inky-Dither
+    Mode parse(const char *text, Mode fallback)
+    {
+        if (!text)
+            return fallback;
+        for (uint8_t i = 0; i < sizeof(NAMES) / sizeof(NAMES[0]); i++)
+        {
+            if (strcasecmp(text, NAMES[i]) == 0)
+                return static_cast<Mode>(i);
+        }
+        if (strcasecmp(text, "blue-noise") == 0)
+            return Mode::ORDERED;
+        return fallback;
+    }
+
+    // Name of a mode
+    const char *name(Mode mode)
+    {
+        return NAMES[static_cast<uint8_t>(mode)];
+    }
+
+    // Mode from its id
+    Mode fromId(uint8_t id, Mode fallback)
+    {
+        return id < sizeof(NAMES) / sizeof(NAMES[0]) ? static_cast<Mode>(id) : fallback;
+    }
+
+    // This panel's tone
+    Tone panelTone()
+    {
+        return PANEL_TONE;
+    }
+
+    // Parse "key=value" pairs over fallback
+    Tone parseTone(const char *text, const Tone &fallback)
+    {
+        Tone tone = fallback;
+        if (!text)
+            return fallback;
+        for (const char *p = text; *p;)
+        {
+            // Key up to '=', value up to the next separator
+            while (*p == ' ' || *p == ',' || *p == ';')
+                p++;
+            const char *key = p;
+            while (isalpha(static_cast<unsigned char>(*p)))
+                p++;
+            size_t keyLen = p - key;
+            while (*p == ' ')
+                p++;
+            if (!keyLen && !*p)
+                break; // Trailing separators
+            if (*p != '=')
+                return fallback;
+            char *end;
+            float value = strtof(p + 1, &end);
+            if (end == p + 1)
+                return fallback;
+            p = end;
+
+            if (keyLen == 5 && strncasecmp(key, "black", 5) == 0 && value >= 0 && value <= 255)
+                tone.black = value;
+            else if (keyLen == 5 && strncasecmp(key, "white", 5) == 0 && value >= 0 && value <= 255)
+                tone.white = value;
+            else if (keyLen == 5 && strncasecmp(key, "gamma", 5) == 0 && value >= 0.1f && value <= 10)
+                tone.gamma = value;
+            else
+                return fallback;
+        }
+        return tone.black < tone.white ? tone : fallback;
+    }
+
+    // A tone in the form parseTone() reads
+    String formatTone(const Tone &tone)
+    {
+        return String("black=") + tone.black + ", white=" + tone.white + ", gamma=" + String(tone.gamma, 3);
+    }
+
+    // Whether two tones give the same curve
+    bool sameTone(const Tone &a, const Tone &b)
+    {
+        return a.black == b.black && a.white == b.white && a.gamma == b.gamma;
+    }
+
+    // Start an image of the given width
+    bool Ditherer::begin(Mode m, uint16_t w, uint32_t firstLine, const Tone &tone, bool bilevel)
+    {
+        // Black and white only: one step of 7 gray levels
+        levels = bilevel ? 1 : 7;
+        step = 7 / levels;
+
+        // The panel's curve is already built; anything else takes 256 steps
+        if (sameTone(tone, PANEL_TONE))
+            memcpy(curve, panelLut.level, sizeof(curve));
+        else
+        {
+            for (int v = 0; v < 256; v++)
+                curve[v] = toneLevel(v, tone);
+        }
+
+        mode = m;
+        width = w;
+        line = firstLine;
+        stride = w + 2 * PAD;
+        if (mode == Mode::NONE || mode == Mode::ORDERED)
+            return true;
+        err.assign(ERROR_ROWS * CHANNELS * stride, 0);
+        return err.size() == ERROR_ROWS * CHANNELS * stride;
+    }
+
+    // Release the error rows
+    void Ditherer::end()
+    {
+        std::vector<int16_t>().swap(err);
+    }
+
+    // Error diffusion over one row
+    template <typename Kernel>
+    IRAM_ATTR void Ditherer::diffuse(const uint8_t *px, uint8_t components, uint8_t *out)
+    {
+        // Rows y, y + 1 and y + 2 of the ring, past the left padding
+        int16_t *rows[ERROR_ROWS];
+        for (int r = 0; r < ERROR_ROWS; r++)
+            rows[r] = &err[((line + r) % ERROR_ROWS) * CHANNELS * stride + PAD];
+
+        for (uint16_t x = 0; x < width; x++, px += components)
+        {
+#ifdef ARDUINO_INKPLATECOLOR
+            int v[3] = {curve[px[0]], curve[px[components == 3 ? 1 : 0]], curve[px[components == 3 ? 2 : 0]]};
+            for (int ch = 0; ch < 3; ch++)
+                v[ch] = constrain(v[ch] + (rows[0][ch * stride + x] >> Kernel::SHIFT), 0, 255);
+            uint8_t color = nearestColor(v[0], v[1], v[2]);
+            for (int ch = 0; ch < 3; ch++)
+            {
+                int e = v[ch] - palette[color][ch];
+                for (const Tap &t : Kernel::TAPS)
+                    rows[t.dy][ch * stride + x + t.dx] += e * t.weight;
+            }
+#else
+            // ITU-R BT.601 luma
+            int v = curve[components == 1 ? px[0] : (px[0] * 77 + px[1] * 150 + px[2] * 29) >> 8];
+            v = constrain(v + (rows[0][x] >> Kernel::SHIFT), 0, 255);
+            uint8_t color = (v * levels + 127) / 255 * step;
+            int e = v - (color * 255) / 7;
+            for (const Tap &t : Kernel::TAPS)
+                rows[t.dy][x + t.dx] += e * t.weight;
+#endif
+            out[x] = color;
+        }
+
+        // The current row becomes y + 3
+        for (int ch = 0; ch < CHANNELS; ch++)
+            std::fill_n(rows[0] - PAD + ch * stride, stride, 0);
+    }
+
+    // Threshold map over one row
+    IRAM_ATTR void Ditherer::ordered(const uint8_t *px, uint8_t components, uint8_t *out)
+    {
+        const uint8_t *map = &BLUE_NOISE[(line % MAP_SIZE) * MAP_SIZE];
+        for (uint16_t x = 0; x < width; x++, px += components)
+        {
+            int t = map[x % MAP_SIZE];
+#ifdef ARDUINO_INKPLATECOLOR
+            int offset = ((t - 128) * ORDERED_SPREAD) >> 8;
+            int r = curve[px[0]], g = curve[px[components == 3 ? 1 : 0]], b = curve[px[components == 3 ? 2 : 0]];
+            out[x] = nearestColor(constrain(r + offset, 0, 255), constrain(g + offset, 0, 255),
+                                  constrain(b + offset, 0, 255));
+#else
+            // Round up with probability equal to the fraction between levels;
+            // the threshold is scaled to 0-254 so black never rounds up
+            int v = curve[components == 1 ? px[0] : (px[0] * 77 + px[1] * 150 + px[2] * 29) >> 8];
+            out[x] = std::min<int>((v * levels + (t * 255 >> 8)) / 255, levels) * step;
+#endif
+        }
+    }
+
+    // Quantize the next row
+    void Ditherer::row(const uint8_t *px, uint8_t components, uint8_t *out)
+    {
+        switch (mode)
+        {
+        case Mode::FLOYD_STEINBERG:
+            diffuse<FloydSteinberg>(px, components, out);
+            break;
+        case Mode::ATKINSON:
+            diffuse<Atkinson>(px, components, out);
+            break;
+        case Mode::SIERRA_LITE:
+            diffuse<SierraLite>(px, components, out);
+            break;
+        case Mode::ORDERED:
+            ordered(px, components, out);
+            break;
+        default:
+            for (uint16_t x = 0; x < width; x++, px += components)
+            {
+#ifdef ARDUINO_INKPLATECOLOR
+                out[x] = nearestColor(curve[px[0]], curve[px[components == 3 ? 1 : 0]],
+                                      curve[px[components == 3 ? 2 : 0]]);
+#else
+                int v = curve[components == 1 ? px[0] : (px[0] * 77 + px[1] * 150 + px[2] * 29) >> 8];
+                out[x] = (v * levels + 127) / 255 * step;
+#endif
+            }
+            break;
+        }
+        line++;
+    }
+}
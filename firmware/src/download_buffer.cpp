@@ -0,0 +1,278 @@
+#include <Arduino.h>
+#include <esp32/rom/crc.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+#include "download_buffer.h"
+#include "logger.h"
+
+// Smallest region worth allocating; one TLS record is at most 16 KiB
+static constexpr size_t MIN_REGION = 16 * 1024;
+
+// Stack for the fetch task; TLS record decryption runs on it
+static constexpr uint32_t PRODUCER_STACK = 8192;
+
+// Microsecond timestamp, truncated for interval math
+static inline uint32_t nowUs()
+{
+    return static_cast<uint32_t>(esp_timer_get_time());
+}
+
+DownloadBuffer::DownloadBuffer()
+{
+    dataReady = xSemaphoreCreateBinary();
+    spaceReady = xSemaphoreCreateBinary();
+    exited = xSemaphoreCreateBinary();
+}
+
+DownloadBuffer::~DownloadBuffer()
+{
+    cancel();
+    if (region)
+        heap_caps_free(region);
+    vSemaphoreDelete(dataReady);
+    vSemaphoreDelete(spaceReady);
+    vSemaphoreDelete(exited);
+}
+
+// Make sure the region can hold a body of contentLength bytes, capped at maxBytes
+bool DownloadBuffer::reserve(size_t contentLength, size_t maxBytes)
+{
+    size_t want = (contentLength > 0 && contentLength < maxBytes) ? contentLength : maxBytes;
+    if (want < MIN_REGION)
+        want = MIN_REGION;
+    if (want <= cap)
+        return true;
+
+    // Prefer PSRAM, fall back to internal RAM if there is none
+    uint8_t *grown = static_cast<uint8_t *>(heap_caps_malloc(want, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    if (!grown)
+        grown = static_cast<uint8_t *>(heap_caps_malloc(want, MALLOC_CAP_8BIT));
+    if (!grown)
+    {
+        // Keep streaming through the existing region as a ring, if we have one
+        Logger::logf(Logger::LOG_WARNING, "Download buffer: failed to allocate %u bytes", want);
+        return cap > 0;
+    }
+
+    if (region)
+        heap_caps_free(region);
+    region = grown;
+    cap = want;
+    Logger::logf(Logger::LOG_DEBUG, "Download buffer: reserved %u bytes", cap);
+    return true;
+}
+
+// Start a new body: reset positions and pull from the given stream
+void DownloadBuffer::begin(HttpBodyStream &stream)
+{
+    cancel();
+    body = &stream;
+    head.store(0);
+    tail.store(0);
+    finished.store(false);
+    cancelled.store(false);
+    peak = 0;
+    fills = 0;
+    timing = {};
+    crc = 0;
+    started = nowUs();
+
+    // Drop any stale wake-ups from the previous body
+    xSemaphoreTake(dataReady, 0);
+    xSemaphoreTake(spaceReady, 0);
+}
+
+// Read the next block from the socket into the free space of the ring
+size_t DownloadBuffer::fill()
+{
+    if (!body || !region)
+        return 0;
+
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t used = t - head.load(std::memory_order_acquire);
+    if (used == cap)
+        return 0;
+
+    // Only the contiguous run up to the end of the region can be filled
+    size_t pos = t % cap;
+    size_t space = min(cap - used, cap - pos);
+
+    uint32_t t0 = nowUs();
+    size_t n = body->readSome(region + pos, space);
+    timing.fetchBusyUs += nowUs() - t0;
+
+    if (n > 0)
+    {
+        // Hash while the block is hot in cache, before the consumer sees it
+        crc = crc32_le(crc, region + pos, n);
+        tail.store(t + n, std::memory_order_release);
+        fills++;
+        if (used + n > peak)
+            peak = used + n;
+    }
+    return n;
+}
+
+// Fetch task: keep the ring full until the body ends or we are cancelled
+void DownloadBuffer::producerTask(void *arg)
+{
+    DownloadBuffer *self = static_cast<DownloadBuffer *>(arg);
+
+    while (!self->cancelled.load())
+    {
+        // Back-pressure: wait for the consumer to free up space
+        if (self->tail.load() - self->head.load() == self->cap)
+        {
+            uint32_t t0 = nowUs();
+            xSemaphoreTake(self->spaceReady, pdMS_TO_TICKS(50));
+            self->timing.fetchStallUs += nowUs() - t0;
+            continue;
+        }
+
+        if (self->fill() == 0)
+            break;
+        xSemaphoreGive(self->dataReady);
+    }
+
+    self->finished.store(true);
+    xSemaphoreGive(self->dataReady);
+    xSemaphoreGive(self->exited);
+    vTaskDelete(nullptr);
+}
+
+// Spawn the fetch task on the core not running the caller
+bool DownloadBuffer::startProducer()
+{
+    if (!body || !region || producer)
+        return false;
+
+    BaseType_t core = xPortGetCoreID() == 0 ? 1 : 0;
+    xSemaphoreTake(exited, 0);
+    if (xTaskCreatePinnedToCore(producerTask, "inky-fetch", PRODUCER_STACK, this,
+                                uxTaskPriorityGet(nullptr), &producer, core) != pdPASS)
+    {
+        producer = nullptr;
+        Logger::log(Logger::LOG_WARNING, "Fetch task unavailable; reading inline.");
+        return false;
+    }
+    return true;
+}
+
+// Stop the fetch task (if any) and wait for it to exit
+void DownloadBuffer::cancel()
+{
+    if (producer)
+    {
+        cancelled.store(true);
+        if (body)
+            body->abort();
+        xSemaphoreGive(spaceReady);
+        xSemaphoreTake(exited, portMAX_DELAY);
+        producer = nullptr;
+    }
+
+    // Whatever the consumer didn't spend waiting, it spent working
+    if (started)
+    {
+        uint32_t total = nowUs() - started;
+        timing.renderBusyUs = total > timing.renderStallUs ? total - timing.renderStallUs : 0;
+        started = 0;
+    }
+}
+
+// Block the consumer until data arrives or the producer is finished
+bool DownloadBuffer::waitForData()
+{
+    while (tail.load(std::memory_order_acquire) == head.load(std::memory_order_relaxed))
+    {
+        // Without a fetch task, read the socket ourselves
+        if (!producer)
+            return fill() > 0;
+
+        if (finished.load())
+            return tail.load(std::memory_order_acquire) != head.load(std::memory_order_relaxed);
+
+        uint32_t t0 = nowUs();
+        xSemaphoreTake(dataReady, pdMS_TO_TICKS(50));
+        timing.renderStallUs += nowUs() - t0;
+    }
+    return true;
+}
+
+// Expose the next contiguous run of buffered bytes (waiting if empty)
+const uint8_t *DownloadBuffer::peek(size_t &avail)
+{
+    if (!region || !waitForData())
+    {
+        avail = 0;
+        return nullptr;
+    }
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t pos = h % cap;
+    avail = min(tail.load(std::memory_order_acquire) - h, cap - pos);
+    return region + pos;
+}
+
+// Mark n bytes returned by peek() as consumed
+void DownloadBuffer::consume(size_t n)
+{
+    head.store(head.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    if (producer)
+        xSemaphoreGive(spaceReady);
+}
+
+// The unconsumed rest of the body, once it has all arrived contiguously.
+// Nothing is written to the region after the fetch task finishes, so the
+// bytes stay valid (even once consumed) until the next begin().
+const uint8_t *DownloadBuffer::remaining(size_t &len)
+{
+    len = 0;
+    if (!region || !producer || !finished.load())
+        return nullptr;
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t pos = h % cap;
+    size_t avail = tail.load(std::memory_order_acquire) - h;
+    if (pos + avail > cap)
+        return nullptr;
+    len = avail;
+    return region + pos;
+}
+
+// Copy up to len bytes out of the region, waiting for the socket
+size_t DownloadBuffer::read(uint8_t *dst, size_t len)
+{
+    size_t got = 0;
+    while (got < len)
+    {
+        // Inline mode: top up before running dry so socket reads stay large
+        if (!producer && tail.load() - head.load() < len - got)
+            fill();
+
+        size_t avail;
+        const uint8_t *src = peek(avail);
+        if (!src)
+            break;
+        size_t n = min(avail, len - got);
+        memcpy(dst + got, src, n);
+        consume(n);
+        got += n;
+    }
+    return got;
+}
+
+// Drop up to len bytes without copying them
+size_t DownloadBuffer::skip(size_t len)
+{
+    size_t skipped = 0;
+    while (skipped < len)
+    {
+        size_t avail;
+        if (!peek(avail))
+            break;
+        size_t n = min(avail, len - skipped);
+        consume(n);
+        skipped += n;
+    }
+    return skipped;
+}
@@ -0,0 +1,318 @@
+#define FS_NO_GLOBALS
+#include <FS.h>
+#ifdef FILE_READ
+#undef FILE_READ
+#endif
+#ifdef FILE_WRITE
+#undef FILE_WRITE
+#endif
+
+#include <LittleFS.h>
+#include <esp_attr.h>
+#include <vector>
+
+#include "definitions.h"
+#include "frame_store.h"
+#include "framebuffer.h"
+#include "jpeg_stream.h"
+#include "logger.h"
+#include "packed_frame.h"
+#include "time_utils.h"
+
+namespace FrameStore
+{
+    static const char *FRAME_DIR = "/frames";
+    static constexpr uint8_t BUNDLE_VERSION = 1;
+
+    // Left free for LittleFS metadata and config updates
+    static constexpr size_t FS_RESERVE = 32 * 1024;
+
+    // Copy buffer for flash writes
+    static constexpr size_t COPY_CHUNK = 4096;
+
+    // Base frame for delta updates, and the copy being recorded
+    static const char *BASE_PATH = "/keyframe";
+    static const char *BASE_TEMP_PATH = "/keyframe.new";
+    static constexpr size_t BASE_ID_SIZE = 33;
+
+    // Id of the base frame; the frame itself is in flash
+    RTC_DATA_ATTR static char baseFrameId[BASE_ID_SIZE] = {0};
+
+    // State of the active BaseRecorder
+    static fs::File baseFile;
+    static std::vector<uint8_t> basePending;
+    static String baseNextId;
+
+    // ByteSource over an open file
+    class FileSource : public ByteSource
+    {
+    public:
+        explicit FileSource(fs::File &file) : file(file) {}
+        size_t read(uint8_t *dst, size_t len) override { return file.read(dst, len); }
+
+    private:
+        fs::File &file;
+    };
+
+    // Path of the frame for the wake at epoch
+    static String framePath(time_t epoch)
+    {
+        return String(FRAME_DIR) + "/" + String(static_cast<unsigned long>(epoch));
+    }
+
+    // Little-endian u32 at p
+    static uint32_t le32(const uint8_t *p)
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    // Drop every stored frame
+    void clear()
+    {
+        fs::File dir = LittleFS.open(FRAME_DIR);
+        if (!dir || !dir.isDirectory())
+            return;
+
+        std::vector<String> names;
+        for (fs::File f = dir.openNextFile(); f; f = dir.openNextFile())
+        {
+            names.push_back(f.name());
+            f.close();
+        }
+        dir.close();
+
+        for (const String &name : names)
+            LittleFS.remove(String(FRAME_DIR) + "/" + name);
+    }
+
+    // Flash space available for new frames
+    size_t freeBytes()
+    {
+        size_t total = LittleFS.totalBytes();
+        size_t used = LittleFS.usedBytes() + FS_RESERVE;
+        return total > used ? total - used : 0;
+    }
+
+    // Copy one frame of len bytes from src to flash. The frame's bytes are
+    // always consumed from src, even if it can't be stored.
+    static bool writeFrame(time_t epoch, uint8_t flags, ByteSource &src, size_t len)
+    {
+        if (len + 1 > freeBytes())
+        {
+            src.skip(len);
+            return false;
+        }
+
+        if (!LittleFS.exists(FRAME_DIR))
+            LittleFS.mkdir(FRAME_DIR);
+
+        String path = framePath(epoch);
+        fs::File file = LittleFS.open(path, "w");
+        if (!file)
+        {
+            src.skip(len);
+            return false;
+        }
+
+        std::vector<uint8_t> chunk(COPY_CHUNK);
+        bool ok = file.write(&flags, 1) == 1;
+        size_t copied = 0;
+        while (copied < len)
+        {
+            size_t n = src.read(chunk.data(), min(chunk.size(), len - copied));
+            if (n == 0)
+                break;
+            copied += n;
+            if (ok && file.write(chunk.data(), n) != n)
+                ok = false;
+        }
+        file.close();
+
+        if (!ok || copied != len)
+        {
+            LittleFS.remove(path);
+            return false;
+        }
+        return true;
+    }
+
+    // Store the frames of a bundle read from src
+    int storeBundle(ByteSource &src)
+    {
+        uint8_t header[8];
+        if (src.read(header, sizeof(header)) != sizeof(header) || memcmp(header, "INKB", 4) != 0 ||
+            header[4] != BUNDLE_VERSION)
+        {
+            Logger::log(Logger::LOG_ERROR, "Bundle: bad header");
+            return -1;
+        }
+
+        int count = header[5];
+        int stored = 0;
+        bool full = false;
+        for (int i = 0; i < count; i++)
+        {
+            uint8_t record[12];
+            if (src.read(record, sizeof(record)) != sizeof(record))
+                break;
+            time_t epoch = le32(record);
+            size_t len = le32(record + 4);
+
+            // Frames must be shown in order; once one doesn't fit, stop storing
+            if (full || !writeFrame(epoch, record[8], src, len))
+            {
+                full = true;
+                continue;
+            }
+            stored++;
+            Logger::logf(Logger::LOG_DEBUG, "Bundle: stored frame for %s (%u bytes)",
+                         fmtEpoch(epoch).c_str(), len);
+        }
+
+        Logger::logf(Logger::LOG_INFO, "Bundle: stored %d/%d frames, %u bytes free", stored, count, freeBytes());
+        return stored;
+    }
+
+    // Whether a frame is stored for the wake at epoch
+    bool has(time_t epoch)
+    {
+        return epoch > 0 && LittleFS.exists(framePath(epoch));
+    }
+
+    // Draw the frame stored for the wake at epoch, then delete it
+    esp_err_t show(Inkplate &display, time_t epoch, const dither::Tone &tone)
+    {
+        String path = framePath(epoch);
+        fs::File file = LittleFS.open(path, "r");
+        if (!file)
+            return ESP_ERR_NOT_FOUND;
+
+        int flags = file.read();
+        FileSource src(file);
+        jpeg_stream::Decoder decoder;
+        DecodeResult res = flags < 0 ? DecodeResult::INPUT : decoder.prepare(src);
+        if (res == DecodeResult::OK)
+        {
+            // Dithering as the server picked it: off, a given mode, or ours
+            dither::Mode mode = dither::defaultMode();
+            if (flags & FRAME_NO_DITHERING)
+                mode = dither::Mode::NONE;
+            else if (flags >> FRAME_DITHER_SHIFT)
+                mode = dither::fromId(flags >> FRAME_DITHER_SHIFT, mode);
+            framebuffer::setBilevel(display, flags & FRAME_BILEVEL);
+            res = decoder.draw(display, 0, 0, mode, tone);
+        }
+        file.close();
+
+        // Shown or broken, either way it's done
+        LittleFS.remove(path);
+
+        if (res != DecodeResult::OK)
+        {
+            Logger::logf(Logger::LOG_ERROR, "Stored frame failed: %s", decodeResultName(res));
+            return ESP_FAIL;
+        }
+        Logger::logf(Logger::LOG_INFO, "Showing stored frame for %s (radio off).", fmtEpoch(epoch).c_str());
+        return ESP_OK;
+    }
+
+    // Id of the stored base frame
+    const char *baseId()
+    {
+        if (!baseFrameId[0] || !LittleFS.exists(BASE_PATH))
+            return nullptr;
+        return baseFrameId;
+    }
+
+    // Draw the stored base frame into the framebuffer
+    DecodeResult drawBase(Inkplate &display)
+    {
+        fs::File file = LittleFS.open(BASE_PATH, "r");
+        if (!file)
+            return DecodeResult::INPUT;
+        FileSource src(file);
+        DecodeResult res = packed_frame::draw(display, src);
+        file.close();
+
+        // A base that can't be read is of no use to the next delta either
+        if (res != DecodeResult::OK)
+        {
+            LittleFS.remove(BASE_PATH);
+            baseFrameId[0] = 0;
+        }
+        return res;
+    }
+
+    // Start saving what is read from src as the next base frame
+    BaseRecorder::BaseRecorder(ByteSource &src, const String &id, size_t expected) : src(src)
+    {
+        // The frame replaces the current base either way; drop it now so
+        // there is room for the new one
+        LittleFS.remove(BASE_PATH);
+        baseFrameId[0] = 0;
+
+        if (baseFile || id.length() == 0 || id.length() >= BASE_ID_SIZE || expected > freeBytes())
+            return;
+        baseFile = LittleFS.open(BASE_TEMP_PATH, "w");
+        if (!baseFile)
+            return;
+        basePending.clear();
+        basePending.reserve(COPY_CHUNK);
+        baseNextId = id;
+        recording = true;
+    }
+
+    // Drop the copy unless it was committed
+    BaseRecorder::~BaseRecorder()
+    {
+        if (!recording)
+            return;
+        baseFile.close();
+        LittleFS.remove(BASE_TEMP_PATH);
+        std::vector<uint8_t>().swap(basePending);
+    }
+
+    // Pass bytes through, copying them to flash in COPY_CHUNK writes
+    size_t BaseRecorder::read(uint8_t *dst, size_t len)
+    {
+        size_t n = src.read(dst, len);
+        if (!recording || n == 0)
+            return n;
+
+        basePending.insert(basePending.end(), dst, dst + n);
+        if (basePending.size() >= COPY_CHUNK)
+        {
+            // Out of space: stop copying, the frame itself still goes through
+            if (baseFile.write(basePending.data(), basePending.size()) != basePending.size())
+            {
+                baseFile.close();
+                LittleFS.remove(BASE_TEMP_PATH);
+                std::vector<uint8_t>().swap(basePending);
+                recording = false;
+                return n;
+            }
+            basePending.clear();
+        }
+        return n;
+    }
+
+    // Keep the copy as the base frame
+    bool BaseRecorder::commit()
+    {
+        if (!recording)
+            return false;
+        recording = false;
+
+        bool ok = basePending.empty() || baseFile.write(basePending.data(), basePending.size()) == basePending.size();
+        baseFile.close();
+        std::vector<uint8_t>().swap(basePending);
+        if (!ok || !LittleFS.rename(BASE_TEMP_PATH, BASE_PATH))
+        {
+            LittleFS.remove(BASE_TEMP_PATH);
+            return false;
+        }
+        strncpy(baseFrameId, baseNextId.c_str(), sizeof(baseFrameId) - 1);
+        Logger::logf(Logger::LOG_DEBUG, "Saved base frame %s", baseFrameId);
+        return true;
+    }
+}
@@ -0,0 +1,294 @@
+#include <Arduino.h>
+#include <cstring>
+
+#include "definitions.h"
+#include "framebuffer.h"
+
+namespace framebuffer
+{
+    // Native panel geometry
+    static constexpr int W = E_INK_WIDTH;
+    static constexpr int H = E_INK_HEIGHT;
+    static constexpr size_t ROW_BYTES = W / 2;
+    static constexpr size_t BIT_ROW_BYTES = W / 8;
+
+    // Logical size at the compiled-in rotation
+    static constexpr int LOGICAL_W = ROTATION % 2 ? H : W;
+    static constexpr int LOGICAL_H = ROTATION % 2 ? W : H;
+
+    static_assert(W % 8 == 0, "rows must split into 32-bit words");
+
+    // Pixel values are 3 bits on both boards (gray level or ink id)
+    static constexpr uint32_t VALUE_MASK = 0x07070707;
+
+    // Set one pixel at native (X, Y)
+    static inline void setNative(uint8_t *fb, int X, int Y, uint8_t c)
+    {
+        uint8_t *p = fb + Y * ROW_BYTES + X / 2;
+        *p = X & 1 ? (*p & 0xF0) | (c & 0x07) : (*p & 0x0F) | ((c & 0x07) << 4);
+    }
+
+    // Whether a gray level is black in 1-bit mode
+    static inline bool black(uint8_t c)
+    {
+        return c < 4;
+    }
+
+    // Set one pixel of the 1-bit buffer at native (X, Y)
+    static inline void setNativeBit(uint8_t *fb, int X, int Y, uint8_t c)
+    {
+        uint8_t *p = fb + Y * BIT_ROW_BYTES + X / 8;
+        const uint8_t mask = 1 << (X & 7);
+        *p = black(c) ? *p | mask : *p & ~mask;
+    }
+
+    // Pack 8 pixels p0..p7 (one per byte, little-endian in a and b) into the
+    // 4 framebuffer bytes p0p1 p2p3 p4p5 p6p7, as one little-endian word
+    static inline uint32_t pack8(uint32_t a, uint32_t b)
+    {
+        a &= VALUE_MASK;
+        b &= VALUE_MASK;
+        a = ((a << 4) | (a >> 8)) & 0x00FF00FF;
+        b = ((b << 4) | (b >> 8)) & 0x00FF00FF;
+        return ((a | (a >> 8)) & 0xFFFF) | ((b | (b >> 8)) << 16);
+    }
+
+    // Unaligned little-endian load
+    static inline uint32_t load32(const uint8_t *p)
+    {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    // A logical row maps onto a native row (rotation 0 and 2)
+    static void writeLandscape(uint8_t *fb, int x, int y, const uint8_t *src, int n)
+    {
+        constexpr bool flipped = ROTATION == 2;
+        const int Y = flipped ? H - 1 - y : y;
+        uint8_t *row = fb + Y * ROW_BYTES;
+
+        // Single pixels up to an 8-pixel boundary; as W is a multiple of 8
+        // it is one in native x too
+        int i = 0;
+        while (i < n && (x + i) % 8 != 0)
+        {
+            setNative(fb, flipped ? W - 1 - (x + i) : x + i, Y, src[i]);
+            i++;
+        }
+
+        // Whole words; upside down, 8 logical pixels are 8 native ones in
+        // reverse order
+        for (; i + 8 <= n; i += 8)
+        {
+            uint32_t a = load32(src + i), b = load32(src + i + 4);
+            if (flipped)
+            {
+                uint32_t ra = __builtin_bswap32(b), rb = __builtin_bswap32(a);
+                a = ra;
+                b = rb;
+            }
+            int X = flipped ? W - 8 - (x + i) : x + i;
+            uint32_t word = pack8(a, b);
+            memcpy(__builtin_assume_aligned(row + X / 2, 4), &word, sizeof(word));
+        }
+
+        // Trailing pixels
+        for (; i < n; i++)
+            setNative(fb, flipped ? W - 1 - (x + i) : x + i, Y, src[i]);
+    }
+
+    // A logical row maps onto a native column (rotation 1 and 3); two
+    // logical rows fill whole bytes down that column pair. The band is
+    // written transposed: each native row gets the bytes of every row pair
+    // side by side, so the framebuffer is swept once, in order, instead of
+    // once per pair with a row-sized stride between bytes.
+    static void writePortrait(uint8_t *fb, int x, int y, const uint8_t *src, size_t pitch, int n, int rows)
+    {
+        constexpr bool right = ROTATION == 1; // X = W - 1 - y, Y = x
+        auto nativeX = [](int ly) { return right ? W - 1 - ly : ly; };
+        auto nativeY = [](int lx) { return right ? lx : H - 1 - lx; };
+
+        int r = 0;
+        // Odd start: the first row shares its bytes with rows we don't have
+        if (y % 2 != 0)
+        {
+            for (int i = 0; i < n; i++)
+                setNative(fb, nativeX(y), nativeY(x + i), src[i]);
+            r = 1;
+        }
+
+        const int pairs = (rows - r) / 2;
+        if (pairs > 0)
+        {
+            // Rotation 3 puts the even row at the even (high) nibble and
+            // the pairs left to right; rotation 1 mirrors both
+            const uint8_t *band = src + r * pitch;
+            const int left = right ? nativeX(y + r + 2 * pairs - 1) : nativeX(y + r);
+            uint8_t *column = fb + left / 2;
+            for (int i = 0; i < n; i++)
+            {
+                uint8_t *out = column + nativeY(x + i) * ROW_BYTES;
+                const uint8_t *even = band + i;
+                for (int k = 0; k < pairs; k++, even += 2 * pitch)
+                {
+                    uint8_t hi = right ? even[pitch] : even[0];
+                    uint8_t lo = right ? even[0] : even[pitch];
+                    out[right ? pairs - 1 - k : k] = ((hi & 0x07) << 4) | (lo & 0x07);
+                }
+            }
+            r += 2 * pairs;
+        }
+
+        // Odd end
+        if (r < rows)
+        {
+            const uint8_t *last = src + r * pitch;
+            for (int i = 0; i < n; i++)
+                setNative(fb, nativeX(y + r), nativeY(x + i), last[i]);
+        }
+    }
+
+    // 1-bit rows: a logical row maps onto a native row (rotation 0 and 2),
+    // whole bytes of 8 pixels between the partial ones at either end
+    static void writeLandscapeBits(uint8_t *fb, int x, int y, const uint8_t *src, int n)
+    {
+        constexpr bool flipped = ROTATION == 2;
+        const int Y = flipped ? H - 1 - y : y;
+        uint8_t *row = fb + Y * BIT_ROW_BYTES;
+
+        int i = 0;
+        while (i < n && (x + i) % 8 != 0)
+        {
+            setNativeBit(fb, flipped ? W - 1 - (x + i) : x + i, Y, src[i]);
+            i++;
+        }
+
+        // Upside down, 8 logical pixels are 8 native ones in reverse order
+        for (; i + 8 <= n; i += 8)
+        {
+            uint8_t bits = 0;
+            for (int b = 0; b < 8; b++)
+                bits |= black(src[i + b]) << (flipped ? 7 - b : b);
+            row[(flipped ? W - 8 - (x + i) : x + i) / 8] = bits;
+        }
+
+        for (; i < n; i++)
+            setNativeBit(fb, flipped ? W - 1 - (x + i) : x + i, Y, src[i]);
+    }
+
+    // 1-bit rows: a logical row maps onto a native column (rotation 1 and
+    // 3); eight logical rows starting at a multiple of 8 fill whole bytes
+    // down that column
+    static void writePortraitBits(uint8_t *fb, int x, int y, const uint8_t *src, size_t pitch, int n, int rows)
+    {
+        constexpr bool right = ROTATION == 1; // X = W - 1 - y, Y = x
+        auto nativeX = [](int ly) { return right ? W - 1 - ly : ly; };
+        auto nativeY = [](int lx) { return right ? lx : H - 1 - lx; };
+        auto single = [&](int r) {
+            for (int i = 0; i < n; i++)
+                setNativeBit(fb, nativeX(y + r), nativeY(x + i), src[r * pitch + i]);
+        };
+
+        int r = 0;
+        for (; r < rows && (y + r) % 8 != 0; r++)
+            single(r);
+
+        // Rotation 3 puts row k of the group at bit k, rotation 1 at 7 - k
+        for (; r + 8 <= rows; r += 8)
+        {
+            const uint8_t *group = src + r * pitch;
+            uint8_t *column = fb + nativeX(right ? y + r + 7 : y + r) / 8;
+            for (int i = 0; i < n; i++)
+            {
+                uint8_t bits = 0;
+                for (int k = 0; k < 8; k++)
+                    bits |= black(group[k * pitch + i]) << (right ? 7 - k : k);
+                column[nativeY(x + i) * BIT_ROW_BYTES] = bits;
+            }
+        }
+
+        for (; r < rows; r++)
+            single(r);
+    }
+
+    // Whether the display is in 1-bit mode
+    bool bilevel(Inkplate &display)
+    {
+#ifdef ARDUINO_INKPLATECOLOR
+        return false;
+#else
+        return display.getDisplayMode() == INKPLATE_1BIT;
+#endif
+    }
+
+    // Switch between 3-bit gray and 1-bit mode
+    void setBilevel(Inkplate &display, bool on)
+    {
+#ifndef ARDUINO_INKPLATECOLOR
+        if (on != bilevel(display))
+            display.selectDisplayMode(on ? INKPLATE_1BIT : INKPLATE_3BIT);
+#endif
+    }
+
+    // Adafruit_GFX color for a panel color in the current mode
+    uint16_t color(Inkplate &display, uint8_t level)
+    {
+        return bilevel(display) ? black(level) : level;
+    }
+
+    // Whether direct writes are possible
+    bool available(Inkplate &display)
+    {
+        uint8_t *fb = bilevel(display) ? display._partial : display.DMemory4Bit;
+        return fb && display.getRotation() == ROTATION;
+    }
+
+    // Write rows of panel colors at logical (x, y), clipped to the display
+    void writeRows(Inkplate &display, int x, int y, const uint8_t *colors, size_t pitch, int width, int rows)
+    {
+        // Clip to the logical display
+        if (x < 0)
+        {
+            colors -= x;
+            width += x;
+            x = 0;
+        }
+        if (y < 0)
+        {
+            colors -= (ptrdiff_t)y * pitch;
+            rows += y;
+            y = 0;
+        }
+        width = min(width, LOGICAL_W - x);
+        rows = min(rows, LOGICAL_H - y);
+        if (width <= 0 || rows <= 0)
+            return;
+
+        if (bilevel(display))
+        {
+            uint8_t *bits = display._partial;
+            if (ROTATION % 2 == 0)
+            {
+                for (int r = 0; r < rows; r++)
+                    writeLandscapeBits(bits, x, y + r, colors + r * pitch, width);
+            }
+            else
+            {
+                writePortraitBits(bits, x, y, colors, pitch, width, rows);
+            }
+            return;
+        }
+
+        uint8_t *fb = display.DMemory4Bit;
+        if (ROTATION % 2 == 0)
+        {
+            for (int r = 0; r < rows; r++)
+                writeLandscape(fb, x, y + r, colors + r * pitch, width);
+        }
+        else
+        {
+            writePortrait(fb, x, y, colors, pitch, width, rows);
+        }
+    }
+}
@@ -0,0 +1,128 @@
+#include <Arduino.h>
+
+#include "http_stream.h"
+
+HttpBodyStream::HttpBodyStream(WiFiClient &stream, unsigned long timeoutMillis,
+                               bool isChunked, size_t contentLength)
+    : stream(stream), timeoutMillis(timeoutMillis),
+      deadline(millis() + timeoutMillis), isChunked(isChunked),
+      contentLength(isChunked ? 0 : contentLength)
+{
+}
+
+// Wait for the socket to have data; false on disconnect or idle timeout
+bool HttpBodyStream::waitAvailable()
+{
+    if (aborted.load())
+        return false;
+    while (stream.available() <= 0)
+    {
+        if (aborted.load() || !stream.connected() || millis() >= deadline)
+            return false;
+        delay(1);
+    }
+    return true;
+}
+
+// Parse the next chunk-size line; false on the terminating zero chunk
+bool HttpBodyStream::nextChunk()
+{
+    // Buffer for reading the hex-size line
+    constexpr size_t LINE_BUF = 32;
+    char line[LINE_BUF];
+
+    // Consume the trailing CRLF after the previous chunk's data
+    if (inChunk)
+    {
+        stream.readBytesUntil('\n', (uint8_t *)line, LINE_BUF - 1);
+        inChunk = false;
+    }
+
+    // Read chunk-size line (up to '\n')
+    int len = stream.readBytesUntil('\n', (uint8_t *)line, LINE_BUF - 1);
+    if (len <= 0)
+        return false;
+    line[len] = '\0';
+
+    // Strip any trailing '\r'
+    if (char *cr = strchr(line, '\r'))
+        *cr = '\0';
+
+    // Parse hex length from the line; size 0 indicates end of chunks
+    chunkRemaining = strtoul(line, nullptr, 16);
+    inChunk = chunkRemaining > 0;
+    if (!inChunk)
+    {
+        // Swallow any trailer lines and the final CRLF so the connection
+        // is left at the start of the next response
+        int trailer;
+        do
+        {
+            trailer = stream.readBytesUntil('\n', (uint8_t *)line, LINE_BUF - 1);
+        } while (trailer > 1);
+        ended = true;
+    }
+    return inChunk;
+}
+
+// Read whatever is already buffered by the socket (at least one byte, waiting
+// for it if needed) up to len; returns 0 once the body is exhausted
+size_t HttpBodyStream::readSome(uint8_t *dst, size_t len)
+{
+    while (len > 0 && !done)
+    {
+        // Move on to the next chunk when the current one is drained
+        if (isChunked && chunkRemaining == 0)
+        {
+            if (!waitAvailable() || !nextChunk())
+            {
+                done = true;
+                break;
+            }
+        }
+
+        // Determine how much we are allowed to read right now
+        size_t want = len;
+        if (isChunked)
+            want = min(want, chunkRemaining);
+        else if (contentLength > 0)
+            want = min(want, contentLength - total);
+
+        if (!waitAvailable())
+        {
+            done = true;
+            break;
+        }
+        want = min(want, (size_t)stream.available());
+
+        int n = stream.read(dst, want);
+        if (n <= 0)
+            continue;
+
+        // Reset timeout on successful read
+        deadline = millis() + timeoutMillis;
+        total += n;
+        if (isChunked)
+            chunkRemaining -= n;
+
+        // Stop if we have read the expected length
+        if (contentLength > 0 && total >= contentLength)
+            done = ended = true;
+        return n;
+    }
+    return 0;
+}
+
+// Read exactly len body bytes into dst unless the body ends first
+size_t HttpBodyStream::read(uint8_t *dst, size_t len)
+{
+    size_t got = 0;
+    while (got < len)
+    {
+        size_t n = readSome(dst + got, len - got);
+        if (n == 0)
+            break;
+        got += n;
+    }
+    return got;
+}
@@ -0,0 +1,50 @@
+#include <Arduino.h>
+
+#include "definitions.h"
+#include "https_session.h"
+#include "logger.h"
+
+// Shared session against the configured "api" host
+HttpsSession apiSession;
+
+HttpsSession::HttpsSession()
+{
+    client.setReuse(true);
+    client.setUserAgent(USER_AGENT);
+}
+
+// Prepare a request for url, reusing the open connection when possible
+bool HttpsSession::begin(const URLParser::Parser &url)
+{
+    String target = url.getDomain();
+    if (tls.connected())
+    {
+        if (target == host)
+        {
+            reuseCount++;
+            Logger::logf(Logger::LOG_DEBUG, "Reusing HTTPS connection to %s", host.c_str());
+        }
+        else
+        {
+            close();
+        }
+    }
+    host = target;
+    return client.begin(tls, url.getURL());
+}
+
+// Finish the current request, keeping the connection alive if possible
+void HttpsSession::end(bool reusable)
+{
+    if (!reusable)
+        tls.stop();
+    client.end();
+}
+
+// Close the underlying connection
+void HttpsSession::close()
+{
+    client.end();
+    tls.stop();
+    host = "";
+}
@@ -0,0 +1,1487 @@
+#include <Arduino.h>
+#include <cstring>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <new>
+
+#include "jpeg_decoder.h"
+#include "jpeg_utils.h"
+
+namespace jpeg_decoder
+{
+    // Restart markers
+    enum : uint8_t
+    {
+        RST0 = 0xD0,
+        RST7 = 0xD7,
+    };
+
+    // Largest header (metadata segments included) buffered by prepare();
+    // it goes to PSRAM, but EXIF thumbnails and ICC profiles can be large
+    static constexpr size_t MAX_HEADER = 256 * 1024;
+
+    // Zig-zag position -> natural (row-major) position
+    static const uint8_t ZIGZAG[64] = {
+        0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+        12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+        35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+        58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+    // AAN scale factors, cos(k*pi/16) * sqrt(2) products scaled by 2^14,
+    // natural order (libjpeg jddctmgr.c)
+    static const int16_t AAN_SCALES[64] = {
+        16384, 22725, 21407, 19266, 16384, 12873, 8867, 4520,
+        22725, 31521, 29692, 26722, 22725, 17855, 12299, 6270,
+        21407, 29692, 27969, 25172, 21407, 16819, 11585, 5906,
+        19266, 26722, 25172, 22654, 19266, 15137, 10426, 5315,
+        16384, 22725, 21407, 19266, 16384, 12873, 8867, 4520,
+        12873, 17855, 16819, 15137, 12873, 10114, 6967, 3552,
+        8867, 12299, 11585, 10426, 8867, 6967, 4799, 2446,
+        4520, 6270, 5906, 5315, 4520, 3552, 2446, 1247};
+
+    // Fixed-point precision of the IDCT (jidctfst.c)
+    static constexpr int CONST_BITS = 8;
+    static constexpr int PASS1_BITS = 2;
+    static constexpr int32_t FIX_1_082392200 = 277;
+    static constexpr int32_t FIX_1_414213562 = 362;
+    static constexpr int32_t FIX_1_847759065 = 473;
+    static constexpr int32_t FIX_2_613125930 = 669;
+
+    // YCbCr -> RGB coefficients, 16.16 fixed point
+    static constexpr int32_t CR_R = 91881;  // 1.402
+    static constexpr int32_t CB_G = 22554;  // 0.344136
+    static constexpr int32_t CR_G = 46802;  // 0.714136
+    static constexpr int32_t CB_B = 116130; // 1.772
+
+    // Clamp to a sample
+    static inline uint8_t clampSample(int32_t v)
+    {
+        return v < 0 ? 0 : v > 255 ? 255 : v;
+    }
+
+    // Reduced-size IDCTs (libjpeg jidctred.c): the 4x4, 2x2 and 1x1 outputs
+    // of the 8x8 transform, from the unscaled quantization tables
+    namespace reduced
+    {
+        static constexpr int CONST_BITS = 13;
+        static constexpr int PASS1_BITS = 2;
+        static constexpr int32_t FIX_0_211164243 = 1730;
+        static constexpr int32_t FIX_0_509795579 = 4176;
+        static constexpr int32_t FIX_0_601344887 = 4926;
+        static constexpr int32_t FIX_0_720959822 = 5906;
+        static constexpr int32_t FIX_0_765366865 = 6270;
+        static constexpr int32_t FIX_0_850430095 = 6967;
+        static constexpr int32_t FIX_0_899976223 = 7373;
+        static constexpr int32_t FIX_1_061594337 = 8697;
+        static constexpr int32_t FIX_1_272758580 = 10426;
+        static constexpr int32_t FIX_1_451774981 = 11893;
+        static constexpr int32_t FIX_1_847759065 = 15137;
+        static constexpr int32_t FIX_2_172734803 = 17799;
+        static constexpr int32_t FIX_2_562915447 = 20995;
+        static constexpr int32_t FIX_3_624509785 = 29692;
+
+        // Round and shift right by n bits
+        static inline int32_t descale(int32_t v, int n)
+        {
+            return (v + (1 << (n - 1))) >> n;
+        }
+
+        // Dequantize and inverse transform one block into 4x4 samples (1/2 scale)
+        IRAM_ATTR static void idct4x4(const int16_t *coef, const uint16_t *quant, uint8_t *out, size_t stride)
+        {
+            int32_t ws[8 * 4];
+
+            // Pass 1: columns; column 4 is not needed by the second pass
+            for (int col = 0; col < 8; col++)
+            {
+                if (col == 4)
+                    continue;
+                const int16_t *in = coef + col;
+                const uint16_t *q = quant + col;
+                int32_t *w = ws + col;
+
+                if (!in[8] && !in[16] && !in[24] && !in[40] && !in[48] && !in[56])
+                {
+                    int32_t dc = (in[0] * q[0]) << PASS1_BITS;
+                    w[0] = w[8] = w[16] = w[24] = dc;
+                    continue;
+                }
+
+                // Even part
+                int32_t tmp0 = (in[0] * q[0]) << (CONST_BITS + 1);
+                int32_t tmp2 = in[16] * q[16] * FIX_1_847759065 - in[48] * q[48] * FIX_0_765366865;
+                int32_t tmp10 = tmp0 + tmp2;
+                int32_t tmp12 = tmp0 - tmp2;
+
+                // Odd part
+                int32_t z1 = in[56] * q[56], z2 = in[40] * q[40], z3 = in[24] * q[24], z4 = in[8] * q[8];
+                tmp0 = -z1 * FIX_0_211164243 + z2 * FIX_1_451774981 - z3 * FIX_2_172734803 + z4 * FIX_1_061594337;
+                tmp2 = -z1 * FIX_0_509795579 - z2 * FIX_0_601344887 + z3 * FIX_0_899976223 + z4 * FIX_2_562915447;
+
+                constexpr int SHIFT = CONST_BITS - PASS1_BITS + 1;
+                w[0] = descale(tmp10 + tmp2, SHIFT);
+                w[24] = descale(tmp10 - tmp2, SHIFT);
+                w[8] = descale(tmp12 + tmp0, SHIFT);
+                w[16] = descale(tmp12 - tmp0, SHIFT);
+            }
+
+            // Pass 2: four rows, descaling to samples around 128
+            for (int row = 0; row < 4; row++, out += stride)
+            {
+                const int32_t *w = ws + row * 8;
+
+                if (!w[1] && !w[2] && !w[3] && !w[5] && !w[6] && !w[7])
+                {
+                    memset(out, clampSample(descale(w[0], PASS1_BITS + 3) + 128), 4);
+                    continue;
+                }
+
+                // Even part
+                int32_t tmp0 = w[0] << (CONST_BITS + 1);
+                int32_t tmp2 = w[2] * FIX_1_847759065 - w[6] * FIX_0_765366865;
+                int32_t tmp10 = tmp0 + tmp2;
+                int32_t tmp12 = tmp0 - tmp2;
+
+                // Odd part
+                tmp0 = -w[7] * FIX_0_211164243 + w[5] * FIX_1_451774981 - w[3] * FIX_2_172734803 +
+                       w[1] * FIX_1_061594337;
+                tmp2 = -w[7] * FIX_0_509795579 - w[5] * FIX_0_601344887 + w[3] * FIX_0_899976223 +
+                       w[1] * FIX_2_562915447;
+
+                constexpr int SHIFT = CONST_BITS + PASS1_BITS + 3 + 1;
+                out[0] = clampSample(descale(tmp10 + tmp2, SHIFT) + 128);
+                out[3] = clampSample(descale(tmp10 - tmp2, SHIFT) + 128);
+                out[1] = clampSample(descale(tmp12 + tmp0, SHIFT) + 128);
+                out[2] = clampSample(descale(tmp12 - tmp0, SHIFT) + 128);
+            }
+        }
+
+        // Dequantize and inverse transform one block into 2x2 samples (1/4 scale)
+        IRAM_ATTR static void idct2x2(const int16_t *coef, const uint16_t *quant, uint8_t *out, size_t stride)
+        {
+            int32_t ws[8 * 2];
+
+            // Pass 1: columns; only the odd ones (and 0) reach the second pass
+            for (int col = 0; col < 8; col++)
+            {
+                if (col == 2 || col == 4 || col == 6)
+                    continue;
+                const int16_t *in = coef + col;
+                const uint16_t *q = quant + col;
+                int32_t *w = ws + col;
+
+                if (!in[8] && !in[24] && !in[40] && !in[56])
+                {
+                    w[0] = w[8] = (in[0] * q[0]) << PASS1_BITS;
+                    continue;
+                }
+
+                int32_t tmp10 = (in[0] * q[0]) << (CONST_BITS + 2);
+                int32_t tmp0 = -in[56] * q[56] * FIX_0_720959822 + in[40] * q[40] * FIX_0_850430095 -
+                               in[24] * q[24] * FIX_1_272758580 + in[8] * q[8] * FIX_3_624509785;
+
+                constexpr int SHIFT = CONST_BITS - PASS1_BITS + 2;
+                w[0] = descale(tmp10 + tmp0, SHIFT);
+                w[8] = descale(tmp10 - tmp0, SHIFT);
+            }
+
+            // Pass 2: two rows
+            for (int row = 0; row < 2; row++, out += stride)
+            {
+                const int32_t *w = ws + row * 8;
+
+                if (!w[1] && !w[3] && !w[5] && !w[7])
+                {
+                    out[0] = out[1] = clampSample(descale(w[0], PASS1_BITS + 3) + 128);
+                    continue;
+                }
+
+                int32_t tmp10 = w[0] << (CONST_BITS + 2);
+                int32_t tmp0 = -w[7] * FIX_0_720959822 + w[5] * FIX_0_850430095 - w[3] * FIX_1_272758580 +
+                               w[1] * FIX_3_624509785;
+
+                constexpr int SHIFT = CONST_BITS + PASS1_BITS + 3 + 2;
+                out[0] = clampSample(descale(tmp10 + tmp0, SHIFT) + 128);
+                out[1] = clampSample(descale(tmp10 - tmp0, SHIFT) + 128);
+            }
+        }
+    }
+
+    // Refill the input buffer from the source
+    bool Decoder::fetch()
+    {
+        if (!src)
+            return false;
+        input = buffer;
+        inputPos = 0;
+        inputLen = src->read(buffer, sizeof(buffer));
+        return inputLen > 0;
+    }
+
+    // Next input byte, or -1 at the end of the input
+    int Decoder::readByte()
+    {
+        if (inputPos == inputLen && !fetch())
+            return -1;
+        return input[inputPos++];
+    }
+
+    // Copy up to len bytes of input: what is left of the block, then
+    // straight from the source
+    size_t Decoder::readBytes(uint8_t *dst, size_t len)
+    {
+        size_t got = min(len, inputLen - inputPos);
+        memcpy(dst, input + inputPos, got);
+        inputPos += got;
+        while (got < len && src)
+        {
+            size_t n = src->read(dst + got, len - got);
+            if (!n)
+                break;
+            got += n;
+        }
+        return got;
+    }
+
+    // Dequantization tables for both IDCTs, from DQT values in zig-zag order
+    void Decoder::buildQuantTable(int id, const uint8_t *values, bool wide)
+    {
+        for (int k = 0; k < 64; k++)
+        {
+            int q = wide ? (values[k * 2] << 8) | values[k * 2 + 1] : values[k];
+            // Fold the AAN scaling into the table, keeping PASS1_BITS of
+            // extra precision for the first pass (jddctmgr.c)
+            int n = ZIGZAG[k];
+            tables->quant[id][n] = (q * AAN_SCALES[n] + (1 << 11)) >> 12;
+            tables->raw[id][n] = q;
+        }
+    }
+
+    // Huffman decoding table from DHT code counts (lengths 1-16) followed
+    // by the symbols
+    bool Decoder::buildHuffman(Huffman &table, const uint8_t *counts)
+    {
+        const uint8_t *values = counts + 16;
+        size_t total = 0;
+        for (int l = 0; l < 16; l++)
+            total += counts[l];
+        memcpy(table.values, values, total);
+
+        // Canonical codes, filling the lookahead table for short ones
+        memset(table.lookup, 0, sizeof(table.lookup));
+        uint32_t code = 0;
+        int32_t k = 0;
+        for (int l = 1; l <= 16; l++)
+        {
+            table.valueOffset[l] = k - static_cast<int32_t>(code);
+            for (int i = 0; i < counts[l - 1]; i++, code++, k++)
+            {
+                if (code >= (1u << l))
+                    return false;
+                if (l <= LOOKAHEAD_BITS)
+                {
+                    uint32_t first = code << (LOOKAHEAD_BITS - l);
+                    uint32_t span = 1u << (LOOKAHEAD_BITS - l);
+                    for (uint32_t j = 0; j < span; j++)
+                        table.lookup[first + j] = (l << 8) | table.values[k];
+                }
+            }
+            table.maxCode[l] = counts[l - 1] ? static_cast<int32_t>(code) - 1 : -1;
+            code <<= 1;
+        }
+        table.maxCode[17] = INT32_MAX; // Sentinel
+        return true;
+    }
+
+    // Every table defined in parsed, which progressive images may spread
+    // between their scans
+    bool Decoder::buildTables(const jpeg_utils::JpegInfo &parsed, const uint8_t *data)
+    {
+        for (int id = 0; id < 4; id++)
+        {
+            if (parsed.quant[id].offset)
+            {
+                buildQuantTable(id, data + parsed.quant[id].offset, parsed.quant[id].wide);
+                quantReady |= 1 << id;
+            }
+            if (parsed.dcTables[id])
+            {
+                if (!buildHuffman(tables->dc[id], data + parsed.dcTables[id]))
+                    return false;
+                dcReady |= 1 << id;
+            }
+            if (parsed.acTables[id])
+            {
+                if (!buildHuffman(tables->ac[id], data + parsed.acTables[id]))
+                    return false;
+                acReady |= 1 << id;
+            }
+        }
+        return true;
+    }
+
+    // Read the headers from src, up to the start of scan, and take them
+    DecodeResult Decoder::prepare(ByteSource &source)
+    {
+        // Grow the header buffer by as much as the parser asks for, so no
+        // scan data is read ahead
+        std::vector<uint8_t> header;
+        jpeg_utils::JpegInfo parsed = jpeg_utils::parseHeader(nullptr, 0);
+        while (parsed.status == DecodeResult::INPUT)
+        {
+            // Headers this large (a huge EXIF or ICC segment) will be no
+            // smaller on a retry
+            if (parsed.needed > MAX_HEADER)
+            {
+                info = parsed;
+                return DecodeResult::UNSUPPORTED;
+            }
+            size_t have = header.size();
+            header.resize(parsed.needed);
+            if (source.read(header.data() + have, parsed.needed - have) != parsed.needed - have)
+                return DecodeResult::INPUT;
+            parsed = jpeg_utils::parseHeader(header.data(), header.size());
+
+            // Reject a frame we can't decode as soon as its SOF is in, before
+            // the tables and the scan data are downloaded
+            if (parsed.status == DecodeResult::INPUT && parsed.kind != jpeg_utils::JpegKind::INVALID &&
+                checkFrame(parsed) != DecodeResult::OK)
+            {
+                info = parsed;
+                return DecodeResult::UNSUPPORTED;
+            }
+        }
+        return prepare(parsed, header.data(), source);
+    }
+
+    // Whether the frame (SOFn) is one this decoder handles
+    DecodeResult Decoder::checkFrame(const jpeg_utils::JpegInfo &frame)
+    {
+        // Huffman-coded 8-bit gray or color only
+        const int n = frame.componentCount;
+        if ((frame.kind != jpeg_utils::JpegKind::BASELINE && frame.kind != jpeg_utils::JpegKind::PROGRESSIVE) ||
+            frame.precision != 8 || (n != 1 && n != 3))
+            return DecodeResult::UNSUPPORTED;
+
+        // A single component is never interleaved: one block per MCU
+        if (n == 1)
+            return DecodeResult::OK;
+
+        // Chroma is upsampled at most 2x either way; luma must be at full
+        // resolution
+        uint8_t hMax = 1, vMax = 1;
+        for (int i = 0; i < n; i++)
+        {
+            hMax = max(hMax, frame.components[i].h);
+            vMax = max(vMax, frame.components[i].v);
+        }
+        if (hMax > 2 || vMax > 2 || frame.components[0].h != hMax || frame.components[0].v != vMax)
+            return DecodeResult::UNSUPPORTED;
+        for (int i = 0; i < n; i++)
+        {
+            if (hMax % frame.components[i].h || vMax % frame.components[i].v)
+                return DecodeResult::UNSUPPORTED;
+        }
+        return DecodeResult::OK;
+    }
+
+    // Take headers parsed by jpeg_utils::parseHeader() from header
+    DecodeResult Decoder::prepare(const jpeg_utils::JpegInfo &parsed, const uint8_t *header, ByteSource &source)
+    {
+        info = scan = parsed;
+        src = &source;
+        input = buffer;
+        inputPos = inputLen = 0;
+        componentCount = 0;
+        scaleBits = 0;
+        lumaOnly = false;
+        progressive = false;
+        if (parsed.status != DecodeResult::OK)
+            return parsed.status;
+
+        // Sequential components in separate scans are legal but not worth
+        // supporting
+        const int n = parsed.componentCount;
+        progressive = parsed.kind == jpeg_utils::JpegKind::PROGRESSIVE;
+        DecodeResult frame = checkFrame(parsed);
+        if (frame != DecodeResult::OK)
+            return frame;
+        if (!progressive && parsed.scanCount != n)
+            return DecodeResult::UNSUPPORTED;
+
+        if (!tables)
+            tables.reset(new (std::nothrow) Tables());
+        if (!tables)
+            return DecodeResult::MEMORY;
+
+        imageWidth = parsed.width;
+        imageHeight = parsed.height;
+        restartInterval = parsed.restartInterval;
+        hMax = vMax = 1;
+        bool quantBuilt[4] = {false}, dcBuilt[4] = {false}, acBuilt[4] = {false};
+        quantReady = dcReady = acReady = 0;
+        for (int i = 0; i < n; i++)
+        {
+            const jpeg_utils::JpegInfo::Component &f = parsed.components[i];
+            Component &c = comps[i];
+            c.id = f.id;
+            c.h = f.h;
+            c.v = f.v;
+            c.quant = f.quant;
+            hMax = max(hMax, c.h);
+            vMax = max(vMax, c.v);
+            if (progressive)
+                continue; // Tables are taken scan by scan
+
+            // Sequential: one scan with every component in frame order, and
+            // only the tables it uses
+            const jpeg_utils::JpegInfo::ScanComponent &sc = parsed.scan[i];
+            if (sc.id != f.id)
+                return DecodeResult::INVALID;
+            c.dcTable = sc.dcTable;
+            c.acTable = sc.acTable;
+            const jpeg_utils::JpegInfo::QuantTable &q = parsed.quant[c.quant];
+            if (!parsed.dcTables[c.dcTable] || !parsed.acTables[c.acTable])
+                return DecodeResult::INVALID;
+            if (!quantBuilt[c.quant])
+                buildQuantTable(c.quant, header + q.offset, q.wide);
+            if (!dcBuilt[c.dcTable] && !buildHuffman(tables->dc[c.dcTable], header + parsed.dcTables[c.dcTable]))
+                return DecodeResult::INVALID;
+            if (!acBuilt[c.acTable] && !buildHuffman(tables->ac[c.acTable], header + parsed.acTables[c.acTable]))
+                return DecodeResult::INVALID;
+            quantBuilt[c.quant] = dcBuilt[c.dcTable] = acBuilt[c.acTable] = true;
+        }
+        if (progressive && !buildTables(parsed, header))
+            return DecodeResult::INVALID;
+
+        // A single component is never interleaved: one block per MCU
+        if (n == 1)
+            comps[0].h = comps[0].v = hMax = vMax = 1;
+
+        mcusX = (imageWidth + 8 * hMax - 1) / (8 * hMax);
+        mcusY = (imageHeight + 8 * vMax - 1) / (8 * vMax);
+        componentCount = n;
+        if (progressive)
+        {
+            DecodeResult res = startScan();
+            if (res != DecodeResult::OK)
+                componentCount = 0;
+            return res;
+        }
+        return DecodeResult::OK;
+    }
+
+    // Top up the bit buffer to at least 25 bits, unstuffing 0xFF00 and
+    // stopping at markers (zeros are fed from then on)
+    IRAM_ATTR void Decoder::fillBits()
+    {
+        while (bitCount <= 24)
+        {
+            uint32_t b = 0;
+            if (!atMarker)
+            {
+                int c = inputPos < inputLen ? input[inputPos++] : readByte();
+                if (c < 0)
+                {
+                    atMarker = inputEnded = true;
+                }
+                else if (c == 0xFF)
+                {
+                    int next;
+                    do
+                        next = readByte();
+                    while (next == 0xFF);
+                    if (next == 0)
+                        b = 0xFF;
+                    else
+                    {
+                        atMarker = true;
+                        inputEnded = next < 0;
+                        marker = next;
+                    }
+                }
+                else
+                {
+                    b = c;
+                }
+            }
+            bits |= b << (24 - bitCount);
+            bitCount += 8;
+        }
+    }
+
+    // Decode one Huffman symbol; -1 on an invalid code
+    IRAM_ATTR int Decoder::decodeSymbol(const Huffman &table)
+    {
+        if (bitCount < 16)
+            fillBits();
+
+        uint16_t hit = table.lookup[bits >> (32 - LOOKAHEAD_BITS)];
+        if (hit)
+        {
+            int len = hit >> 8;
+            bits <<= len;
+            bitCount -= len;
+            return hit & 0xFF;
+        }
+
+        // Longer code: walk the canonical code lengths
+        int len = LOOKAHEAD_BITS + 1;
+        int32_t code = bits >> (32 - len);
+        while (code > table.maxCode[len])
+        {
+            if (++len > 16)
+                return -1;
+            code = bits >> (32 - len);
+        }
+        bits <<= len;
+        bitCount -= len;
+        return table.values[table.valueOffset[len] + code];
+    }
+
+    // Read size bits as they are
+    IRAM_ATTR int Decoder::receive(int size)
+    {
+        if (bitCount < size)
+            fillBits();
+        int32_t v = bits >> (32 - size);
+        bits <<= size;
+        bitCount -= size;
+        return v;
+    }
+
+    // Read size bits and sign-extend them into a coefficient
+    IRAM_ATTR int Decoder::receiveExtend(int size)
+    {
+        if (bitCount < size)
+            fillBits();
+        int32_t v = bits >> (32 - size);
+        bits <<= size;
+        bitCount -= size;
+        return v < (1 << (size - 1)) ? v - (1 << size) + 1 : v;
+    }
+
+    // Decode one 8x8 block of coefficients into natural order
+    IRAM_ATTR bool Decoder::decodeBlock(Component &c, int16_t *coef)
+    {
+        memset(coef, 0, 64 * sizeof(int16_t));
+
+        int s = decodeSymbol(tables->dc[c.dcTable]);
+        if (s < 0 || s > 11)
+            return false;
+        if (s)
+            c.dc += receiveExtend(s);
+        coef[0] = c.dc;
+
+        const Huffman &ac = tables->ac[c.acTable];
+        for (int k = 1; k < 64;)
+        {
+            int rs = decodeSymbol(ac);
+            if (rs < 0)
+                return false;
+            int run = rs >> 4;
+            s = rs & 0x0F;
+            if (!s)
+            {
+                if (run != 15)
+                    break; // End of block
+                k += 16;
+                continue;
+            }
+            k += run;
+            if (k > 63)
+                return false;
+            coef[ZIGZAG[k++]] = receiveExtend(s);
+        }
+        return true;
+    }
+
+    // Dequantize and inverse transform one block into 8x8 samples
+    IRAM_ATTR void Decoder::idct(const int16_t *coef, const int32_t *quant, uint8_t *out, size_t stride)
+    {
+        int32_t ws[64];
+
+        // Pass 1: columns, keeping PASS1_BITS of extra precision
+        for (int col = 0; col < 8; col++)
+        {
+            const int16_t *in = coef + col;
+            const int32_t *q = quant + col;
+            int32_t *w = ws + col;
+
+            // Only a DC term: the column is flat
+            if (!in[8] && !in[16] && !in[24] && !in[32] && !in[40] && !in[48] && !in[56])
+            {
+                int32_t dc = in[0] * q[0];
+                for (int r = 0; r < 8; r++)
+                    w[r * 8] = dc;
+                continue;
+            }
+
+            // Even part
+            int32_t tmp0 = in[0] * q[0];
+            int32_t tmp1 = in[16] * q[16];
+            int32_t tmp2 = in[32] * q[32];
+            int32_t tmp3 = in[48] * q[48];
+            int32_t tmp10 = tmp0 + tmp2;
+            int32_t tmp11 = tmp0 - tmp2;
+            int32_t tmp13 = tmp1 + tmp3;
+            int32_t tmp12 = (((tmp1 - tmp3) * FIX_1_414213562) >> CONST_BITS) - tmp13;
+            tmp0 = tmp10 + tmp13;
+            tmp3 = tmp10 - tmp13;
+            tmp1 = tmp11 + tmp12;
+            tmp2 = tmp11 - tmp12;
+
+            // Odd part
+            int32_t tmp4 = in[8] * q[8];
+            int32_t tmp5 = in[24] * q[24];
+            int32_t tmp6 = in[40] * q[40];
+            int32_t tmp7 = in[56] * q[56];
+            int32_t z13 = tmp6 + tmp5;
+            int32_t z10 = tmp6 - tmp5;
+            int32_t z11 = tmp4 + tmp7;
+            int32_t z12 = tmp4 - tmp7;
+            tmp7 = z11 + z13;
+            tmp11 = ((z11 - z13) * FIX_1_414213562) >> CONST_BITS;
+            int32_t z5 = ((z10 + z12) * FIX_1_847759065) >> CONST_BITS;
+            tmp10 = ((z12 * FIX_1_082392200) >> CONST_BITS) - z5;
+            tmp12 = ((z10 * -FIX_2_613125930) >> CONST_BITS) + z5;
+            tmp6 = tmp12 - tmp7;
+            tmp5 = tmp11 - tmp6;
+            tmp4 = tmp10 + tmp5;
+
+            w[0] = tmp0 + tmp7;
+            w[56] = tmp0 - tmp7;
+            w[8] = tmp1 + tmp6;
+            w[48] = tmp1 - tmp6;
+            w[16] = tmp2 + tmp5;
+            w[40] = tmp2 - tmp5;
+            w[32] = tmp3 + tmp4;
+            w[24] = tmp3 - tmp4;
+        }
+
+        // Pass 2: rows, descaling to samples around 128
+        constexpr int SHIFT = PASS1_BITS + 3;
+        constexpr int32_t BIAS = (128 << SHIFT) + (1 << (SHIFT - 1));
+        for (int row = 0; row < 8; row++, out += stride)
+        {
+            const int32_t *w = ws + row * 8;
+
+            if (!w[1] && !w[2] && !w[3] && !w[4] && !w[5] && !w[6] && !w[7])
+            {
+                memset(out, clampSample((w[0] + BIAS) >> SHIFT), 8);
+                continue;
+            }
+
+            // Even part
+            int32_t tmp10 = w[0] + w[4];
+            int32_t tmp11 = w[0] - w[4];
+            int32_t tmp13 = w[2] + w[6];
+            int32_t tmp12 = (((w[2] - w[6]) * FIX_1_414213562) >> CONST_BITS) - tmp13;
+            int32_t tmp0 = tmp10 + tmp13;
+            int32_t tmp3 = tmp10 - tmp13;
+            int32_t tmp1 = tmp11 + tmp12;
+            int32_t tmp2 = tmp11 - tmp12;
+
+            // Odd part
+            int32_t z13 = w[5] + w[3];
+            int32_t z10 = w[5] - w[3];
+            int32_t z11 = w[1] + w[7];
+            int32_t z12 = w[1] - w[7];
+            int32_t tmp7 = z11 + z13;
+            tmp11 = ((z11 - z13) * FIX_1_414213562) >> CONST_BITS;
+            int32_t z5 = ((z10 + z12) * FIX_1_847759065) >> CONST_BITS;
+            tmp10 = ((z12 * FIX_1_082392200) >> CONST_BITS) - z5;
+            tmp12 = ((z10 * -FIX_2_613125930) >> CONST_BITS) + z5;
+            int32_t tmp6 = tmp12 - tmp7;
+            int32_t tmp5 = tmp11 - tmp6;
+            int32_t tmp4 = tmp10 + tmp5;
+
+            out[0] = clampSample((tmp0 + tmp7 + BIAS) >> SHIFT);
+            out[7] = clampSample((tmp0 - tmp7 + BIAS) >> SHIFT);
+            out[1] = clampSample((tmp1 + tmp6 + BIAS) >> SHIFT);
+            out[6] = clampSample((tmp1 - tmp6 + BIAS) >> SHIFT);
+            out[2] = clampSample((tmp2 + tmp5 + BIAS) >> SHIFT);
+            out[5] = clampSample((tmp2 - tmp5 + BIAS) >> SHIFT);
+            out[4] = clampSample((tmp3 + tmp4 + BIAS) >> SHIFT);
+            out[3] = clampSample((tmp3 - tmp4 + BIAS) >> SHIFT);
+        }
+    }
+
+    // Inverse transform one block into c's plane, at its output size
+    IRAM_ATTR void Decoder::transform(const Component &c, const int16_t *coef, uint8_t *out)
+    {
+        switch (c.block)
+        {
+        case 8:
+            idct(coef, tables->quant[c.quant], out, c.stride);
+            break;
+        case 4:
+            reduced::idct4x4(coef, tables->raw[c.quant], out, c.stride);
+            break;
+        case 2:
+            reduced::idct2x2(coef, tables->raw[c.quant], out, c.stride);
+            break;
+        default:
+            // 1/8: the block's average is its DC term
+            *out = clampSample(reduced::descale(coef[0] * tables->raw[c.quant][0], 3) + 128);
+            break;
+        }
+    }
+
+    // Upsample chroma and convert the first rows of the MCU row to RGB888
+    IRAM_ATTR void Decoder::convertRows(uint16_t rows)
+    {
+        const Component &y = comps[0], &cb = comps[1], &cr = comps[2];
+        const int cbx = cb.upX, cby = cb.upY, crx = cr.upX, cry = cr.upY;
+
+        for (uint16_t r = 0; r < rows; r++)
+        {
+            const uint8_t *py = &y.plane[r * y.stride];
+            const uint8_t *pcb = &cb.plane[(r >> cby) * cb.stride];
+            const uint8_t *pcr = &cr.plane[(r >> cry) * cr.stride];
+            uint8_t *out = &band[(size_t)r * outputWidth() * 3];
+
+            for (uint16_t x = 0, w = outputWidth(); x < w; x++, out += 3)
+            {
+                int32_t l = py[x] << 16;
+                int32_t u = pcb[x >> cbx] - 128;
+                int32_t v = pcr[x >> crx] - 128;
+                out[0] = clampSample((l + CR_R * v + 32768) >> 16);
+                out[1] = clampSample((l - CB_G * u - CR_G * v + 32768) >> 16);
+                out[2] = clampSample((l + CB_B * u + 32768) >> 16);
+            }
+        }
+    }
+
+    // Resynchronize at a restart marker
+    bool Decoder::restart()
+    {
+        // Drop the padding bits, then find the RSTn marker
+        bits = 0;
+        bitCount = 0;
+        if (!atMarker)
+        {
+            int c;
+            do
+            {
+                c = readByte();
+                while (c >= 0 && c != 0xFF)
+                    c = readByte();
+                do
+                    c = readByte();
+                while (c == 0xFF);
+            } while (c == 0);
+            if (c < 0)
+                return false;
+            marker = c;
+        }
+        if (inputEnded || marker < RST0 || marker > RST7)
+            return false;
+
+        atMarker = false;
+        restarts++;
+        eobRun = 0;
+        for (int i = 0; i < componentCount; i++)
+            comps[i].dc = 0;
+        return true;
+    }
+
+    // Skip to the marker that ends the scan, past any restart markers
+    bool Decoder::findMarker()
+    {
+        if (atMarker)
+            return !inputEnded;
+        while (inputPos < inputLen || fetch())
+        {
+            // Scan data only has 0xFF stuffed (0xFF00) or in markers
+            const uint8_t *ff = static_cast<const uint8_t *>(memchr(input + inputPos, 0xFF, inputLen - inputPos));
+            if (!ff)
+            {
+                inputPos = inputLen;
+                continue;
+            }
+            inputPos = ff - input + 1;
+            int c;
+            do
+                c = readByte();
+            while (c == 0xFF);
+            if (c < 0)
+                break;
+            if (c && (c < RST0 || c > RST7))
+            {
+                marker = c;
+                atMarker = true;
+                return true;
+            }
+        }
+        atMarker = inputEnded = true;
+        return false;
+    }
+
+    // Decode at 1/scale of the full size
+    void Decoder::setScale(uint8_t scale)
+    {
+        scaleBits = scale >= 8 ? 3 : scale >= 4 ? 2 : scale >= 2 ? 1 : 0;
+    }
+
+    // Decode color images as their luma alone
+    void Decoder::setLumaOnly(bool on)
+    {
+        lumaOnly = on;
+    }
+
+    // One MCU row of samples per component, plus the RGB rows, at the output
+    // scale. When scaling down, 2x subsampled chroma is decoded with the next
+    // larger IDCT instead of being replicated (as libjpeg-turbo does).
+    void Decoder::allocate()
+    {
+        const int block = 8 >> scaleBits;
+        for (int i = 0; i < componentCount; i++)
+        {
+            Component &c = comps[i];
+            c.dc = 0;
+            if (i && lumaOnly)
+            {
+                std::vector<uint8_t>().swap(c.plane);
+                continue;
+            }
+            c.block = block;
+            c.upX = hMax / c.h - 1;
+            c.upY = vMax / c.v - 1;
+            if (block < 8 && c.upX && c.upY)
+            {
+                c.block = block * 2;
+                c.upX = c.upY = 0;
+            }
+            c.stride = (size_t)mcusX * c.h * c.block;
+            c.plane.assign(c.stride * c.v * c.block, 0);
+        }
+        if (components() == 3)
+            band.assign((size_t)outputWidth() * vMax * block * 3, 0);
+    }
+
+    // Decode the scan (or scans), handing every MCU row to sink
+    DecodeResult Decoder::decode(PixelSink &sink)
+    {
+        if (!componentCount || !tables)
+            return DecodeResult::INVALID;
+
+        allocate();
+        DecodeResult res = DecodeResult::OK;
+        if (progressive && !allocateCoefficients())
+            res = DecodeResult::MEMORY;
+        else if (progressive)
+            res = decodeProgressive(sink);
+        else if (!sink.begin(outputWidth(), outputHeight(), components()))
+            res = DecodeResult::INPUT;
+        else
+        {
+            bits = 0;
+            bitCount = 0;
+            atMarker = inputEnded = false;
+            restarts = 0;
+            rowLimit = mcusY;
+            splitTried = false;
+
+            res = decodeRows(sink, 0);
+            finishSplit(res);
+        }
+
+        // Release the working buffers; they are only needed while decoding
+        for (int i = 0; i < componentCount; i++)
+            std::vector<uint8_t>().swap(comps[i].plane);
+        std::vector<uint8_t>().swap(band);
+        releaseCoefficients();
+        return res;
+    }
+
+    // Hand MCU row `row` of the planes over to sink, clipped to the image
+    bool Decoder::emitRows(PixelSink &sink, uint16_t row)
+    {
+        const int block = 8 >> scaleBits;
+        uint16_t top = row * vMax * block;
+        uint16_t rows = min<int>(vMax * block, outputHeight() - top);
+        if (components() == 1)
+            return sink.rows(top, rows, comps[0].plane.data(), comps[0].stride);
+        convertRows(rows);
+        return sink.rows(top, rows, band.data(), (size_t)outputWidth() * 3);
+    }
+
+    // Decode MCU rows from firstRow (where the input is positioned) up to
+    // rowLimit, handing each one to sink
+    DecodeResult Decoder::decodeRows(PixelSink &sink, uint16_t firstRow)
+    {
+        DecodeResult res = DecodeResult::OK;
+        int16_t coef[64];
+        const uint32_t first = (uint32_t)firstRow * mcusX;
+        uint32_t mcu = first;
+        for (uint16_t my = firstRow; my < rowLimit && res == DecodeResult::OK; my++)
+        {
+            if (stop && stop->load(std::memory_order_relaxed))
+                return DecodeResult::INPUT;
+
+            // Once the download is done, give half of what is left to the
+            // other core
+            if (!stop && !splitTried)
+                trySplit(sink, my);
+
+            for (uint16_t mx = 0; mx < mcusX; mx++, mcu++)
+            {
+                if (restartInterval && mcu != first && mcu % restartInterval == 0 && !restart())
+                {
+                    res = inputEnded ? DecodeResult::INPUT : DecodeResult::INVALID;
+                    break;
+                }
+
+                for (int i = 0; i < componentCount; i++)
+                {
+                    Component &c = comps[i];
+                    for (int by = 0; by < c.v; by++)
+                    {
+                        for (int bx = 0; bx < c.h; bx++)
+                        {
+                            if (!decodeBlock(c, coef))
+                                res = DecodeResult::INVALID;
+                            // Chroma has to be parsed to get past it, but
+                            // that's all when only luma is wanted
+                            if (i && lumaOnly)
+                                continue;
+                            transform(c, coef, &c.plane[by * c.block * c.stride + (mx * c.h + bx) * c.block]);
+                        }
+                    }
+                }
+                if (inputEnded)
+                    res = DecodeResult::INPUT;
+                if (res != DecodeResult::OK)
+                    break;
+            }
+            if (res != DecodeResult::OK)
+                break;
+
+            // Hand over the finished MCU row
+            if (!emitRows(sink, my))
+                res = DecodeResult::INPUT;
+        }
+        return res;
+    }
+
+    // Progressive scans (ITU T.81 G.1.2, after libjpeg's jdphuff.c): a DC
+    // scan codes the top bits of every DC term, later ones a bit more each;
+    // an AC scan codes one band of one component's coefficients, first the
+    // top bits (with runs of blocks that have nothing left in the band), then
+    // the rest a bit at a time. Coefficients stay in the planes, scaled up
+    // by the bits still to come, until every scan is in.
+
+    // One block of the current scan
+    bool Decoder::decodeScanBlock(Component &c, int16_t *coef)
+    {
+        if (!scan.spectralStart)
+            return scan.approxHigh ? decodeDcRefine(coef) : decodeDcFirst(c, coef);
+        return scan.approxHigh ? decodeAcRefine(c, coef) : decodeAcFirst(c, coef);
+    }
+
+    // Top bits of a DC term: a difference from the previous one, as in a
+    // sequential scan
+    bool Decoder::decodeDcFirst(Component &c, int16_t *coef)
+    {
+        int s = decodeSymbol(tables->dc[c.dcTable]);
+        if (s < 0 || s > 11)
+            return false;
+        if (s)
+            c.dc += receiveExtend(s);
+        coef[0] = c.dc * (1 << scan.approxLow);
+        return true;
+    }
+
+    // One more bit of a DC term
+    bool Decoder::decodeDcRefine(int16_t *coef)
+    {
+        if (receive(1))
+            coef[0] |= 1 << scan.approxLow;
+        return true;
+    }
+
+    // Top bits of a band of AC coefficients, unless the block is in an
+    // end-of-band run
+    IRAM_ATTR bool Decoder::decodeAcFirst(const Component &c, int16_t *coef)
+    {
+        if (eobRun)
+        {
+            eobRun--;
+            return true;
+        }
+
+        const Huffman &ac = tables->ac[c.acTable];
+        for (int k = scan.spectralStart; k <= scan.spectralEnd; k++)
+        {
+            int rs = decodeSymbol(ac);
+            if (rs < 0)
+                return false;
+            int run = rs >> 4;
+            int s = rs & 0x0F;
+            if (s)
+            {
+                k += run;
+                if (k > scan.spectralEnd)
+                    return false;
+                coef[ZIGZAG[k]] = receiveExtend(s) * (1 << scan.approxLow);
+            }
+            else if (run == 15)
+            {
+                k += 15;
+            }
+            else
+            {
+                // End of band here and in the next 2^run + extra - 1 blocks
+                eobRun = 1u << run;
+                if (run)
+                    eobRun += receive(run);
+                eobRun--;
+                break;
+            }
+        }
+        return true;
+    }
+
+    // Next bit of a band of AC coefficients: a correction bit for each one
+    // that is already nonzero, and (outside end-of-band runs) the position
+    // and sign of those that become nonzero with this bit
+    IRAM_ATTR bool Decoder::decodeAcRefine(const Component &c, int16_t *coef)
+    {
+        const int p1 = 1 << scan.approxLow;
+        const int m1 = -p1;
+        const int end = scan.spectralEnd;
+        int k = scan.spectralStart;
+
+        if (!eobRun)
+        {
+            const Huffman &ac = tables->ac[c.acTable];
+            for (; k <= end; k++)
+            {
+                int rs = decodeSymbol(ac);
+                if (rs < 0)
+                    return false;
+                int run = rs >> 4;
+                int s = rs & 0x0F;
+                int value = 0;
+                if (s)
+                {
+                    if (s != 1)
+                        return false;
+                    value = receive(1) ? p1 : m1;
+                }
+                else if (run != 15)
+                {
+                    eobRun = 1u << run;
+                    if (run)
+                        eobRun += receive(run);
+                    break;
+                }
+
+                // Pass run coefficients that are still zero (refining the
+                // nonzero ones in between), landing on the new one
+                for (; k <= end; k++)
+                {
+                    int16_t &v = coef[ZIGZAG[k]];
+                    if (v)
+                    {
+                        if (receive(1) && !(v & p1))
+                            v += v >= 0 ? p1 : m1;
+                    }
+                    else if (--run < 0)
+                    {
+                        break;
+                    }
+                }
+                if (value)
+                {
+                    if (k > end)
+                        return false;
+                    coef[ZIGZAG[k]] = value;
+                }
+            }
+        }
+
+        if (eobRun)
+        {
+            // The rest of the band only refines what is already nonzero
+            for (; k <= end; k++)
+            {
+                int16_t &v = coef[ZIGZAG[k]];
+                if (v && receive(1) && !(v & p1))
+                    v += v >= 0 ? p1 : m1;
+            }
+            eobRun--;
+        }
+        return true;
+    }
+
+    // Check the current scan against the frame and the tables built so far,
+    // and point its components at their tables
+    DecodeResult Decoder::startScan()
+    {
+        // DC terms alone, or one band of one component's AC coefficients;
+        // each refinement adds a single bit
+        const uint8_t ss = scan.spectralStart, se = scan.spectralEnd;
+        if ((ss ? se < ss || se > 63 || scan.scanCount != 1 : se != 0) || scan.approxLow > 13 ||
+            (scan.approxHigh && scan.approxHigh != scan.approxLow + 1))
+            return DecodeResult::INVALID;
+
+        for (int i = 0; i < scan.scanCount; i++)
+        {
+            int k = 0;
+            while (k < componentCount && comps[k].id != scan.scan[i].id)
+                k++;
+            if (k == componentCount)
+                return DecodeResult::INVALID;
+            Component &c = comps[k];
+            c.dcTable = scan.scan[i].dcTable;
+            c.acTable = scan.scan[i].acTable;
+            if (!(quantReady >> c.quant & 1) || (!ss && !scan.approxHigh && !(dcReady >> c.dcTable & 1)) ||
+                (ss && !(acReady >> c.acTable & 1)))
+                return DecodeResult::INVALID;
+            scanComps[i] = k;
+        }
+        return DecodeResult::OK;
+    }
+
+    // Decode the current scan into the coefficient planes
+    DecodeResult Decoder::decodeScan()
+    {
+        bits = 0;
+        bitCount = 0;
+        atMarker = inputEnded = false;
+        restarts = 0;
+        eobRun = 0;
+        for (int i = 0; i < componentCount; i++)
+            comps[i].dc = 0;
+
+        // Nothing to keep (chroma, when only luma is wanted): jump to the
+        // end of the scan without decoding it
+        bool kept = false;
+        for (int i = 0; i < scan.scanCount; i++)
+            kept |= comps[scanComps[i]].coefs != nullptr;
+        if (!kept)
+            return findMarker() ? DecodeResult::OK : DecodeResult::INPUT;
+
+        int16_t scratch[64] = {}; // Blocks of components that aren't kept
+        const uint16_t interval = scan.restartInterval;
+        uint32_t mcu = 0;
+        if (scan.scanCount == 1)
+        {
+            // Not interleaved: an MCU is a single block, and only those
+            // covering the component's own size are coded
+            Component &c = comps[scanComps[0]];
+            const uint16_t blocksX = ((imageWidth * c.h + hMax - 1) / hMax + 7) / 8;
+            const uint16_t blocksY = ((imageHeight * c.v + vMax - 1) / vMax + 7) / 8;
+            for (uint16_t by = 0; by < blocksY; by++)
+            {
+                int16_t *row = &c.coefs[(size_t)by * c.blocksX * 64];
+                for (uint16_t bx = 0; bx < blocksX; bx++, mcu++)
+                {
+                    if (interval && mcu && mcu % interval == 0 && !restart())
+                        return inputEnded ? DecodeResult::INPUT : DecodeResult::INVALID;
+                    if (!decodeScanBlock(c, row + bx * 64))
+                        return DecodeResult::INVALID;
+                }
+                if (inputEnded)
+                    return DecodeResult::INPUT;
+            }
+            return DecodeResult::OK;
+        }
+
+        // Interleaved (DC scans only): whole MCUs, as in a sequential scan
+        for (uint16_t my = 0; my < mcusY; my++)
+        {
+            for (uint16_t mx = 0; mx < mcusX; mx++, mcu++)
+            {
+                if (interval && mcu && mcu % interval == 0 && !restart())
+                    return inputEnded ? DecodeResult::INPUT : DecodeResult::INVALID;
+                for (int i = 0; i < scan.scanCount; i++)
+                {
+                    Component &c = comps[scanComps[i]];
+                    for (int by = 0; by < c.v; by++)
+                    {
+                        for (int bx = 0; bx < c.h; bx++)
+                        {
+                            int16_t *coef = scratch;
+                            if (c.coefs)
+                                coef = &c.coefs[((size_t)(my * c.v + by) * c.blocksX + mx * c.h + bx) * 64];
+                            if (!decodeScanBlock(c, coef))
+                                return DecodeResult::INVALID;
+                        }
+                    }
+                }
+            }
+            if (inputEnded)
+                return DecodeResult::INPUT;
+        }
+        return DecodeResult::OK;
+    }
+
+    // Read the markers that follow a scan, up to the start of the next one
+    // (OK with scan.scanCount 0 at the end of the image)
+    DecodeResult Decoder::nextScan()
+    {
+        if (!findMarker())
+            return DecodeResult::INPUT;
+
+        // Grow the segment buffer by as much as the parser asks for, as
+        // prepare() does, starting from the marker the scan ended at
+        std::vector<uint8_t> segments = {0xFF, marker};
+        jpeg_utils::JpegInfo parsed = jpeg_utils::parseNextScan(scan, segments.data(), segments.size());
+        while (parsed.status == DecodeResult::INPUT)
+        {
+            if (parsed.needed > MAX_HEADER)
+                return DecodeResult::UNSUPPORTED;
+            size_t have = segments.size();
+            segments.resize(parsed.needed);
+            if (readBytes(segments.data() + have, parsed.needed - have) != parsed.needed - have)
+                return DecodeResult::INPUT;
+            parsed = jpeg_utils::parseNextScan(scan, segments.data(), segments.size());
+        }
+        if (parsed.status != DecodeResult::OK)
+            return parsed.status;
+        if (!buildTables(parsed, segments.data()))
+            return DecodeResult::INVALID;
+        scan = parsed;
+        return scan.scanCount ? startScan() : DecodeResult::OK;
+    }
+
+    // A plane of coefficients for every component that is output, covering
+    // whole MCUs
+    bool Decoder::allocateCoefficients()
+    {
+        for (int i = 0; i < componentCount; i++)
+        {
+            Component &c = comps[i];
+            if (i && lumaOnly)
+                continue;
+            c.blocksX = mcusX * c.h;
+            c.blocksY = mcusY * c.v;
+            uint64_t count = (uint64_t)c.blocksX * c.blocksY * 64;
+            if (count > SIZE_MAX / sizeof(int16_t))
+            {
+                releaseCoefficients();
+                return false;
+            }
+
+            // Prefer PSRAM, fall back to internal RAM if there is none
+            c.coefs = static_cast<int16_t *>(
+                heap_caps_calloc(count, sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+            if (!c.coefs)
+                c.coefs = static_cast<int16_t *>(heap_caps_calloc(count, sizeof(int16_t), MALLOC_CAP_8BIT));
+            if (!c.coefs)
+            {
+                releaseCoefficients();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Free the coefficient planes
+    void Decoder::releaseCoefficients()
+    {
+        for (Component &c : comps)
+        {
+            if (c.coefs)
+                heap_caps_free(c.coefs);
+            c.coefs = nullptr;
+        }
+    }
+
+    // Decode every scan into the coefficient planes, then transform them and
+    // hand the image over one MCU row at a time
+    DecodeResult Decoder::decodeProgressive(PixelSink &sink)
+    {
+        DecodeResult res = DecodeResult::OK;
+        while (res == DecodeResult::OK && scan.scanCount)
+        {
+            res = decodeScan();
+            if (res == DecodeResult::OK)
+                res = nextScan();
+        }
+
+        // The sink hears of the image only once all of it is in
+        if (res == DecodeResult::OK && !sink.begin(outputWidth(), outputHeight(), components()))
+            res = DecodeResult::INPUT;
+        for (uint16_t my = 0; my < mcusY && res == DecodeResult::OK; my++)
+        {
+            for (int i = 0; i < componentCount; i++)
+            {
+                Component &c = comps[i];
+                if (!c.coefs)
+                    continue;
+                for (int by = 0; by < c.v; by++)
+                {
+                    const int16_t *coef = &c.coefs[(size_t)(my * c.v + by) * c.blocksX * 64];
+                    uint8_t *out = &c.plane[by * c.block * c.stride];
+                    for (uint16_t bx = 0; bx < c.blocksX; bx++, coef += 64, out += c.block)
+                        transform(c, coef, out);
+                }
+            }
+            if (!emitRows(sink, my))
+                res = DecodeResult::INPUT;
+        }
+        return res;
+    }
+
+    // Smallest number of MCU rows worth handing to the other core
+    static constexpr uint16_t MIN_SPLIT_ROWS = 4;
+
+    // Stack of the second-core decode task; the sink's dithering and
+    // framebuffer writes run on it too
+    static constexpr uint32_t SPLIT_STACK = 6144;
+
+    // Decoder for the bottom rows, running on the other core
+    struct Decoder::Split
+    {
+        Decoder worker;
+        PixelSink *sink = nullptr;
+        uint16_t firstRow = 0;
+        DecodeResult result = DecodeResult::OK;
+        std::atomic<bool> stop{false};
+        SemaphoreHandle_t done = nullptr;
+
+        ~Split()
+        {
+            if (done)
+                vSemaphoreDelete(done);
+        }
+    };
+
+    Decoder::Decoder() = default;
+
+    Decoder::~Decoder()
+    {
+        releaseCoefficients();
+    }
+
+    // Second-core task: decode the split rows, then signal the main decoder
+    void Decoder::splitTask(void *arg)
+    {
+        Split *split = static_cast<Split *>(arg);
+        split->result = split->worker.decodeRows(*split->sink, split->firstRow);
+        xSemaphoreGive(split->done);
+        vTaskDelete(nullptr);
+    }
+
+    // At the start of MCU row `row`: if the rest of the input is in memory
+    // and restarts fall on row boundaries, decode the second half of the
+    // remaining rows on the other core
+    bool Decoder::trySplit(PixelSink &sink, uint16_t row)
+    {
+        if (portNUM_PROCESSORS < 2 || !restartInterval || !src)
+            return false;
+
+        // Restart intervals must start whole MCU rows
+        uint16_t step;
+        if (restartInterval % mcusX == 0)
+            step = restartInterval / mcusX;
+        else if (mcusX % restartInterval == 0)
+            step = 1;
+        else
+            return false;
+        if (rowLimit - row < 2 * MIN_SPLIT_ROWS)
+            return false;
+
+        size_t len;
+        const uint8_t *rest = src->remaining(len);
+        if (!rest)
+            return false;
+        splitTried = true; // Only worth indexing the markers once
+
+        // Halfway down what is left, on a restart boundary and an even
+        // output row (so the two cores never share a framebuffer byte)
+        const int block = 8 >> scaleBits;
+        uint16_t at = (row + rowLimit) / 2;
+        at -= at % step;
+        if ((at * vMax * block) & 1)
+            at += step;
+        if (at <= row || rowLimit - at < MIN_SPLIT_ROWS)
+            return false;
+
+        // The marker ahead of row `at`, counting those already read (the
+        // bit reader may have stopped at the next one)
+        uint32_t markers = (uint32_t)at * mcusX / restartInterval;
+        uint32_t passed = restarts + (atMarker && !inputEnded ? 1 : 0);
+        if (markers <= passed)
+            return false;
+        uint32_t ahead = markers - passed;
+
+        // Markers still in the input block come before the rest of the input
+        size_t buffered = inputLen - inputPos;
+        std::vector<size_t> inBlock = jpeg_utils::restartOffsets(input + inputPos, buffered, ahead);
+        if (buffered && input[inputLen - 1] == 0xFF && len && rest[0] >= RST0 && rest[0] <= RST7)
+            inBlock.push_back(buffered + 1); // Marker split across the two
+        if (inBlock.size() >= ahead)
+            return false;
+        std::vector<size_t> offsets = jpeg_utils::restartOffsets(rest, len, ahead - inBlock.size());
+        if (offsets.size() != ahead - inBlock.size())
+            return false;
+        size_t offset = offsets.back();
+
+        std::unique_ptr<Split> s(new (std::nothrow) Split);
+        if (!s || !(s->done = xSemaphoreCreateBinary()))
+            return false;
+
+        // Same headers, reading from memory just past the marker
+        Decoder &w = s->worker;
+        w.tables = tables;
+        for (int i = 0; i < componentCount; i++)
+        {
+            w.comps[i].id = comps[i].id;
+            w.comps[i].h = comps[i].h;
+            w.comps[i].v = comps[i].v;
+            w.comps[i].quant = comps[i].quant;
+            w.comps[i].dcTable = comps[i].dcTable;
+            w.comps[i].acTable = comps[i].acTable;
+        }
+        w.componentCount = componentCount;
+        w.imageWidth = imageWidth;
+        w.imageHeight = imageHeight;
+        w.hMax = hMax;
+        w.vMax = vMax;
+        w.mcusX = mcusX;
+        w.mcusY = mcusY;
+        w.restartInterval = restartInterval;
+        w.scaleBits = scaleBits;
+        w.lumaOnly = lumaOnly;
+        w.src = nullptr;
+        w.input = rest + offset;
+        w.inputLen = len - offset;
+        w.rowLimit = rowLimit;
+        w.stop = &s->stop;
+        w.allocate();
+
+        s->firstRow = at;
+        s->sink = sink.split(at * vMax * block);
+        if (!s->sink)
+            return false;
+
+        BaseType_t core = xPortGetCoreID() == 0 ? 1 : 0;
+        if (xTaskCreatePinnedToCore(splitTask, "inky-jpeg", SPLIT_STACK, s.get(), uxTaskPriorityGet(nullptr),
+                                    nullptr, core) != pdPASS)
+            return false;
+
+        rowLimit = at;
+        split = std::move(s);
+        return true;
+    }
+
+    // Wait for the second-core decode (if any) and merge its result
+    void Decoder::finishSplit(DecodeResult &res)
+    {
+        if (!split)
+            return;
+        if (res != DecodeResult::OK)
+            split->stop.store(true);
+        xSemaphoreTake(split->done, portMAX_DELAY);
+        if (res == DecodeResult::OK)
+            res = split->result;
+        split.reset();
+    }
+}
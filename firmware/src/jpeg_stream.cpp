@@ -0,0 +1,162 @@
+#include <Arduino.h>
+
+#include "framebuffer.h"
+#include "jpeg_stream.h"
+#include "logger.h"
+
+namespace jpeg_stream
+{
+    // Start a band at output row firstRow
+    bool Decoder::Band::start(Decoder &decoder, uint16_t w, uint16_t firstRow)
+    {
+        owner = &decoder;
+        width = w;
+        return ditherer.begin(decoder.mode, w, firstRow, decoder.tone, decoder.bilevel);
+    }
+
+    // Release the band's working rows
+    void Decoder::Band::end()
+    {
+        ditherer.end();
+        std::vector<uint8_t>().swap(quantized);
+    }
+
+    // Convert rows to display colors and draw them
+    bool Decoder::Band::rows(uint16_t y, uint16_t count, const uint8_t *pixels, size_t pitch)
+    {
+        const Decoder &d = *owner;
+
+        // Panel colors of the whole MCU row, written out in one go
+        quantized.resize((size_t)width * count);
+        for (uint16_t r = 0; r < count; r++)
+            ditherer.row(pixels + r * pitch, d.components, &quantized[(size_t)r * width]);
+
+        // Straight into the framebuffer when it's laid out as compiled for;
+        // through Adafruit_GFX otherwise
+        if (d.direct)
+        {
+            framebuffer::writeRows(*d.display, d.originX, d.originY + y, quantized.data(), width, width, count);
+        }
+        else
+        {
+            for (uint16_t r = 0; r < count; r++)
+                for (uint16_t c = 0; c < width; c++)
+                    d.display->drawPixel(d.originX + c, d.originY + y + r,
+                                         framebuffer::color(*d.display, quantized[(size_t)r * width + c]));
+        }
+        return true;
+    }
+
+    // Set up the resize and the top band for the decoded image
+    bool Decoder::begin(uint16_t width, uint16_t height, uint8_t count)
+    {
+        components = count;
+        nextRow = 0;
+        resizing = width > fitWidth || height > fitHeight;
+        if (resizing && !filter.begin(width, height, fitWidth, fitHeight, count))
+            return false;
+        if (!top.start(*this, resizing ? fitWidth : width, 0))
+            return false;
+
+        // Only now is the image sure to be drawn: one rejected from its
+        // headers, or without the memory to decode it, leaves the display
+        // as it was
+        display->clearDisplay();
+        return true;
+    }
+
+    // Shrink an MCU row if needed and draw it
+    bool Decoder::rows(uint16_t y, uint16_t count, const uint8_t *pixels, size_t pitch)
+    {
+        if (!resizing)
+            return top.rows(y, count, pixels, pitch);
+
+        // Collect what the box filter makes of the rows, then draw that
+        const size_t w = (size_t)fitWidth * components;
+        shrunk.resize(w * count);
+        uint16_t done = 0;
+        for (uint16_t r = 0; r < count; r++)
+        {
+            const uint8_t *row = filter.push(pixels + r * pitch);
+            if (row)
+                memcpy(&shrunk[w * done++], row, w);
+        }
+        bool ok = !done || top.rows(nextRow, done, shrunk.data(), w);
+        nextRow += done;
+        return ok;
+    }
+
+    // Draw rows from y on as a second band, from the other core. Not while
+    // shrinking (the box filter runs across the split), nor when the bands
+    // would share framebuffer bytes: in portrait a byte holds 2 rows of the
+    // 3-bit buffer and 8 of the 1-bit one, and both cores would
+    // read-modify-write the bytes on the seam.
+    jpeg_decoder::PixelSink *Decoder::split(uint16_t y)
+    {
+        if (resizing || (originY + y) % (bilevel ? 8 : 2))
+            return nullptr;
+        return bottom.start(*this, jpeg.outputWidth(), y) ? &bottom : nullptr;
+    }
+
+    // Parse the JPEG headers (up to the start of scan) from src
+    Result Decoder::prepare(ByteSource &source)
+    {
+        return jpeg.prepare(source);
+    }
+
+    // Pick the decoder's IDCT scale and the final size for an image that
+    // doesn't fit in maxWidth x maxHeight
+    void Decoder::fit(int maxWidth, int maxHeight)
+    {
+        fitWidth = jpeg.width();
+        fitHeight = jpeg.height();
+        if (maxWidth <= 0 || maxHeight <= 0 || (fitWidth <= maxWidth && fitHeight <= maxHeight))
+            return;
+
+        // Largest size with the same aspect ratio that fits
+        if ((uint32_t)fitWidth * maxHeight > (uint32_t)fitHeight * maxWidth)
+        {
+            fitHeight = max<uint32_t>(1, (uint32_t)fitHeight * maxWidth / fitWidth);
+            fitWidth = maxWidth;
+        }
+        else
+        {
+            fitWidth = max<uint32_t>(1, (uint32_t)fitWidth * maxHeight / fitHeight);
+            fitHeight = maxHeight;
+        }
+
+        // Let the IDCT do as much of it as it can, the box filter the rest
+        uint8_t scale = 1;
+        while (scale < 8 && jpeg.width() / (scale * 2) >= fitWidth && jpeg.height() / (scale * 2) >= fitHeight)
+            scale *= 2;
+        jpeg.setScale(scale);
+        Logger::logf(Logger::LOG_DEBUG, "Shrinking JPEG %ux%u to %ux%u (IDCT 1/%u)", jpeg.width(), jpeg.height(),
+                     fitWidth, fitHeight, scale);
+    }
+
+    // Decode the entropy-coded data and draw it at (x, y)
+    Result Decoder::draw(Inkplate &target, int x, int y, dither::Mode ditherMode, const dither::Tone &toneCurve)
+    {
+        tone = toneCurve;
+        display = &target;
+        originX = x;
+        originY = y;
+        mode = ditherMode;
+        direct = framebuffer::available(target);
+        bilevel = framebuffer::bilevel(target);
+        fit(target.width() - x, target.height() - y);
+#ifndef ARDUINO_INKPLATECOLOR
+        // Only gray levels reach a grayscale panel; don't decode any color
+        jpeg.setLumaOnly(true);
+#endif
+
+        Result res = jpeg.decode(*this);
+
+        // Release the working rows; they are only needed while decoding
+        top.end();
+        bottom.end();
+        filter.end();
+        std::vector<uint8_t>().swap(shrunk);
+        return res;
+    }
+}
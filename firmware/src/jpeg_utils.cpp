@@ -1,63 +1,301 @@
 #include "jpeg_utils.h"
 #include <vector>
 #include <algorithm>
+#include <cstring>
 
 namespace jpeg_utils
 {
-    // Probe the JPEG data to determine its kind (baseline, progressive, other, or invalid).
-    JpegKind probeKind(const uint8_t *data, size_t len)
+    // JPEG markers
+    enum : uint8_t
     {
-        // Check for minimum length and JPEG Start Of Image (SOI) marker (0xFF 0xD8)
-        if (len < 4 || data[0] != 0xFF || data[1] != 0xD8)
-            return JpegKind::INVALID;
+        SOF0 = 0xC0, // Baseline
+        SOF1 = 0xC1, // Extended sequential, Huffman
+        SOF2 = 0xC2, // Progressive, Huffman
+        SOF15 = 0xCF,
+        DHT = 0xC4,
+        JPG = 0xC8,
+        DAC = 0xCC,
+        RST0 = 0xD0,
+        RST7 = 0xD7,
+        SOI = 0xD8,
+        EOI = 0xD9,
+        SOS = 0xDA,
+        DQT = 0xDB,
+        DRI = 0xDD,
+        TEM = 0x01,
+    };
 
-        // Start reading markers just after the SOI
-        size_t pos = 2;
-        // Loop through the data to find segment markers
-        while (pos + 3 < len)
+    // Big-endian 16-bit word
+    static inline uint16_t word(const uint8_t *p)
+    {
+        return (p[0] << 8) | p[1];
+    }
+
+    // Stop parsing: the headers are malformed
+    static JpegInfo &invalid(JpegInfo &info)
+    {
+        info.status = DecodeResult::INVALID;
+        return info;
+    }
+
+    // Stop parsing: more data is needed, up to offset `needed`
+    static JpegInfo &truncated(JpegInfo &info, size_t needed)
+    {
+        info.status = DecodeResult::INPUT;
+        info.needed = needed;
+        return info;
+    }
+
+    // SOFn body: precision, size and components
+    static bool parseFrame(JpegInfo &info, const uint8_t *p, size_t len)
+    {
+        if (info.kind != JpegKind::INVALID || len < 6)
+            return false; // One frame per image
+        uint8_t n = p[5];
+        if (n < 1 || n > 4 || len != 6 + 3 * (size_t)n)
+            return false;
+        info.precision = p[0];
+        info.height = word(p + 1);
+        info.width = word(p + 3);
+        info.componentCount = n;
+        if (!info.width || !info.height)
+            return false; // DNL-sized images are not supported either way
+        for (int i = 0; i < n; i++)
+        {
+            JpegInfo::Component &c = info.components[i];
+            c.id = p[6 + i * 3];
+            c.h = p[7 + i * 3] >> 4;
+            c.v = p[7 + i * 3] & 0x0F;
+            c.quant = p[8 + i * 3];
+            if (c.h < 1 || c.h > 4 || c.v < 1 || c.v > 4 || c.quant > 3)
+                return false;
+        }
+        return true;
+    }
+
+    // DQT body: one or more tables, recorded where they start
+    static bool parseQuantTables(JpegInfo &info, size_t pos, const uint8_t *data, size_t end)
+    {
+        while (pos < end)
+        {
+            uint8_t id = data[pos] & 0x0F;
+            bool wide = data[pos] >> 4;
+            size_t size = 1 + 64 * (wide ? 2 : 1);
+            if (id > 3 || data[pos] >> 4 > 1 || pos + size > end)
+                return false;
+            info.quant[id] = {static_cast<uint32_t>(pos + 1), wide};
+            pos += size;
+        }
+        return true;
+    }
+
+    // DHT body: one or more tables, recorded where their code counts start
+    static bool parseHuffmanTables(JpegInfo &info, size_t pos, const uint8_t *data, size_t end)
+    {
+        while (pos < end)
         {
-            // Skip any bytes until we see a 0xFF marker prefix
+            uint8_t id = data[pos] & 0x0F;
+            uint8_t tc = data[pos] >> 4;
+            if (id > 3 || tc > 1 || pos + 17 > end)
+                return false;
+            size_t total = 0;
+            for (int l = 0; l < 16; l++)
+                total += data[pos + 1 + l];
+            if (total > 256 || pos + 17 + total > end)
+                return false;
+            (tc ? info.acTables : info.dcTables)[id] = pos + 1;
+            pos += 17 + total;
+        }
+        return true;
+    }
+
+    // SOS body: the scan's components, their tables and its coefficients
+    static bool parseScan(JpegInfo &info, const uint8_t *p, size_t len)
+    {
+        uint8_t n = p[0];
+        if (info.kind == JpegKind::INVALID || n < 1 || n > info.componentCount || len != 4 + 2 * (size_t)n)
+            return false;
+        info.scanCount = n;
+        for (int i = 0; i < n; i++)
+        {
+            JpegInfo::ScanComponent &s = info.scan[i];
+            s.id = p[1 + i * 2];
+            s.dcTable = p[2 + i * 2] >> 4;
+            s.acTable = p[2 + i * 2] & 0x0F;
+            if (s.dcTable > 3 || s.acTable > 3)
+                return false;
+
+            // Must be a frame component
+            int k = 0;
+            while (k < info.componentCount && info.components[k].id != s.id)
+                k++;
+            if (k == info.componentCount)
+                return false;
+        }
+        info.spectralStart = p[1 + n * 2];
+        info.spectralEnd = p[2 + n * 2];
+        info.approxHigh = p[3 + n * 2] >> 4;
+        info.approxLow = p[3 + n * 2] & 0x0F;
+        return true;
+    }
+
+    // Parse segments from pos up to the end of the next SOS segment (or,
+    // between scans, an EOI)
+    static JpegInfo &parseSegments(JpegInfo &info, const uint8_t *data, size_t len, size_t pos, bool betweenScans)
+    {
+        while (true)
+        {
+            // Marker, after any fill bytes
+            if (pos + 2 > len)
+                return truncated(info, pos + 2);
             if (data[pos] != 0xFF)
+                return invalid(info);
+            uint8_t marker = data[pos + 1];
+            if (marker == 0xFF)
             {
                 ++pos;
                 continue;
             }
-            // Skip any padding 0xFF bytes
-            while (data[pos] == 0xFF)
-                ++pos;
-            // Read the marker type
-            uint8_t marker = data[pos++];
 
-            // Restart markers (0xD0-0xD7), SOI (0xD8), and EOI (0xD9) have no data payload
-            if (marker == 0xD8 || marker == 0xD9 ||
-                (marker >= 0xD0 && marker <= 0xD7))
+            // Markers without a segment
+            if (marker == EOI && betweenScans)
+            {
+                info.scanCount = 0;
+                info.scanOffset = pos + 2;
+                info.status = DecodeResult::OK;
+                return info;
+            }
+            if (marker == SOI || marker == EOI)
+                return invalid(info);
+            if (marker == TEM || (marker >= RST0 && marker <= RST7))
+            {
+                pos += 2;
                 continue;
+            }
 
-            // Ensure there are at least two bytes for the segment length
-            if (pos + 1 >= len)
-                return JpegKind::INVALID;
-            // Read segment length (big-endian), includes the two length bytes
-            uint16_t segLen = (data[pos] << 8) | data[pos + 1];
-            // Segment length must be at least 2 and fit in the buffer
-            if (segLen < 2 || pos + segLen > len)
-                return JpegKind::INVALID;
-            // Move past the length bytes
-            pos += 2;
-
-            // Check for specific markers that indicate JPEG type
-            if (marker == 0xC0)
-                return JpegKind::BASELINE; // Baseline DCT
-            if (marker == 0xC2)
-                return JpegKind::PROGRESSIVE; // Progressive DCT
-            if ((marker >= 0xC1 && marker <= 0xCF) &&
-                marker != 0xC0 && marker != 0xC2)
-                return JpegKind::OTHER; // Other JPEG format
-
-            // Skip over this segment's payload
-            pos += segLen - 2;
-        }
-
-        // If no valid type marker was found, return INVALID
-        return JpegKind::INVALID;
+            // Whole segment, length included
+            if (pos + 4 > len)
+                return truncated(info, pos + 4);
+            size_t segLen = word(data + pos + 2);
+            size_t body = pos + 4;
+            size_t end = pos + 2 + segLen;
+            if (segLen < 2)
+                return invalid(info);
+            if (end > len)
+                return truncated(info, end);
+
+            bool ok = true;
+            if (marker >= SOF0 && marker <= SOF15 && marker != DHT && marker != JPG && marker != DAC)
+            {
+                if (betweenScans)
+                    return invalid(info);
+                ok = parseFrame(info, data + body, end - body);
+                // Extended sequential decodes like baseline
+                info.kind = marker <= SOF1 ? JpegKind::BASELINE : marker == SOF2 ? JpegKind::PROGRESSIVE : JpegKind::OTHER;
+            }
+            else if (marker == DQT)
+                ok = parseQuantTables(info, body, data, end);
+            else if (marker == DHT)
+                ok = parseHuffmanTables(info, body, data, end);
+            else if (marker == DRI)
+            {
+                ok = segLen == 4;
+                if (ok)
+                    info.restartInterval = word(data + body);
+            }
+            else if (marker == SOS)
+            {
+                if (segLen < 3 || !parseScan(info, data + body, end - body))
+                    return invalid(info);
+                info.scanOffset = end;
+                info.status = DecodeResult::OK;
+                return info;
+            }
+            // APPn, COM, DAC, DNL, ... carry nothing we need
+            if (!ok)
+                return invalid(info);
+            pos = end;
+        }
+    }
+
+    // Parse JPEG headers up to the end of the first SOS segment
+    JpegInfo parseHeader(const uint8_t *data, size_t len)
+    {
+        JpegInfo info;
+        if (len < 2)
+            return truncated(info, 2);
+        if (data[0] != 0xFF || data[1] != SOI)
+            return invalid(info);
+
+        parseSegments(info, data, len, 2, false);
+
+        // The first scan's components need their quantization tables
+        for (int i = 0; info.status == DecodeResult::OK && i < info.scanCount; i++)
+        {
+            int k = 0;
+            while (info.components[k].id != info.scan[i].id)
+                k++;
+            if (!info.quant[info.components[k].quant].offset)
+                return invalid(info);
+        }
+        return info;
+    }
+
+    // Parse the markers between two scans of a progressive JPEG
+    JpegInfo parseNextScan(const JpegInfo &previous, const uint8_t *data, size_t len)
+    {
+        // Same frame; only what follows is recorded
+        JpegInfo info;
+        info.kind = previous.kind;
+        info.precision = previous.precision;
+        info.width = previous.width;
+        info.height = previous.height;
+        info.componentCount = previous.componentCount;
+        memcpy(info.components, previous.components, sizeof(info.components));
+        info.restartInterval = previous.restartInterval;
+        return parseSegments(info, data, len, 0, true);
+    }
+
+    // Human readable name for a JpegKind
+    const char *kindName(JpegKind kind)
+    {
+        switch (kind)
+        {
+        case JpegKind::BASELINE:
+            return "baseline";
+        case JpegKind::PROGRESSIVE:
+            return "progressive";
+        case JpegKind::OTHER:
+            return "lossless/arithmetic";
+        default:
+            return "invalid";
+        }
+    }
+
+    // Index the RSTn markers in entropy-coded scan data
+    std::vector<size_t> restartOffsets(const uint8_t *data, size_t len, size_t max)
+    {
+        std::vector<size_t> offsets;
+        size_t pos = 0;
+        while (offsets.size() < max)
+        {
+            // Entropy-coded bytes never contain 0xFF except as 0xFF00
+            const uint8_t *ff = static_cast<const uint8_t *>(memchr(data + pos, 0xFF, len - pos));
+            if (!ff)
+                break;
+            pos = ff - data + 1;
+            // Skip any fill bytes
+            while (pos < len && data[pos] == 0xFF)
+                ++pos;
+            if (pos == len)
+                break;
+            uint8_t marker = data[pos++];
+            if (marker == 0x00)
+                continue; // Stuffed 0xFF
+            if (marker < 0xD0 || marker > 0xD7)
+                break; // End of the scan
+            offsets.push_back(pos);
+        }
+        return offsets;
     }
 }
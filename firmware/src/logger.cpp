@@ -5,6 +5,7 @@
 #include <Inkplate.h>
 #include "time_utils.h"
 #include "definitions.h"
+#include "framebuffer.h"
 
 #ifdef ARDUINO_INKPLATE10V2
 #include "images/logo.h"
@@ -58,7 +59,8 @@ namespace Logger
     // Waits until all log messages are sent or timeout occurs
     void waitForFlush(unsigned long timeoutMs)
     {
-        if (!mqttClient)
+        // Nothing will drain the queue without a connection
+        if (!mqttClient || !mqttClient->connected())
             return;
 
         unsigned long start = millis();
@@ -168,7 +170,7 @@ namespace Logger
             display->drawBitmap(
                 ((isPortrait ? E_INK_WIDTH : E_INK_HEIGHT) - logo_w) / 2,
                 ((isPortrait ? E_INK_HEIGHT : E_INK_WIDTH) - logo_h) / 2,
-                logo_img, logo_w, logo_h, 0);
+                logo_img, logo_w, logo_h, framebuffer::color(*display, 0));
         }
 
         // For Inkplate Color, adjust Y if needed so text is properly centered
@@ -179,7 +181,7 @@ namespace Logger
 
         // Set font and text properties
         display->setFont();
-        display->setTextColor(0, 7);
+        display->setTextColor(framebuffer::color(*display, 0), framebuffer::color(*display, 7));
         display->setTextSize(TEXT_SIZE);
         display->setCursor(8, textY);
         display->print(buffer);
@@ -17,9 +17,12 @@
 
 #include "battery.h"
 #include "definitions.h"
-#include "fonts/FreeSansBoldOblique24pt7b.h"
+#include "dither.h"
+#include "frame_store.h"
+#include "https_session.h"
 #include "logger.h"
 #include "networking.h"
+#include "screen_state.h"
 #include "time_utils.h"
 
 #ifdef ARDUINO_INKPLATE10V2
@@ -44,6 +47,7 @@ const char *deepSleepStartTime = "7:30am";
 // Use an RTC variable to see if initial boot has been done
 RTC_DATA_ATTR bool hideSplashScreen = false;
 RTC_DATA_ATTR char nextWakeTime[10] = {0};
+RTC_DATA_ATTR time_t nextWakeEpoch = 0;
 
 // Draw battery percentage + render screen
 void draw(const bool render = true,
@@ -58,9 +62,28 @@ void draw(const bool render = true,
 
   if (render) {
     display.display();
+    ScreenState::refreshed();
   }
 }
 
+// Next scheduled wake strictly after the given time
+WakeEntry nextWake(time_t after, const JsonVariant &jsonRenderer) {
+  JsonObject wakesObj = jsonRenderer["wakes"];
+  std::map<String, String> wakesMap;
+  for (JsonPair kv : wakesObj) {
+    wakesMap[kv.key().c_str()] = kv.value().as<const char *>();
+  }
+
+  String sleepStart = jsonRenderer["sleepwindow"]["start"] | "";
+  String sleepStop = jsonRenderer["sleepwindow"]["stop"] | "";
+  String defaultEndpoint =
+      jsonRenderer["default"] | "/render/unsplash,wallhaven";
+  String intervalStr = jsonRenderer["wake-interval"] | "";
+
+  return calculateNextWake(after, sleepStart, sleepStop, wakesMap,
+                           defaultEndpoint, intervalStr);
+}
+
 // Enter deep sleep mode
 void deepSleep(const bool render = true,
                const JsonVariant &jsonRenderer = config["renderer"]) {
@@ -71,24 +94,12 @@ void deepSleep(const bool render = true,
   delay(1000);
   esp_sleep_enable_ext0_wakeup(GPIO_NUM_36, LOW);
 
+  nextWakeEpoch = 0;
   if (display.rtcIsSet() && jsonRenderer.is<JsonObject>()) {
-    JsonObject wakesObj = jsonRenderer["wakes"];
-    std::map<String, String> wakesMap;
-    for (JsonPair kv : wakesObj) {
-      wakesMap[kv.key().c_str()] = kv.value().as<const char *>();
-    }
-
-    String sleepStart = jsonRenderer["sleepwindow"]["start"] | "";
-    String sleepStop = jsonRenderer["sleepwindow"]["stop"] | "";
-    String defaultEndpoint =
-        jsonRenderer["default"] | "/render/unsplash,wallhaven";
-    String intervalStr = jsonRenderer["wake-interval"] | "";
-
-    WakeEntry wake =
-        calculateNextWake(display.rtcGetEpoch(), sleepStart, sleepStop,
-                          wakesMap, defaultEndpoint, intervalStr);
+    WakeEntry wake = nextWake(display.rtcGetEpoch(), jsonRenderer);
     strncpy(nextWakeTime, wake.time.c_str(), sizeof(nextWakeTime) - 1);
     nextWakeTime[sizeof(nextWakeTime) - 1] = '\0';
+    nextWakeEpoch = wake.epoch;
 
     display.rtcSetAlarmEpoch(wake.epoch, RTC_ALARM_MATCH_DHHMMSS);
 
@@ -103,6 +114,7 @@ void deepSleep(const bool render = true,
 
   delay(1000);
   Logger::cleanup(5000);
+  apiSession.close();
   WiFi.disconnect();
   WiFi.mode(WIFI_OFF);
 
@@ -160,6 +172,7 @@ void setup() {
           display.setTextSize(4);
           display.setCursor(20, 90);
           display.println(">> WIFI Setup <<");
+          ScreenState::invalidate();
           display.display();
 
           bootMode = MODE_WIFI_SETUP;
@@ -176,6 +189,7 @@ void setup() {
           display.setCursor(20, 130);
           display.setTextSize(2);
           display.println("(OTA Updater)");
+          ScreenState::invalidate();
           display.display();
 
           bootMode = MODE_MAINTENANCE;
@@ -303,6 +317,18 @@ void setup() {
                  battRemaining);
   }
 
+  // Radio-free wake: show the frame a bundle stored for this wake, if any
+  if (wakeup_reason != ESP_SLEEP_WAKEUP_EXT0 && display.rtcIsSet() &&
+      FrameStore::has(nextWakeEpoch)) {
+    restoreTimezone();
+    dither::Tone tone = dither::parseTone(config["renderer"]["tone"] | "",
+                                          dither::panelTone());
+    if (FrameStore::show(display, nextWakeEpoch, tone) == ESP_OK) {
+      deepSleep(true, config["renderer"]);
+      return;
+    }
+  }
+
   // Verify API URL
   const char *api = config["api"].as<const char *>();
   if (!api || strlen(api) == 0) {
@@ -336,9 +362,25 @@ void setup() {
     Logger::log(Logger::LOG_INFO, "NTP disabled; using hourly fallback.");
   }
 
+  // Determine endpoint
+  const char *endpoint =
+      (wakeup_reason == ESP_SLEEP_WAKEUP_EXT0 &&
+       config["renderer"]["button"].as<const char *>())
+          ? config["renderer"]["button"]
+                .as<const char *>() // Render wake buton endpoint
+          : (strlen(nextWakeTime) > 0
+                 ? config["renderer"]["wakes"][nextWakeTime]
+                       .as<const char *>() // Render last wake endpoint
+                 : config["renderer"]["default"]
+                       .as<const char *>()); // Render default endpoint
+
   // If rendere.standby is set to true, display the loading image before pulling
-  // the image from the renderer.
-  if (config["renderer"]["cleardisplay"]) {
+  // the image from the renderer. Skipped when the panel already shows this
+  // endpoint's image, which the server may tell us is still current.
+  String etag, lastModified;
+  bool revalidate = (config["renderer"]["conditional"] | true) &&
+                    ScreenState::validators(endpoint, etag, lastModified);
+  if (config["renderer"]["cleardisplay"] && !revalidate) {
     const char *psb = "Please Stand By";
     display.clearDisplay();
 #ifdef ARDUINO_INKPLATE10V2
@@ -381,17 +423,6 @@ void setup() {
   // we don't want to block the displayed content unless the battery is low.
   showBattery = false;
 
-  // Determine endpoint
-  const char *endpoint =
-      (wakeup_reason == ESP_SLEEP_WAKEUP_EXT0 &&
-       config["renderer"]["button"].as<const char *>())
-          ? config["renderer"]["button"]
-                .as<const char *>() // Render wake buton endpoint
-          : (strlen(nextWakeTime) > 0
-                 ? config["renderer"]["wakes"][nextWakeTime]
-                       .as<const char *>() // Render last wake endpoint
-                 : config["renderer"]["default"]
-                       .as<const char *>()); // Render default endpoint
   if (endpoint == nullptr) {
     delay(5000); // WARN: Don't burn out the screen!
     Logger::onScreen(Logger::LOG_CRITICAL, true, 2, rotation,
@@ -401,8 +432,34 @@ void setup() {
   }
 
   // Fetch and render image
-  if (DisplayImage(display, rotation, api, config["renderer"].as<JsonVariant>(),
-                   endpoint) != ESP_OK) {
+  esp_err_t res = DisplayImage(display, rotation, api,
+                               config["renderer"].as<JsonVariant>(), endpoint);
+
+  // Bundle mode: while the radio is up, fetch the frames for the next wakes
+  // so they can be shown without it
+  int bundleFrames = config["renderer"]["bundle"] | 0;
+  if (bundleFrames > 0 && display.rtcIsSet() &&
+      (res == ESP_OK || res == IMAGE_UNCHANGED)) {
+    // Follow the same schedule deepSleep() will
+    std::vector<WakeEntry> wakes;
+    time_t after = display.rtcGetEpoch();
+    for (int i = 0; i < bundleFrames && i < 255; i++) {
+      wakes.push_back(nextWake(after, config["renderer"]));
+      after = wakes.back().epoch;
+    }
+    if (FetchFrameBundle(rotation, api, config["renderer"].as<JsonVariant>(),
+                         wakes) != ESP_OK)
+      Logger::log(Logger::LOG_ERROR, "Bundle fetch failed.");
+  }
+
+  if (res == IMAGE_UNCHANGED) {
+    // The panel already shows it; sleep without a refresh
+    Logger::logf(Logger::LOG_INFO, "Refresh skipped (%u since power-on).",
+                 ScreenState::refreshSkipped());
+    deepSleep(false, config["renderer"]);
+    return;
+  }
+  if (res != ESP_OK) {
     Logger::onScreen(Logger::LOG_ERROR, true, 2, rotation,
                      "Image fetch/render failed!");
   }
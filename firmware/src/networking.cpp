@@ -10,23 +10,35 @@
 #include <WiFiClient.h>
 #include <WiFiClientSecure.h>
 #include <WiFiManager.h>
+#include <esp32/rom/crc.h>
 #include <esp_err.h>
 #include <esp_partition.h>
 #include <qrcode.h>
 #include <vector>
 
 #include "definitions.h"
-#include "jpeg_utils.h"
+#include "display_list.h"
+#include "download_buffer.h"
+#include "frame_store.h"
+#include "framebuffer.h"
+#include "http_stream.h"
+#include "https_session.h"
+#include "jpeg_stream.h"
 #include "logger.h"
 #include "networking.h"
 #include "ota_html.h"
+#include "packed_frame.h"
+#include "qoi_stream.h"
+#include "screen_state.h"
 #include "urlparser.h"
 
 // headers to collect from the HTTP response
 const char *displayHeaders[] = {
     "Content-Type",     "Content-Length",   "Transfer-Encoding",
     "X-Image-Source",   "X-No-Dithering",   "X-Inky-Message-0",
-    "X-Inky-Message-1", "X-Inky-Message-2",
+    "X-Inky-Message-1", "X-Inky-Message-2", "ETag",
+    "Last-Modified",    "X-Inky-Frame",     "X-Inky-Dither",
+    "X-Inky-Tone",      "X-Inky-Mode",      "X-Bundle-Stopped",
 };
 
 // Global network clients
@@ -124,6 +136,7 @@ void configModeCallback(WiFiManager *myWiFiManager) {
   _apDisplay->printf("URL: %s\n", ipURL.c_str());
 
   // Update the screen
+  ScreenState::invalidate();
   _apDisplay->display();
 }
 
@@ -220,101 +233,51 @@ esp_err_t MqttConnect(const JsonVariant &mqttConfig) {
   return mqttClient.connected() ? ESP_OK : ESP_ERR_TIMEOUT;
 }
 
-// Reads data from a WiFi stream into a byte vector, handling chunked transfer
-// encoding
-std::vector<uint8_t> readStream(WiFiClient &stream, unsigned long timeoutMillis,
-                                bool isChunked, size_t contentLength) {
-  std::vector<uint8_t> out;
-  unsigned long start = millis();
-  unsigned long deadline = start + timeoutMillis;
-
-  // Reserve memory if size is known to avoid reallocations
-  if (!isChunked && contentLength > 0) {
-    out.reserve(contentLength);
+// Content hash of what a response puts on the panel: the body CRC plus the
+// headers and the configured tone that change how it is drawn
+static uint32_t frameHash(HTTPClient &https, uint32_t bodyCrc,
+                          const dither::Tone &tone) {
+  static const char *drawHeaders[] = {
+      "X-No-Dithering",   "X-Inky-Dither",    "X-Inky-Tone",
+      "X-Inky-Mode",      "X-Inky-Message-0", "X-Inky-Message-1",
+      "X-Inky-Message-2"};
+  String toneSpec = dither::formatTone(tone);
+  uint32_t hash =
+      crc32_le(bodyCrc, reinterpret_cast<const uint8_t *>(toneSpec.c_str()),
+               toneSpec.length());
+  for (const char *name : drawHeaders) {
+    String value = https.header(name);
+    hash = crc32_le(hash, reinterpret_cast<const uint8_t *>(value.c_str()),
+                    value.length() + 1);
   }
+  return hash;
+}
 
-  // Buffer for reading data
-  constexpr size_t BUF_SIZE = 256;
-  uint8_t buf[BUF_SIZE];
-
-  // Read loop
-  while (millis() < deadline) {
-    // Check availability
-    if (stream.available() <= 0) {
-      if (!stream.connected())
-        break;
-      delay(5);
-      continue;
-    }
-
-    // Handle standard (non-chunked) transfer
-    if (!isChunked) {
-      // Determine how much to read
-      size_t want = (contentLength > 0)
-                        ? min<size_t>({BUF_SIZE, (size_t)stream.available(),
-                                       contentLength - out.size()})
-                        : min<size_t>(BUF_SIZE, (size_t)stream.available());
-
-      // Read data and append to output vector
-      int n = stream.readBytes(buf, want);
-      if (n > 0) {
-        out.insert(out.end(), buf, buf + n);
-        // Reset timeout on successful read
-        deadline = millis() + timeoutMillis;
-      }
-
-      // Stop if we have read the expected length
-      if (contentLength > 0 && out.size() >= contentLength)
-        break;
-    }
-    // Handle chunked transfer
-    else {
-      // Buffer for reading the hex-size line
-      constexpr size_t LINE_BUF = 32;
-      char line[LINE_BUF];
-
-      // Read chunk-size line (up to '\n')
-      int len = stream.readBytesUntil('\n', (uint8_t *)line, LINE_BUF - 1);
-      if (len <= 0)
-        break;
-      line[len] = '\0';
-
-      // Strip any trailing '\r'
-      if (char *cr = strchr(line, '\r'))
-        *cr = '\0';
-
-      // Parse hex length from the line
-      size_t chunkSize = strtoul(line, nullptr, 16);
-      // Size 0 indicates end of chunks
-      if (chunkSize == 0)
-        break;
-
-      size_t remaining = chunkSize;
-      // Read the chunk data
-      while (remaining && millis() < deadline) {
-        size_t toRead = min<size_t>(remaining, BUF_SIZE);
-        int n = stream.readBytes(buf, toRead);
-        if (n <= 0)
-          break;
-
-        out.insert(out.end(), buf, buf + n);
-        remaining -= n;
-        deadline = millis() + timeoutMillis;
-      }
-
-      // Consume the trailing CRLF after the chunk data
-      if (stream.available() >= 2) {
-        char discard[2];
-        stream.readBytes((uint8_t *)discard, 2);
-      } else {
-        stream.readBytesUntil('\n', (uint8_t *)line, LINE_BUF - 1);
-      }
-    }
+// Dithering a response asks for; the server can pick one per image
+static dither::Mode renderMode(HTTPClient &https) {
+  dither::Mode mode = dither::defaultMode();
+  if (https.hasHeader("X-Inky-Dither"))
+    mode = dither::parse(https.header("X-Inky-Dither").c_str(), mode);
+  if (https.hasHeader("X-No-Dithering") &&
+      https.header("X-No-Dithering") == "true") {
+    mode = dither::Mode::NONE;
   }
-  return out;
+  Logger::logf(Logger::LOG_DEBUG, "Dithering: %s", dither::name(mode));
+  return mode;
+}
+
+// Tone curve a response asks for, or the configured one
+static dither::Tone renderTone(HTTPClient &https, const dither::Tone &tone) {
+  dither::Tone drawTone = tone;
+  if (https.hasHeader("X-Inky-Tone"))
+    drawTone = dither::parseTone(https.header("X-Inky-Tone").c_str(), tone);
+  Logger::logf(Logger::LOG_DEBUG, "Tone: %s",
+               dither::formatTone(drawTone).c_str());
+  return drawTone;
 }
 
-// Fetches a JPEG image from a URL and renders it to the Inkplate
+// Fetches an image (JPEG, QOI or packed frame) from a URL and renders it to
+// the Inkplate
 esp_err_t DisplayImage(Inkplate &display, int rotation, const char *api,
                        const JsonVariant &imageConfig, const char *endpoint) {
   // Validate inputs
@@ -329,6 +292,16 @@ esp_err_t DisplayImage(Inkplate &display, int rotation, const char *api,
   bool isPortrait = (rotation % 2 == 0);
   int retries = imageConfig["retries"] | 3;
   int timeout = imageConfig["timeout"] | 30;
+  size_t bufferSize = imageConfig["buffersize"] | DOWNLOAD_BUFFER_SIZE;
+  bool conditional = imageConfig["conditional"] | true;
+  bool framebuffer = imageConfig["framebuffer"] | true;
+  bool delta = framebuffer && (imageConfig["delta"] | true);
+  bool qoi = imageConfig["qoi"] | true;
+  bool displayList = imageConfig["displaylist"] | true;
+
+  // Panel calibration; a render can override it with X-Inky-Tone
+  dither::Tone tone =
+      dither::parseTone(imageConfig["tone"] | "", dither::panelTone());
 
   // Construct the full URL
   URLParser::Parser parsed(api);
@@ -342,13 +315,19 @@ esp_err_t DisplayImage(Inkplate &display, int rotation, const char *api,
   Logger::logf(Logger::LOG_DEBUG, "Fetching image: %s",
                parsed.getURL(true).c_str());
 
-  // Setup HTTP client
-  WiFiClientSecure client;
-  client.setInsecure();
-  HTTPClient https;
+  // Use the shared keep-alive session; the TLS connection opened by earlier
+  // requests (e.g. the timezone lookup) carries over, as it does across retries
+  HTTPClient &https = apiSession.http();
   https.setUserAgent(userAgent);
-  https.getStream().setNoDelay(true);
-  https.getStream().setTimeout(15000); // Stream timeout
+
+  // One download region for the whole wake, shared by every attempt
+  DownloadBuffer download;
+
+  // If the panel still shows this endpoint's image, let the server answer
+  // 304 instead of sending it again
+  String etag, lastModified;
+  bool revalidate =
+      conditional && ScreenState::validators(endpoint, etag, lastModified);
 
   // Retry loop for fetching image
   for (int i = 1; i <= retries; i++) {
@@ -358,7 +337,7 @@ esp_err_t DisplayImage(Inkplate &display, int rotation, const char *api,
     Logger::logf(Logger::LOG_DEBUG, "Attempt %d/%d...", i, retries);
 
     // Start connection
-    if (https.begin(client, parsed.getURL())) {
+    if (apiSession.begin(parsed)) {
       https.setTimeout(timeout * 1000);
 
       // Set Authorization Headers if needed
@@ -367,11 +346,52 @@ esp_err_t DisplayImage(Inkplate &display, int rotation, const char *api,
         https.addHeader("Authorization", "Basic " + basicAuth.encode());
       }
 
+      // Conditional request against the image on the panel
+      if (revalidate) {
+        if (etag.length() > 0)
+          https.addHeader("If-None-Match", etag);
+        if (lastModified.length() > 0)
+          https.addHeader("If-Modified-Since", lastModified);
+      }
+
+      // Offer to take a pre-dithered frame in the panel's own layout instead
+      // of a JPEG; servers that don't know the header ignore it. With a base
+      // frame in flash, only the tiles that differ from it are needed.
+      const char *base = delta ? FrameStore::baseId() : nullptr;
+      if (framebuffer) {
+        https.addHeader("X-Inky-Framebuffer",
+                        packed_frame::acceptHeader(rotation, delta));
+      }
+      if (base)
+        https.addHeader("X-Inky-Base", base);
+
+      // Text-heavy renders can come as a display list to draw here, browser
+      // renders (text, flat colors) as lossless QOI
+      if (displayList || qoi) {
+        String accept = displayList ? display_list::CONTENT_TYPE : "";
+        if (qoi)
+          accept += String(displayList ? ", " : "") + qoi_stream::CONTENT_TYPE;
+        https.addHeader("Accept", accept + ", image/jpeg;q=0.9");
+      }
+
+      // The packer dithers for us, so it needs our tone curve too
+      if (framebuffer && !dither::sameTone(tone, dither::Tone()))
+        https.addHeader("X-Inky-Tone", dither::formatTone(tone));
+
       // Collect custom headers
       https.collectHeaders(displayHeaders,
                            sizeof(displayHeaders) / sizeof(displayHeaders[0]));
 
       int code = https.GET();
+
+      // Unchanged: no body, nothing to decode and nothing to refresh
+      if (code == HTTP_CODE_NOT_MODIFIED && revalidate) {
+        apiSession.end();
+        Logger::log(Logger::LOG_INFO,
+                    "Image not modified; keeping the current screen.");
+        return IMAGE_UNCHANGED;
+      }
+
       // Check for successful response
       if (code == HTTP_CODE_OK) {
         // Log Source if provided in headers
@@ -382,10 +402,16 @@ esp_err_t DisplayImage(Inkplate &display, int rotation, const char *api,
 
         // Validate Content-Type
         String contentType = https.header("Content-Type");
-        if (contentType != "image/jpeg" && contentType != "image/jpg") {
+        bool packed = framebuffer && contentType == packed_frame::CONTENT_TYPE;
+        bool tiles = base && contentType == packed_frame::DELTA_CONTENT_TYPE;
+        bool lossless = qoi && contentType == qoi_stream::CONTENT_TYPE;
+        bool commands =
+            displayList && contentType == display_list::CONTENT_TYPE;
+        if (!packed && !tiles && !lossless && !commands &&
+            contentType != "image/jpeg" && contentType != "image/jpg") {
           Logger::logf(Logger::LOG_ERROR, "Invalid content type: %s",
                        contentType.c_str());
-          https.end();
+          apiSession.end(false);
           continue;
         }
 
@@ -399,60 +425,185 @@ esp_err_t DisplayImage(Inkplate &display, int rotation, const char *api,
           len = atoi(https.header("Content-Length").c_str());
         }
 
-        // Check for sensible size limits to prevent buffer overflow
-        if (len > (E_INK_WIDTH * E_INK_HEIGHT * 8 + 100)) {
-          Logger::log(Logger::LOG_ERROR, "Content too large");
-          https.end();
+        // Size the download region from Content-Length (or the cap)
+        if (!download.reserve(len > 0 ? len : 0, bufferSize)) {
+          Logger::log(Logger::LOG_ERROR, "No memory for download buffer");
+          apiSession.end(false);
           continue;
         }
 
+        // Black and white renders (X-Inky-Mode: 1bit) are drawn in the
+        // panel's 1-bit mode; packed frames are laid out for 3-bit gray
+        bool bilevel = https.header("X-Inky-Mode") == "1bit";
+        framebuffer::setBilevel(display, bilevel && !packed && !tiles);
+        if (framebuffer::bilevel(display))
+          Logger::log(Logger::LOG_DEBUG, "Panel mode: 1-bit");
+
         // Get the network stream
         WiFiClient *stream = https.getStreamPtr();
         if (stream) {
-          // Read data into buffer
-          std::vector<uint8_t> buffer =
-              readStream(*stream, 1500, isChunked, len);
-          https.end();
-
-          if (!buffer.empty()) {
-            // Render Image to Display
-            display.clearDisplay();
-            // Check if JPEG is compatible (baseline)
-            if (!jpeg_utils::isBaseline(buffer.data(), buffer.size())) {
-              Logger::log(Logger::LOG_ERROR, "JPEG not baseline");
-              return ESP_ERR_INVALID_RESPONSE;
+          // Fetch on the other core while this task decodes; only the
+          // headers are parsed before the display is touched
+          HttpBodyStream body(*stream, 1500, isChunked, len > 0 ? len : 0);
+          download.begin(body);
+          download.startProducer();
+          DecodeResult res;
+          if (tiles) {
+            // Changed tiles only: start from the base frame they apply to
+            Logger::logf(Logger::LOG_DEBUG, "Delta frame on %s, %d bytes%s",
+                         base, len, isChunked ? " (chunked)" : "");
+            res = FrameStore::drawBase(display);
+            if (res == DecodeResult::OK)
+              res = packed_frame::drawDelta(display, download);
+          } else if (packed && delta && https.hasHeader("X-Inky-Frame")) {
+            // A full frame the server can diff later ones against; keep a
+            // copy as it is inflated
+            Logger::logf(Logger::LOG_DEBUG, "Packed frame %s, %d bytes%s",
+                         https.header("X-Inky-Frame").c_str(), len,
+                         isChunked ? " (chunked)" : "");
+            FrameStore::BaseRecorder recorder(
+                download, https.header("X-Inky-Frame"), len > 0 ? len : 0);
+            res = packed_frame::draw(display, recorder);
+            if (res == DecodeResult::OK)
+              recorder.commit();
+          } else if (packed) {
+            // Already dithered and laid out for the panel: inflate it
+            // straight into the framebuffer
+            Logger::logf(Logger::LOG_DEBUG, "Packed frame, %d bytes%s", len,
+                         isChunked ? " (chunked)" : "");
+            res = packed_frame::draw(display, download);
+          } else if (commands) {
+            // Text and shapes, drawn with our own fonts
+            Logger::logf(Logger::LOG_DEBUG, "Display list, %d bytes%s", len,
+                         isChunked ? " (chunked)" : "");
+            res = display_list::draw(display, download);
+          } else if (lossless) {
+            qoi_stream::Decoder decoder;
+            res = decoder.prepare(download);
+            if (res == DecodeResult::OK) {
+              Logger::logf(Logger::LOG_DEBUG,
+                           "QOI %ux%u, %u channels, %d bytes%s",
+                           decoder.width(), decoder.height(),
+                           decoder.channels(), len,
+                           isChunked ? " (chunked)" : "");
+              dither::Mode mode = renderMode(https);
+              dither::Tone drawTone = renderTone(https, tone);
+              res = decoder.draw(display, 0, 0, mode, drawTone);
+            }
+          } else {
+            jpeg_stream::Decoder decoder;
+            res = decoder.prepare(download);
+            const jpeg_utils::JpegInfo &info = decoder.header();
+
+            // Rejected from its headers alone (as soon as the frame header
+            // is in), the screen is left as it is and the rest of the body
+            // is never downloaded
+            if (res == DecodeResult::UNSUPPORTED &&
+                info.status == DecodeResult::INPUT &&
+                (info.kind == jpeg_utils::JpegKind::INVALID ||
+                 jpeg_decoder::Decoder::checkFrame(info) == DecodeResult::OK)) {
+              Logger::log(Logger::LOG_ERROR,
+                          "Unsupported JPEG: headers too large to buffer");
+            } else if (res == DecodeResult::UNSUPPORTED) {
+              Logger::logf(Logger::LOG_ERROR,
+                           "Unsupported JPEG: %s %ux%u, %u-bit, %u components "
+                           "(%ux%u sampling)",
+                           jpeg_utils::kindName(info.kind), info.width,
+                           info.height, info.precision, info.componentCount,
+                           info.components[0].h, info.components[0].v);
             }
 
-            // Determine dithering setting
-            int dither = static_cast<int>(DITHERING);
-            if (https.hasHeader("X-No-Dithering") &&
-                https.header("X-No-Dithering") == "true") {
-              dither = 0;
+            if (res == DecodeResult::OK) {
+              Logger::logf(Logger::LOG_DEBUG,
+                           "JPEG %ux%u %s, %u components (%ux%u sampling), "
+                           "restart interval %u, %d bytes%s",
+                           info.width, info.height,
+                           jpeg_utils::kindName(info.kind), info.componentCount,
+                           info.components[0].h, info.components[0].v,
+                           info.restartInterval, len,
+                           isChunked ? " (chunked)" : "");
+
+              dither::Mode mode = renderMode(https);
+              dither::Tone drawTone = renderTone(https, tone);
+
+              // Render Image to Display while the rest of the body arrives;
+              // the display is only cleared once the decoder is set to draw
+              res = decoder.draw(display, 0, 0, mode, drawTone);
+
+              // Progressive images are held whole until their last scan;
+              // one that doesn't fit won't fit on a retry either
+              if (res == DecodeResult::MEMORY &&
+                  info.kind == jpeg_utils::JpegKind::PROGRESSIVE) {
+                Logger::logf(Logger::LOG_ERROR,
+                             "Progressive JPEG %ux%u too large to buffer",
+                             info.width, info.height);
+                res = DecodeResult::UNSUPPORTED;
+              }
             }
+          }
 
-            // Draw the JPEG
-            if (display.drawJpegFromBuffer(buffer.data(), buffer.size(), 0, 0,
-                                           dither, 0)) {
-              // Display header messages if present
-              for (int m = 0; m <= 2; m++) {
-                char h[20];
-                snprintf(h, sizeof(h), "X-Inky-Message-%d", m);
-                if (https.hasHeader(h)) {
-                  Logger::onScreen(Logger::LOG_INFO, false, m, rotation,
-                                   https.header(h).c_str());
-                }
+          // On success drain whatever follows the image (e.g. the final
+          // chunk) so the connection can be reused, then stop the fetch task
+          // before the connection is released
+          if (res == DecodeResult::OK)
+            download.skip(SIZE_MAX);
+          download.cancel();
+          apiSession.end(body.complete());
+
+          // Unsupported (e.g. arithmetic-coded) images will not get better on
+          // retry
+          if (res == DecodeResult::UNSUPPORTED) {
+            Logger::log(Logger::LOG_ERROR, "Image not supported; giving up");
+            return ESP_ERR_INVALID_RESPONSE;
+          }
+
+          if (res == DecodeResult::OK) {
+            DownloadBuffer::Stats st = download.stats();
+            uint32_t elapsedMs =
+                max<uint32_t>((st.renderBusyUs + st.renderStallUs) / 1000, 1);
+            Logger::logf(Logger::LOG_DEBUG,
+                         "Streamed %u bytes in %u ms (%u B/s, %u reads, peak "
+                         "%u/%u buffered)",
+                         body.delivered(), elapsedMs,
+                         body.delivered() * 1000 / elapsedMs, download.reads(),
+                         download.highWater(), download.capacity());
+            Logger::logf(Logger::LOG_DEBUG,
+                         "Pipeline: fetch busy %u ms / stalled %u ms, render "
+                         "busy %u ms / starved %u ms",
+                         st.fetchBusyUs / 1000, st.fetchStallUs / 1000,
+                         st.renderBusyUs / 1000, st.renderStallUs / 1000);
+
+            // Byte-identical to what the panel shows: skip the refresh
+            uint32_t frame = frameHash(https, download.checksum(), tone);
+            if (body.complete() && ScreenState::showsFrame(frame)) {
+              Logger::logf(Logger::LOG_INFO,
+                           "Image identical to the one on screen (%08x).",
+                           frame);
+              return IMAGE_UNCHANGED;
+            }
+
+            // Display header messages if present
+            for (int m = 0; m <= 2; m++) {
+              char h[20];
+              snprintf(h, sizeof(h), "X-Inky-Message-%d", m);
+              if (https.hasHeader(h)) {
+                Logger::onScreen(Logger::LOG_INFO, false, m, rotation,
+                                 https.header(h).c_str());
               }
-              Logger::log(Logger::LOG_INFO, "Image rendered.");
-              return ESP_OK;
-            } else {
-              Logger::log(Logger::LOG_ERROR, "Render failed");
             }
+            // Remember what the panel will show for the next wake
+            ScreenState::imageDrawn(endpoint, https.header("ETag"),
+                                    https.header("Last-Modified"), frame);
+            Logger::log(Logger::LOG_INFO, "Image rendered.");
+            return ESP_OK;
           }
+          Logger::logf(Logger::LOG_ERROR, "Render failed: %s",
+                       decodeResultName(res));
         }
       } else {
         Logger::logf(Logger::LOG_ERROR, "HTTP Error: %d", code);
       }
-      https.end();
+      apiSession.end(false);
     }
     delay(1000);
   }
@@ -460,6 +611,95 @@ esp_err_t DisplayImage(Inkplate &display, int rotation, const char *api,
   return ESP_ERR_TIMEOUT;
 }
 
+// Fetches the frames for the given upcoming wakes in one request and stores
+// them in flash for radio-free wakes
+esp_err_t FetchFrameBundle(int rotation, const char *api,
+                           const JsonVariant &imageConfig,
+                           const std::vector<WakeEntry> &wakes) {
+  if (!imageConfig.is<JsonObject>() || !api || strlen(api) == 0)
+    return ESP_ERR_INVALID_ARG;
+  if (wakes.empty())
+    return ESP_OK;
+
+  const char *basepath = imageConfig["basepath"] | "/api/v1";
+  const char *userAgent = imageConfig["userAgent"] | USER_AGENT;
+  bool isPortrait = (rotation % 2 == 0);
+  int timeout = imageConfig["timeout"] | 30;
+
+  // Frames left from the previous bundle are stale; free their space first
+  FrameStore::clear();
+
+  URLParser::Parser parsed(api);
+  parsed.expandPath(basepath, "bundle");
+  parsed.setParam("w", String(isPortrait ? E_INK_WIDTH : E_INK_HEIGHT));
+  parsed.setParam("h", String(isPortrait ? E_INK_HEIGHT : E_INK_WIDTH));
+  parsed.setParam("mbh", String(MSG_BOX_HEIGHT));
+
+  // Ask for one frame per wake, within what flash can hold
+  JsonDocument request;
+  request["budget"] = FrameStore::freeBytes();
+  JsonArray frames = request["frames"].to<JsonArray>();
+  for (const WakeEntry &wake : wakes) {
+    JsonObject frame = frames.add<JsonObject>();
+    frame["at"] = static_cast<uint32_t>(wake.epoch);
+    frame["endpoint"] = wake.endpoint;
+  }
+  String payload;
+  serializeJson(request, payload);
+
+  Logger::logf(Logger::LOG_DEBUG, "Fetching bundle of %u frames: %s",
+               wakes.size(), parsed.getURL(true).c_str());
+
+  HTTPClient &https = apiSession.http();
+  https.setUserAgent(userAgent);
+  if (!apiSession.begin(parsed))
+    return ESP_FAIL;
+
+  // The server renders every frame before answering
+  https.setTimeout(timeout * 1000 * wakes.size());
+  URLParser::BasicAuth basicAuth = parsed.getBasicAuth();
+  if (basicAuth.exists()) {
+    https.addHeader("Authorization", "Basic " + basicAuth.encode());
+  }
+  https.addHeader("Content-Type", "application/json");
+  https.collectHeaders(displayHeaders,
+                       sizeof(displayHeaders) / sizeof(displayHeaders[0]));
+
+  int code = https.POST(payload);
+  if (code != HTTP_CODE_OK ||
+      https.header("Content-Type") != "application/x-inky-bundle") {
+    Logger::logf(Logger::LOG_ERROR, "Bundle request failed: %d (%s)", code,
+                 https.header("Content-Type").c_str());
+    apiSession.end(false);
+    return ESP_ERR_INVALID_RESPONSE;
+  }
+
+  int32_t len = https.getSize();
+  bool isChunked = (https.header("Transfer-Encoding").indexOf("chunked") >= 0);
+  WiFiClient *stream = https.getStreamPtr();
+  if (!stream) {
+    apiSession.end(false);
+    return ESP_FAIL;
+  }
+
+  // Why the server sent fewer frames than asked for, if it did
+  String stopped = https.header("X-Bundle-Stopped");
+
+  HttpBodyStream body(*stream, 1500, isChunked, len > 0 ? len : 0);
+  int stored = FrameStore::storeBundle(body);
+  body.skip(SIZE_MAX);
+  apiSession.end(body.complete());
+
+  // Every wake past the last stored frame turns the radio on again
+  if (stored >= 0 && stored < static_cast<int>(wakes.size())) {
+    Logger::logf(Logger::LOG_WARNING,
+                 "Bundle: only %d of %u frames stored (%s)", stored,
+                 wakes.size(),
+                 stopped.length() > 0 ? stopped.c_str() : "flash full");
+  }
+  return stored >= 0 ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+}
+
 // Starts the OTA web server and blocks execution until timeout or reboot
 void StartOTAServer(Inkplate &display, int rotation) {
   // 5-minute timeout to save battery if forgotten
@@ -496,6 +736,7 @@ void StartOTAServer(Inkplate &display, int rotation) {
   display.setCursor(xPos, yStart + qrSizePx + 50);
   display.printf("URL: %s", sURL.c_str());
 
+  ScreenState::invalidate();
   display.display();
 
   // Setup Server
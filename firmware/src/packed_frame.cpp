@@ -0,0 +1,168 @@
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <vector>
+
+#include "definitions.h"
+#include "packed_frame.h"
+
+namespace packed_frame
+{
+#ifdef ARDUINO_INKPLATECOLOR
+    static const char *FORMAT = "color7";
+#else
+    static const char *FORMAT = "gray3";
+#endif
+
+    // Delta container version
+    static constexpr uint8_t DELTA_VERSION = 1;
+
+    // Value of the X-Inky-Framebuffer request header
+    String acceptHeader(int rotation, bool delta)
+    {
+        String value = String(FORMAT) + "; " + E_INK_WIDTH + "x" + E_INK_HEIGHT + "; rotation=" + rotation +
+                       "; lz4; dither=" + (DITHERING ? 1 : 0);
+        if (delta)
+            value += "; delta";
+        return value;
+    }
+
+    // Size in bytes of the raw framebuffer
+    size_t frameSize()
+    {
+        return (size_t)E_INK_WIDTH * E_INK_HEIGHT / 2;
+    }
+
+    // Read one byte; false at the end of the input
+    static inline bool readByte(ByteSource &src, uint8_t &b)
+    {
+        return src.read(&b, 1) == 1;
+    }
+
+    // Read an LZ4 length extension (a run of 255s ended by a smaller byte)
+    static bool readLength(ByteSource &src, size_t &len)
+    {
+        uint8_t b;
+        do
+        {
+            if (!readByte(src, b))
+                return false;
+            len += b;
+        } while (b == 255);
+        return true;
+    }
+
+    // Decompress one LZ4 block of exactly size bytes from src into dst
+    static DecodeResult inflate(ByteSource &src, uint8_t *dst, size_t size)
+    {
+        size_t pos = 0;
+        while (pos < size)
+        {
+            uint8_t token;
+            if (!readByte(src, token))
+                return DecodeResult::INPUT;
+
+            // Literals, copied from the stream straight into place
+            size_t literals = token >> 4;
+            if (literals == 15 && !readLength(src, literals))
+                return DecodeResult::INPUT;
+            if (literals > size - pos)
+                return DecodeResult::INVALID;
+            if (src.read(dst + pos, literals) != literals)
+                return DecodeResult::INPUT;
+            pos += literals;
+
+            // The last sequence has no match
+            if (pos == size)
+                break;
+
+            uint8_t lo, hi;
+            if (!readByte(src, lo) || !readByte(src, hi))
+                return DecodeResult::INPUT;
+            size_t offset = lo | (hi << 8);
+            size_t match = (token & 0x0F) + 4;
+            if ((token & 0x0F) == 15 && !readLength(src, match))
+                return DecodeResult::INPUT;
+            if (offset == 0 || offset > pos || match > size - pos)
+                return DecodeResult::INVALID;
+
+            // Copy from the pixels already written; overlapping matches
+            // repeat a pattern and must go byte by byte
+            const uint8_t *from = dst + pos - offset;
+            if (offset >= match)
+                memcpy(dst + pos, from, match);
+            else
+                for (size_t i = 0; i < match; i++)
+                    dst[pos + i] = from[i];
+            pos += match;
+        }
+        return DecodeResult::OK;
+    }
+
+    // Decompress a packed frame from src straight into the framebuffer
+    DecodeResult draw(Inkplate &display, ByteSource &src)
+    {
+        if (!display.DMemory4Bit)
+            return DecodeResult::MEMORY;
+        return inflate(src, display.DMemory4Bit, frameSize());
+    }
+
+    // Apply a delta frame from src on top of the framebuffer
+    DecodeResult drawDelta(Inkplate &display, ByteSource &src)
+    {
+        uint8_t header[8];
+        if (src.read(header, sizeof(header)) != sizeof(header))
+            return DecodeResult::INPUT;
+        if (memcmp(header, "INKD", 4) != 0 || header[4] != DELTA_VERSION)
+            return DecodeResult::INVALID;
+
+        const size_t tile = header[5];
+        const size_t count = header[6] | (header[7] << 8);
+        if (tile == 0 || tile % 2 != 0)
+            return DecodeResult::UNSUPPORTED;
+        if (!display.DMemory4Bit)
+            return DecodeResult::MEMORY;
+
+        // Tile indices, and the size of the pixel data they add up to
+        const size_t cols = (E_INK_WIDTH + tile - 1) / tile;
+        const size_t rows = (E_INK_HEIGHT + tile - 1) / tile;
+        std::vector<uint16_t> tiles(count);
+        size_t total = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            uint8_t le[2];
+            if (src.read(le, sizeof(le)) != sizeof(le))
+                return DecodeResult::INPUT;
+            tiles[i] = le[0] | (le[1] << 8);
+            if (tiles[i] >= cols * rows)
+                return DecodeResult::INVALID;
+            size_t x = tiles[i] % cols * tile, y = tiles[i] / cols * tile;
+            total += min(tile, (size_t)E_INK_WIDTH - x) / 2 * min(tile, (size_t)E_INK_HEIGHT - y);
+        }
+        if (total == 0)
+            return DecodeResult::OK;
+
+        // The tile pixels are one LZ4 block, so they need their own buffer
+        // before being copied into place
+        uint8_t *pixels = static_cast<uint8_t *>(heap_caps_malloc(total, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+        if (!pixels)
+            pixels = static_cast<uint8_t *>(heap_caps_malloc(total, MALLOC_CAP_8BIT));
+        if (!pixels)
+            return DecodeResult::MEMORY;
+
+        DecodeResult res = inflate(src, pixels, total);
+        if (res == DecodeResult::OK)
+        {
+            const uint8_t *from = pixels;
+            for (uint16_t index : tiles)
+            {
+                size_t x = index % cols * tile, y = index / cols * tile;
+                size_t bytes = min(tile, (size_t)E_INK_WIDTH - x) / 2;
+                size_t height = min(tile, (size_t)E_INK_HEIGHT - y);
+                for (size_t r = 0; r < height; r++, from += bytes)
+                    memcpy(display.DMemory4Bit + ((y + r) * E_INK_WIDTH + x) / 2, from, bytes);
+            }
+        }
+        heap_caps_free(pixels);
+        return res;
+    }
+}
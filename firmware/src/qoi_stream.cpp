@@ -0,0 +1,219 @@
+#include <Arduino.h>
+#include <cstring>
+
+#include "framebuffer.h"
+#include "qoi_stream.h"
+
+namespace qoi_stream
+{
+    // Chunk tags (qoiformat.org/qoi-specification.pdf)
+    enum : uint8_t
+    {
+        QOI_OP_INDEX = 0x00, // 00xxxxxx
+        QOI_OP_DIFF = 0x40,  // 01xxxxxx
+        QOI_OP_LUMA = 0x80,  // 10xxxxxx
+        QOI_OP_RUN = 0xC0,   // 11xxxxxx
+        QOI_OP_RGB = 0xFE,
+        QOI_OP_RGBA = 0xFF,
+    };
+
+    // Rows dithered before they are written out together; the same as a
+    // 2x2 subsampled JPEG's MCU row
+    static constexpr int BAND_ROWS = 16;
+
+    // Big-endian 32-bit word
+    static inline uint32_t word32(const uint8_t *p)
+    {
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+    }
+
+    // Blend a sample over white
+    static inline uint8_t overWhite(uint8_t v, uint8_t a)
+    {
+        return (v * a + 255 * (255 - a)) / 255;
+    }
+
+    // Refill the input buffer from the source
+    bool Decoder::fetch()
+    {
+        inputPos = 0;
+        inputLen = src->read(buffer, sizeof(buffer));
+        return inputLen > 0;
+    }
+
+    // Next input byte, or -1 at the end of the input
+    inline int Decoder::readByte()
+    {
+        if (inputPos == inputLen && !fetch())
+            return -1;
+        return buffer[inputPos++];
+    }
+
+    // Read and check the header
+    DecodeResult Decoder::prepare(ByteSource &source)
+    {
+        src = &source;
+        inputPos = inputLen = 0;
+        imageWidth = imageHeight = imageChannels = 0;
+
+        uint8_t header[14];
+        if (source.read(header, sizeof(header)) != sizeof(header))
+            return DecodeResult::INPUT;
+        uint32_t w = word32(header + 4), h = word32(header + 8);
+        if (memcmp(header, "qoif", 4) || !w || !h || (header[12] != 3 && header[12] != 4) || header[13] > 1)
+            return DecodeResult::INVALID;
+        if (w > UINT16_MAX || h > UINT16_MAX)
+            return DecodeResult::UNSUPPORTED;
+
+        imageWidth = w;
+        imageHeight = h;
+        imageChannels = header[12];
+        memcpy(px, "\0\0\0\xFF", 4);
+        memset(index, 0, sizeof(index));
+        run = 0;
+        return DecodeResult::OK;
+    }
+
+    // Decode the next row into RGB888; false if the input ends first
+    IRAM_ATTR bool Decoder::decodeRow(uint8_t *rgb)
+    {
+        uint8_t r = px[0], g = px[1], b = px[2], a = px[3];
+        for (uint32_t x = 0; x < imageWidth; x++, rgb += 3)
+        {
+            if (run)
+            {
+                run--;
+            }
+            else
+            {
+                int op = readByte();
+                if (op < 0)
+                    return false;
+                if (op == QOI_OP_RGB || op == QOI_OP_RGBA)
+                {
+                    int c0 = readByte(), c1 = readByte(), c2 = readByte();
+                    int c3 = op == QOI_OP_RGBA ? readByte() : a;
+                    if ((c0 | c1 | c2 | c3) < 0)
+                        return false;
+                    r = c0;
+                    g = c1;
+                    b = c2;
+                    a = c3;
+                }
+                else
+                {
+                    switch (op & 0xC0)
+                    {
+                    case QOI_OP_INDEX:
+                        r = index[op][0];
+                        g = index[op][1];
+                        b = index[op][2];
+                        a = index[op][3];
+                        break;
+                    case QOI_OP_DIFF:
+                        r += ((op >> 4) & 3) - 2;
+                        g += ((op >> 2) & 3) - 2;
+                        b += (op & 3) - 2;
+                        break;
+                    case QOI_OP_LUMA:
+                    {
+                        int d = readByte();
+                        if (d < 0)
+                            return false;
+                        int dg = (op & 0x3F) - 32;
+                        r += dg - 8 + (d >> 4);
+                        g += dg;
+                        b += dg - 8 + (d & 0x0F);
+                        break;
+                    }
+                    default:
+                        // This pixel and up to 61 more like it
+                        run = op & 0x3F;
+                        break;
+                    }
+                }
+                uint8_t *seen = index[(r * 3 + g * 5 + b * 7 + a * 11) % 64];
+                seen[0] = r;
+                seen[1] = g;
+                seen[2] = b;
+                seen[3] = a;
+            }
+
+            if (a == 255)
+            {
+                rgb[0] = r;
+                rgb[1] = g;
+                rgb[2] = b;
+            }
+            else
+            {
+                rgb[0] = overWhite(r, a);
+                rgb[1] = overWhite(g, a);
+                rgb[2] = overWhite(b, a);
+            }
+        }
+        px[0] = r;
+        px[1] = g;
+        px[2] = b;
+        px[3] = a;
+        return true;
+    }
+
+    // Draw a band of dithered rows at display row y
+    void Decoder::flush(Inkplate &display, int x, int y, int width, int rows)
+    {
+        // Straight into the framebuffer when it's laid out as compiled for;
+        // through Adafruit_GFX otherwise
+        if (direct)
+        {
+            framebuffer::writeRows(display, x, y, quantized.data(), width, width, rows);
+            return;
+        }
+        for (int r = 0; r < rows; r++)
+            for (int c = 0; c < width; c++)
+                display.drawPixel(x + c, y + r, framebuffer::color(display, quantized[(size_t)r * width + c]));
+    }
+
+    // Decode row after row, dither them and draw them in bands
+    DecodeResult Decoder::draw(Inkplate &display, int x, int y, dither::Mode mode, const dither::Tone &tone)
+    {
+        if (!imageWidth || !src)
+            return DecodeResult::INVALID;
+
+        // Rows and columns past the display are not drawn; rows past it are
+        // not decoded either
+        int width = min<int>(imageWidth, display.width() - x);
+        int height = min<int>(imageHeight, display.height() - y);
+        if (width <= 0 || height <= 0)
+            return DecodeResult::OK;
+
+        direct = framebuffer::available(display);
+        if (!ditherer.begin(mode, width, 0, tone, framebuffer::bilevel(display)))
+            return DecodeResult::MEMORY;
+        std::vector<uint8_t> rgb((size_t)imageWidth * 3);
+        quantized.resize((size_t)width * BAND_ROWS);
+        display.clearDisplay();
+
+        DecodeResult res = DecodeResult::OK;
+        int band = 0;
+        for (int row = 0; row < height; row++)
+        {
+            if (!decodeRow(rgb.data()))
+            {
+                res = DecodeResult::INPUT;
+                break;
+            }
+            ditherer.row(rgb.data(), 3, &quantized[(size_t)band * width]);
+            if (++band == BAND_ROWS || row == height - 1)
+            {
+                flush(display, x, y + row + 1 - band, width, band);
+                band = 0;
+            }
+        }
+
+        // Release the working rows; they are only needed while decoding
+        ditherer.end();
+        std::vector<uint8_t>().swap(quantized);
+        return res;
+    }
+}
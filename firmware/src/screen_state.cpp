@@ -0,0 +1,94 @@
+#include <esp_attr.h>
+
+#include "logger.h"
+#include "screen_state.h"
+
+namespace ScreenState
+{
+    static constexpr uint32_t STATE_MAGIC = 0x53435231; // "SCR1"
+
+    // What the panel showed after the last refresh
+    struct State
+    {
+        uint32_t magic;
+        uint32_t endpoint;      // Hash of the endpoint the image came from
+        uint32_t frame;         // Hash of the image body and overlays
+        char etag[96];          // Empty if the server sent none
+        char lastModified[40];  // Empty if the server sent none
+    };
+    RTC_DATA_ATTR static State shown;
+    RTC_DATA_ATTR static uint32_t skipped;
+
+    // Image drawn this wake, waiting for the refresh that shows it
+    static State pending;
+
+    // FNV-1a hash of an endpoint path
+    static uint32_t hashEndpoint(const char *endpoint)
+    {
+        uint32_t h = 2166136261u;
+        for (const char *p = endpoint; *p; p++)
+        {
+            h ^= static_cast<uint8_t>(*p);
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    // Validators of the image on the panel, if it was fetched from endpoint
+    bool validators(const char *endpoint, String &etag, String &lastModified)
+    {
+        if (!endpoint || shown.magic != STATE_MAGIC || shown.endpoint != hashEndpoint(endpoint))
+            return false;
+        if (!shown.etag[0] && !shown.lastModified[0])
+            return false;
+        etag = shown.etag;
+        lastModified = shown.lastModified;
+        return true;
+    }
+
+    // Whether the panel shows a frame with this content hash
+    bool showsFrame(uint32_t frame)
+    {
+        return shown.magic == STATE_MAGIC && shown.frame == frame;
+    }
+
+    // A new image fetched from endpoint was drawn into the framebuffer
+    void imageDrawn(const char *endpoint, const String &etag, const String &lastModified, uint32_t frame)
+    {
+        pending = {};
+        if (!endpoint)
+            return;
+
+        // Validators that don't fit can't be sent back verbatim; drop them
+        if (etag.length() < sizeof(pending.etag))
+            strcpy(pending.etag, etag.c_str());
+        if (lastModified.length() < sizeof(pending.lastModified))
+            strcpy(pending.lastModified, lastModified.c_str());
+        pending.endpoint = hashEndpoint(endpoint);
+        pending.frame = frame;
+        pending.magic = STATE_MAGIC;
+    }
+
+    // The panel was refreshed; keep the pending image as the shown one
+    void refreshed()
+    {
+        shown = pending;
+        pending = {};
+        if (shown.magic == STATE_MAGIC && (shown.etag[0] || shown.lastModified[0]))
+            Logger::logf(Logger::LOG_DEBUG, "Screen validators: etag=%s, last-modified=%s",
+                         shown.etag[0] ? shown.etag : "-", shown.lastModified[0] ? shown.lastModified : "-");
+    }
+
+    // Count a wake that left the panel untouched
+    uint32_t refreshSkipped()
+    {
+        return ++skipped;
+    }
+
+    // Something other than a fetched image is being put on the panel
+    void invalidate()
+    {
+        shown = {};
+        pending = {};
+    }
+}
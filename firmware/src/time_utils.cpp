@@ -4,11 +4,15 @@
 #include <map>
 
 #include "time_utils.h"
+#include "https_session.h"
 #include "logger.h"
 #include "time.h"
 #include "sys/time.h"
 #include "urlparser.h"
 
+// POSIX TZ string from the last NTP sync, for wakes that skip it
+RTC_DATA_ATTR static char savedTimezone[48] = {0};
+
 // Function to get the local time as a string (e.g., "2025-01-01 12:00:00 AM")
 String getLocalTimestamp(time_t epochFallback)
 {
@@ -457,6 +461,16 @@ WakeEntry calculateNextWake(
     return result;
 }
 
+// Re-apply the timezone of the last NTP sync on a wake that skips it
+bool restoreTimezone()
+{
+    if (!savedTimezone[0])
+        return false;
+    setenv("TZ", savedTimezone, 1);
+    tzset();
+    return true;
+}
+
 // NTP sync function with timezone and retries
 esp_err_t NTPSync(Inkplate &display, const char *api, const JsonVariant &ntpConfig)
 {
@@ -484,12 +498,11 @@ esp_err_t NTPSync(Inkplate &display, const char *api, const JsonVariant &ntpConf
         parsed.expandPath(basepath, "timezone", URLParser::urlEncode(timezone).c_str());
         Logger::logf(Logger::LOG_DEBUG, "Timezone request: %s", parsed.getURL(true).c_str());
 
-        WiFiClientSecure client;
-        client.setInsecure();
-        HTTPClient https;
-        https.getStream().setNoDelay(true);
-        https.getStream().setTimeout(1000);
-        https.begin(client, parsed.getURL());
+        // Goes through the shared session so the image fetch that follows
+        // can reuse this TLS connection
+        HTTPClient &https = apiSession.http();
+        apiSession.begin(parsed);
+        https.setTimeout(5000);
 
         int code = https.GET();
         if (code == HTTP_CODE_OK)
@@ -503,13 +516,18 @@ esp_err_t NTPSync(Inkplate &display, const char *api, const JsonVariant &ntpConf
         {
             Logger::logf(Logger::LOG_ERROR, "Failed to get timezone data: %d", code);
         }
-        https.end();
+        apiSession.end(code == HTTP_CODE_OK);
     }
 
     Logger::logf(Logger::LOG_INFO, "NTP Servers: %s, %s / Timezone: %s (GMT Offset: %d sec, Daylight Offset: %d sec) / Retries: %d",
                  server1, server2, timezone, gmtOffset, daylightOffset, retries);
     configTime(gmtOffset, daylightOffset, server1, server2);
 
+    // Keep the resulting TZ for wakes that don't sync (see restoreTimezone)
+    const char *tz = getenv("TZ");
+    if (tz && strlen(tz) < sizeof(savedTimezone))
+        strcpy(savedTimezone, tz);
+
     int attempts = 0;
     display.rtcReset();
 
@@ -0,0 +1,388 @@
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_attr.h>
+#include <mbedtls/net_sockets.h>
+#include <vector>
+
+#include "definitions.h"
+#include "logger.h"
+#include "tls_client.h"
+
+// Handshake timeout when the caller doesn't give one
+static constexpr int32_t DEFAULT_TIMEOUT_MS = 10000;
+
+// NVS location for sessions too large for the RTC slot
+static const char *NVS_NAMESPACE = "inky-tls";
+static const char *NVS_KEY = "session";
+
+static constexpr uint32_t SESSION_MAGIC = 0x544c5331; // "TLS1"
+
+// Session saved by the last successful handshake. It lives in RTC slow memory
+// so it survives deep sleep; the serialized session is kept inline when it
+// fits, otherwise only its length is kept here and the bytes go to NVS.
+struct SavedSession
+{
+    uint32_t magic;
+    uint16_t port;
+    uint16_t length;
+    bool inNvs;
+    char host[64];
+    uint8_t data[TLS_SESSION_RTC_SIZE];
+};
+RTC_DATA_ATTR static SavedSession saved;
+
+// Whether the saved session belongs to host:port
+static bool savedFor(const char *host, uint16_t port)
+{
+    return saved.magic == SESSION_MAGIC && saved.port == port &&
+           strncmp(saved.host, host, sizeof(saved.host)) == 0;
+}
+
+// Restore the session saved for host:port, if any
+static bool loadSession(const char *host, uint16_t port, mbedtls_ssl_session *session)
+{
+    if (!savedFor(host, port))
+        return false;
+    if (!saved.inNvs)
+        return mbedtls_ssl_session_load(session, saved.data, saved.length) == 0;
+
+    std::vector<uint8_t> blob(saved.length);
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, true))
+        return false;
+    size_t n = prefs.getBytes(NVS_KEY, blob.data(), blob.size());
+    prefs.end();
+    return n == blob.size() && mbedtls_ssl_session_load(session, blob.data(), blob.size()) == 0;
+}
+
+// Save the session of the current connection for the next wake. A resumed
+// session whose bytes live in NVS is not rewritten, to spare the flash.
+static void storeSession(const char *host, uint16_t port, const mbedtls_ssl_session *session, bool fresh)
+{
+    size_t len = 0;
+    mbedtls_ssl_session_save(session, nullptr, 0, &len);
+    if (len == 0 || len > UINT16_MAX || strlen(host) >= sizeof(saved.host))
+        return;
+
+    if (len <= sizeof(saved.data))
+    {
+        saved.magic = 0;
+        if (mbedtls_ssl_session_save(session, saved.data, sizeof(saved.data), &len) != 0)
+            return;
+        saved.inNvs = false;
+    }
+    else
+    {
+        if (!fresh && saved.inNvs && savedFor(host, port))
+            return;
+
+        saved.magic = 0;
+        std::vector<uint8_t> blob(len);
+        if (mbedtls_ssl_session_save(session, blob.data(), blob.size(), &len) != 0)
+            return;
+        Preferences prefs;
+        if (!prefs.begin(NVS_NAMESPACE, false))
+            return;
+        bool ok = prefs.putBytes(NVS_KEY, blob.data(), len) == len;
+        prefs.end();
+        if (!ok)
+        {
+            Logger::log(Logger::LOG_WARNING, "TLS: failed to save session to NVS");
+            return;
+        }
+        saved.inNvs = true;
+    }
+
+    strncpy(saved.host, host, sizeof(saved.host));
+    saved.port = port;
+    saved.length = len;
+    saved.magic = SESSION_MAGIC;
+    Logger::logf(Logger::LOG_DEBUG, "TLS: saved %u byte session to %s", len, saved.inNvs ? "NVS" : "RTC");
+}
+
+TlsClient::TlsClient()
+{
+    mbedtls_ctr_drbg_init(&drbg);
+    mbedtls_entropy_init(&entropy);
+}
+
+TlsClient::~TlsClient()
+{
+    stop();
+    mbedtls_ctr_drbg_free(&drbg);
+    mbedtls_entropy_free(&entropy);
+}
+
+// Forget any saved session (RTC and NVS)
+void TlsClient::clearSavedSession()
+{
+    if (saved.magic == SESSION_MAGIC && saved.inNvs)
+    {
+        Preferences prefs;
+        if (prefs.begin(NVS_NAMESPACE, false))
+        {
+            prefs.remove(NVS_KEY);
+            prefs.end();
+        }
+    }
+    saved.magic = 0;
+}
+
+// Send TLS records straight through the TCP socket
+int TlsClient::bioSend(void *ctx, const unsigned char *buf, size_t len)
+{
+    TlsClient *self = static_cast<TlsClient *>(ctx);
+    size_t n = self->WiFiClient::write(buf, len);
+    return n > 0 ? static_cast<int>(n) : MBEDTLS_ERR_NET_SEND_FAILED;
+}
+
+// Receive whatever the TCP socket has, without blocking
+int TlsClient::bioRecv(void *ctx, unsigned char *buf, size_t len)
+{
+    TlsClient *self = static_cast<TlsClient *>(ctx);
+    int avail = self->WiFiClient::available();
+    if (avail <= 0)
+        return self->WiFiClient::connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+    int n = self->WiFiClient::read(buf, min(len, static_cast<size_t>(avail)));
+    return n > 0 ? n : MBEDTLS_ERR_SSL_WANT_READ;
+}
+
+// Run the TLS handshake on an already connected socket
+bool TlsClient::handshake(const char *host, uint16_t port, int32_t timeout)
+{
+    if (!seeded)
+    {
+        const unsigned char *pers = reinterpret_cast<const unsigned char *>(USER_AGENT);
+        int ret = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, pers, strlen(USER_AGENT));
+        if (ret != 0)
+        {
+            Logger::logf(Logger::LOG_ERROR, "TLS: RNG seed failed: -0x%04x", -ret);
+            return false;
+        }
+        seeded = true;
+    }
+
+    mbedtls_ssl_init(&ssl);
+    mbedtls_ssl_config_init(&conf);
+    int ret = mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT);
+    if (ret == 0)
+    {
+        // No cert verification for simplicity
+        mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_NONE);
+        mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &drbg);
+        mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+        ret = mbedtls_ssl_setup(&ssl, &conf);
+    }
+    if (ret == 0)
+        ret = mbedtls_ssl_set_hostname(&ssl, host);
+    if (ret != 0)
+    {
+        Logger::logf(Logger::LOG_ERROR, "TLS: setup failed: -0x%04x", -ret);
+        mbedtls_ssl_free(&ssl);
+        mbedtls_ssl_config_free(&conf);
+        return false;
+    }
+    mbedtls_ssl_set_bio(&ssl, this, bioSend, bioRecv, nullptr);
+
+    // Offer the session saved by a previous wake. The server either accepts it
+    // (abbreviated handshake, same master secret) or falls back to a full one.
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    unsigned char offered[sizeof(session.master)];
+    bool offering = loadSession(host, port, &session) && mbedtls_ssl_set_session(&ssl, &session) == 0;
+    if (offering)
+        memcpy(offered, session.master, sizeof(offered));
+    mbedtls_ssl_session_free(&session);
+
+    uint32_t start = millis();
+    while ((ret = mbedtls_ssl_handshake(&ssl)) != 0)
+    {
+        bool waiting = ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE;
+        if (!waiting || millis() - start > static_cast<uint32_t>(timeout))
+        {
+            Logger::logf(Logger::LOG_ERROR, "TLS: handshake with %s failed: -0x%04x", host, -ret);
+            mbedtls_ssl_free(&ssl);
+            mbedtls_ssl_config_free(&conf);
+
+            // Don't keep offering a session that may be the cause
+            if (offering)
+                clearSavedSession();
+            return false;
+        }
+        delay(1);
+    }
+    lastHandshakeMs = millis() - start;
+    lastResumed = offering && memcmp(ssl.session->master, offered, sizeof(offered)) == 0;
+    active = true;
+
+    // Keep the session (possibly with a fresh ticket) for the next wake
+    mbedtls_ssl_session_init(&session);
+    if (mbedtls_ssl_get_session(&ssl, &session) == 0)
+        storeSession(host, port, &session, !lastResumed);
+    mbedtls_ssl_session_free(&session);
+    return true;
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port)
+{
+    return connect(ip.toString().c_str(), port, DEFAULT_TIMEOUT_MS);
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port, int32_t timeout)
+{
+    return connect(ip.toString().c_str(), port, timeout);
+}
+
+int TlsClient::connect(const char *host, uint16_t port)
+{
+    return connect(host, port, DEFAULT_TIMEOUT_MS);
+}
+
+// Open the TCP connection and run the TLS handshake, resuming if possible
+int TlsClient::connect(const char *host, uint16_t port, int32_t timeout)
+{
+    stop();
+    if (timeout <= 0)
+        timeout = DEFAULT_TIMEOUT_MS;
+
+    timeoutMs = timeout;
+    uint32_t start = millis();
+    if (!WiFiClient::connect(host, port, timeout))
+        return 0;
+    uint32_t tcpMs = millis() - start;
+
+    if (!handshake(host, port, timeout))
+    {
+        WiFiClient::stop();
+        return 0;
+    }
+
+    Logger::logf(Logger::LOG_INFO, "TLS to %s: %s handshake in %lu ms (TCP %lu ms)", host,
+                 lastResumed ? "resumed" : "full", static_cast<unsigned long>(lastHandshakeMs),
+                 static_cast<unsigned long>(tcpMs));
+    return 1;
+}
+
+size_t TlsClient::write(uint8_t data)
+{
+    return write(&data, 1);
+}
+
+size_t TlsClient::write(const uint8_t *buf, size_t size)
+{
+    if (!active)
+        return 0;
+
+    // Give up when the socket takes no data for as long as connecting may take
+    size_t sent = 0;
+    uint32_t start = millis();
+    while (sent < size)
+    {
+        int ret = mbedtls_ssl_write(&ssl, buf + sent, size - sent);
+        if (ret > 0)
+        {
+            sent += ret;
+            start = millis();
+            continue;
+        }
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+        {
+            Logger::logf(Logger::LOG_WARNING, "TLS: write failed: -0x%04x", -ret);
+            break;
+        }
+        if (millis() - start > static_cast<uint32_t>(timeoutMs))
+        {
+            Logger::logf(Logger::LOG_WARNING, "TLS: write timed out after %lu of %lu bytes",
+                         static_cast<unsigned long>(sent), static_cast<unsigned long>(size));
+            break;
+        }
+        delay(1);
+    }
+    return sent;
+}
+
+// Decrypted bytes ready to read; processes one pending record if none are
+int TlsClient::available()
+{
+    if (!active)
+        return 0;
+
+    if (peeked < 0 && mbedtls_ssl_get_bytes_avail(&ssl) == 0)
+    {
+        int ret = mbedtls_ssl_read(&ssl, nullptr, 0);
+        if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+        {
+            if (ret != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY)
+                Logger::logf(Logger::LOG_DEBUG, "TLS: read failed: -0x%04x", -ret);
+            stop();
+            return 0;
+        }
+    }
+    return (peeked >= 0 ? 1 : 0) + static_cast<int>(mbedtls_ssl_get_bytes_avail(&ssl));
+}
+
+int TlsClient::read()
+{
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+}
+
+int TlsClient::read(uint8_t *buf, size_t size)
+{
+    if (!buf || size == 0 || available() <= 0)
+        return -1;
+
+    size_t got = 0;
+    if (peeked >= 0)
+    {
+        buf[got++] = static_cast<uint8_t>(peeked);
+        peeked = -1;
+    }
+    if (got < size && mbedtls_ssl_get_bytes_avail(&ssl) > 0)
+    {
+        int ret = mbedtls_ssl_read(&ssl, buf + got, size - got);
+        if (ret > 0)
+            got += ret;
+    }
+    return static_cast<int>(got);
+}
+
+int TlsClient::peek()
+{
+    if (peeked < 0 && available() > 0)
+    {
+        uint8_t b;
+        if (mbedtls_ssl_read(&ssl, &b, 1) == 1)
+            peeked = b;
+    }
+    return peeked;
+}
+
+// Nothing is buffered on the write side; unlike WiFiClient::flush() this
+// must not discard received data
+void TlsClient::flush()
+{
+}
+
+void TlsClient::stop()
+{
+    if (active)
+    {
+        mbedtls_ssl_close_notify(&ssl);
+        mbedtls_ssl_free(&ssl);
+        mbedtls_ssl_config_free(&conf);
+        active = false;
+    }
+    peeked = -1;
+    WiFiClient::stop();
+}
+
+uint8_t TlsClient::connected()
+{
+    if (!active)
+        return 0;
+    if (peeked >= 0 || mbedtls_ssl_get_bytes_avail(&ssl) > 0)
+        return 1;
+    return WiFiClient::connected();
+}
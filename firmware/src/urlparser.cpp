@@ -115,6 +115,12 @@ namespace URLParser
         path = newPath.startsWith("/") ? newPath : ("/" + newPath);
     }
 
+    // Retrieves the domain (host and optional port) from the URL
+    String Parser::getDomain() const
+    {
+        return domain;
+    }
+
     // Retrieves the path from the URL
     String Parser::getPath() const
     {
@@ -51,6 +51,7 @@ const providers = {
         headers: async (data, mode) => (data?.img ? [
             ["X-Inky-Message-0", `"${data?.title ?? '???'}" (#${data?.num ?? '???'})`],
             ["X-Inky-Message-2", data?.alt ?? '???'],
+            ["X-Inky-Mode", "1bit"], // Line art; refreshes faster in 1-bit
         ] : [
             ["X-Inky-Message-0", "Please check your renderer settings!"],
             ["X-Inky-Message-2", "Invalid response from xkcd; using Lorem Picsum."],
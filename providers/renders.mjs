@@ -1,6 +1,9 @@
-import articles from "./templates/articles.mjs";
-import weather from "./templates/weather.mjs";
-import hn from "./templates/hn.mjs";
+import articles, { displayList as articlesList } from "./templates/articles.mjs";
+import weather, { displayList as weatherList } from "./templates/weather.mjs";
+import hn, { displayList as hnList } from "./templates/hn.mjs";
+
+// Articles worth showing from a NYT API response
+const nytArticles = (results = []) => results.filter(v => v.title && v.abstract && v.url && !!v.multimedia?.length).slice(0, 5);
 
 const providers = {
     "nytimes": {
@@ -23,11 +26,13 @@ const providers = {
         ],
         source: async ({ results = [] }, mode) => {
             return await articles(
-                results.filter(v => v.title && v.abstract && v.url && !!v.multimedia?.length).slice(0, 5),
+                nytArticles(results),
                 mode,
                 'nytimes'
             );
         },
+        // Drawn on the device, for those that accept display lists
+        displayList: async ({ results = [] }, mode) => articlesList(nytArticles(results), mode, "The New York Times"),
     },
     "weather": {
         async api(mode, c, headers) {
@@ -67,6 +72,7 @@ const providers = {
                 c
             );
         },
+        displayList: async (data, mode) => weatherList(data, mode),
     },
     "hn": {
         description: "Hacker News",
@@ -89,6 +95,7 @@ const providers = {
                 c
             );
         },
+        displayList: async (data, mode, c) => hnList(data, mode, c),
     }
 }
 
@@ -1,4 +1,5 @@
 import QRCode from 'qrcode-svg';
+import { DisplayList, FONT_SYSTEM, FONT_SANS_BOLD_OBLIQUE_24, lineMetrics } from '../../routes/libs/display_list.mjs';
 
 export function epochToDate(epoch) {
     return new Date(epoch * 1000);
@@ -22,4 +23,39 @@ export function getDay(ds) {
 
 export function qr(content) {
     return new QRCode({ content, padding: 0, width: 100, height: 100, color: "#000000", background: "#ffffff", ecl: "M" }).svg();
-}
\ No newline at end of file
+}
+
+// QR code modules as rows of booleans (true = dark), for display lists
+export function qrRows(content) {
+    // qrcode-svg indexes its modules [x][y], as in its own svg()
+    let modules = new QRCode({ content, padding: 0, ecl: "M" }).qrcode.modules;
+    return modules.map((_, y) => modules.map((column) => !!column[y]));
+}
+
+// Display list page: a title bar and a footer around the content; returns
+// the list and the area left for the content
+export function listPage(mode, title, footer) {
+    let list = new DisplayList(mode.w, mode.h),
+        large = mode.w >= 800,
+        margin = large ? 24 : 12,
+        bar = large ? 64 : 40,
+        small = { scale: large ? 2 : 1, gray: 64 },
+        footerTop = mode.h - lineMetrics(FONT_SYSTEM, small.scale).height - margin;
+
+    list.fillRect(0, 0, mode.w, bar, 0);
+    if (large)
+        list.text(margin, 48, title, { font: FONT_SANS_BOLD_OBLIQUE_24, gray: 255 });
+    else
+        list.text(margin, 31, title, { scale: 3, gray: 255 });
+    list.line(margin, footerTop - margin / 2, mode.w - margin, footerTop - margin / 2, 128);
+    list.paragraph(margin, footerTop, mode.w - 2 * margin, footer, { ...small, maxLines: 1 });
+
+    return {
+        list,
+        large,
+        x: margin,
+        y: bar + margin,
+        width: mode.w - 2 * margin,
+        bottom: footerTop - margin,
+    };
+}
@@ -1,6 +1,7 @@
 import { html, raw } from 'hono/html';
 import images from './_images.mjs';
-import { qr } from './_utils.mjs';
+import { qr, qrRows, listPage } from './_utils.mjs';
+import { paragraphHeight } from '../../routes/libs/display_list.mjs';
 
 export default async function (articles, mode, provider = false) {
     return html`
@@ -54,4 +55,33 @@ export default async function (articles, mode, provider = false) {
     </body>
 </html>
     `;
-};
\ No newline at end of file
+};
+
+// The same articles as a display list, drawn by the device: headline,
+// snippet and (on large panels) a QR code to the article
+export function displayList(articles, mode, name = "News") {
+    let { list, large, x, y, width, bottom } = listPage(mode, name, new Date().toDateString()),
+        title = { scale: large ? 3 : 2, maxLines: 2 },
+        snippet = { scale: large ? 2 : 1, gray: 64, maxLines: large ? 4 : 3 },
+        gap = large ? 16 : 8,
+        qrScale = 3;
+
+    for (let article of articles) {
+        let text = article.snippet || article.abstract,
+            code = large ? qrRows(article.url) : undefined,
+            side = code ? code.length * qrScale + gap : 0,
+            height = paragraphHeight(article.title, width, title) +
+                Math.max(paragraphHeight(text, width - side, snippet), side - gap);
+        if (y + height > bottom)
+            break;
+        let top = y;
+        y = list.paragraph(x, y, width, article.title, title);
+        if (code)
+            list.draw(list.bitmap(code), x + width - code.length * qrScale, y, { scale: qrScale });
+        y = list.paragraph(x, y, width - side, text, snippet);
+        y = Math.max(y, top + height);
+        list.line(x, y + gap / 2, x + width, y + gap / 2, 192);
+        y += gap;
+    }
+    return list;
+}
@@ -1,6 +1,7 @@
 import { html, raw } from 'hono/html';
 import images from './_images.mjs';
-import { qr, epochToDateTime } from './_utils.mjs';
+import { qr, epochToDateTime, listPage } from './_utils.mjs';
+import { paragraphHeight } from '../../routes/libs/display_list.mjs';
 
 export default async function (data, mode, c) {
     let timezone = c?.req?.raw?.cf?.timezone ?? "America/Los_Angeles";
@@ -41,4 +42,24 @@ export default async function (data, mode, c) {
     </body>
 </html>
     `;
-};
\ No newline at end of file
+};
+
+// The same listing as a display list, drawn by the device
+export function displayList(data, mode, c) {
+    let timezone = c?.req?.raw?.cf?.timezone ?? "America/Los_Angeles",
+        { list, large, x, y, width, bottom } = listPage(mode, "Hacker News", new Date().toDateString()),
+        title = { scale: large ? 3 : 2, maxLines: 2 },
+        meta = { scale: large ? 2 : 1, gray: 96, maxLines: 1 },
+        gap = large ? 12 : 6;
+
+    for (let post of data?.hits ?? []) {
+        let info = `${epochToDateTime(post.created_at_i, timezone)} - ${post.author} - ${post.points} points - ${post.num_comments} comments`;
+        if (y + paragraphHeight(post.title, width, title) + paragraphHeight(info, width, meta) > bottom)
+            break;
+        y = list.paragraph(x, y, width, post.title, title);
+        y = list.paragraph(x, y, width, info, meta);
+        list.line(x, y + gap / 2, x + width, y + gap / 2, 192);
+        y += gap;
+    }
+    return list;
+}
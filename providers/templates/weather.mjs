@@ -1,5 +1,6 @@
 import { html, raw } from 'hono/html';
-import { getDay, epochToTime } from './_utils.mjs';
+import { getDay, epochToTime, listPage } from './_utils.mjs';
+import { FONT_SYSTEM, FONT_SANS_BOLD_OBLIQUE_24, lineMetrics, measure } from '../../routes/libs/display_list.mjs';
 
 export default async function (data, mode) {
     let current = data?.currentConditions ?? {},
@@ -59,4 +60,39 @@ export default async function (data, mode) {
     </body>
 </html>
     `;
-};
\ No newline at end of file
+};
+
+// The same forecast as a display list, drawn by the device
+export function displayList(data, mode) {
+    let current = data?.currentConditions ?? {},
+        { list, large, x, y, width, bottom } = listPage(mode, "Weather", data?.address ?? '???'),
+        days = (data?.days ?? []).slice(0, large ? 7 : 3),
+        body = { scale: large ? 3 : 2 },
+        row = Math.round(lineMetrics(FONT_SYSTEM, body.scale).height * 1.6),
+        center = (text, top, options) => list.paragraph(x + Math.max(0, (width - measure(text, options.font, options.scale)) / 2), top, width, text, options);
+
+    // Now: temperature, then what it feels like and the conditions
+    let temp = `${current.temp ?? '???'}F`,
+        big = { font: FONT_SANS_BOLD_OBLIQUE_24, scale: large ? 2 : 1, spacing: 1 };
+    y = center(temp, y, big);
+    y = center(`Feels like ${current.feelslike ?? '???'}F`, y, { scale: body.scale - 1 || 1, gray: 64 });
+    y = center(`${current.conditions ?? '???'} at ${epochToTime(current.datetimeEpoch, data?.timezone)}`, y, { scale: body.scale - 1 || 1, gray: 64 });
+    y += row / 2;
+    list.line(x, y, x + width, y, 0);
+    y += row / 2;
+
+    // Forecast table: day, high, low and (with room for it) conditions
+    let columns = [0, 0.18, 0.36, 0.54].map((f) => x + Math.round(f * width)),
+        cells = (day) => [getDay(day.datetime) ?? '???', `${day.tempmax ?? '???'}F`, `${day.tempmin ?? '???'}F`, day.conditions ?? '???'];
+    for (let [i, cell] of ["Day", "High", "Low", "Conditions"].entries())
+        list.text(columns[i], y + lineMetrics(FONT_SYSTEM, body.scale).ascent, cell, { ...body, gray: 96 });
+    y += row;
+    for (let day of days) {
+        if (y + row > bottom)
+            break;
+        for (let [i, cell] of cells(day).entries())
+            list.paragraph(columns[i], y, (columns[i + 1] ?? x + width) - columns[i] - 8, cell, { ...body, maxLines: 1 });
+        y += row;
+    }
+    return list;
+}
@@ -0,0 +1,37 @@
+// Frame bundle container, read by the firmware (see firmware/src/frame_store.cpp)
+//
+//   header:  "INKB" | u8 version | u8 count | u16 reserved
+//   frame:   u32 epoch | u32 length | u8 flags | u8[3] reserved | length bytes
+//
+// All integers are little-endian. Frames are baseline JPEGs, in wake order.
+export const BUNDLE_VERSION = 1;
+
+// Frame flags; the high nibble is the dither mode id (see dither.mjs), 0 for
+// the firmware's default
+export const FRAME_NO_DITHERING = 0x01;
+export const FRAME_BILEVEL = 0x02; // Shown in the panel's 1-bit mode
+export const FRAME_DITHER_SHIFT = 4;
+
+// Pack frames ({ epoch, flags, data: Uint8Array }) into one container
+export function packBundle(frames = []) {
+    let total = 8 + frames.reduce((sum, f) => sum + 12 + f.data.byteLength, 0),
+        out = new Uint8Array(total),
+        view = new DataView(out.buffer),
+        offset = 8;
+
+    // Header
+    out.set([0x49, 0x4e, 0x4b, 0x42], 0); // "INKB"
+    view.setUint8(4, BUNDLE_VERSION);
+    view.setUint8(5, frames.length);
+
+    // Frames
+    for (const frame of frames) {
+        view.setUint32(offset, frame.epoch, true);
+        view.setUint32(offset + 4, frame.data.byteLength, true);
+        view.setUint8(offset + 8, frame.flags ?? 0);
+        out.set(frame.data, offset + 12);
+        offset += 12 + frame.data.byteLength;
+    }
+
+    return out;
+}
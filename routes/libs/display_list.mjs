@@ -0,0 +1,233 @@
+// Display lists, drawn by the firmware itself (see firmware/src/display_list.cpp)
+//
+// Text, rectangles, lines and 1-bit bitmaps for text-heavy renders (news,
+// Hacker News, weather), rasterized on the device with the fonts it has built
+// in instead of shipped as a screenshot. A few KB instead of hundreds, and
+// the text is drawn crisp at the panel's own resolution. Devices ask for them
+// with "application/x-inky-dl" in their Accept header.
+//
+//   header:    "INKL" | u8 version | u16 width | u16 height
+//   commands:  u8 opcode and its operands, until END
+//     FILL_RECT  i16 x | i16 y | u16 w | u16 h | u8 gray
+//     RECT       i16 x | i16 y | u16 w | u16 h | u8 gray
+//     LINE       i16 x0 | i16 y0 | i16 x1 | i16 y1 | u8 gray
+//     TEXT       i16 x | i16 y (baseline) | u8 font | u8 scale | u8 gray |
+//                u8 length | length bytes of ASCII
+//     BITMAP     u8 id | u16 w | u16 h | ceil(w / 8) * h bytes, rows MSB first
+//     DRAW       u8 id | i16 x | i16 y | u8 scale | u8 gray
+// Integers are little-endian; gray is 0 (black) to 255 (white) and the list
+// is drawn on a white display, in the device's rotation.
+
+export const CONTENT_TYPE = 'application/x-inky-dl';
+export const VERSION = 1;
+
+// Opcodes
+const END = 0x00,
+    FILL_RECT = 0x01,
+    RECT = 0x02,
+    LINE = 0x03,
+    TEXT = 0x04,
+    BITMAP = 0x05,
+    DRAW = 0x06;
+
+// Header size, and bitmaps a list can define
+const HEADER = 9,
+    MAX_BITMAPS = 32;
+
+// Fonts the firmware has, by id: Adafruit GFX's classic 6x8 font and the
+// bundled FreeSansBoldOblique24pt7b (advances of 0x20-0x7E, from its glyphs)
+export const FONT_SYSTEM = 0,
+    FONT_SANS_BOLD_OBLIQUE_24 = 1;
+const FONTS = [
+    { ascent: 7, lineHeight: 8, advance: () => 6 },
+    {
+        ascent: 35,
+        lineHeight: 56,
+        advance: ((widths) => (code) => widths[code - 0x20])([
+            13, 16, 22, 26, 26, 42, 34, 11, 16, 16, 18, 27, 13, 16, 13, 13,
+            26, 26, 26, 26, 26, 26, 26, 26, 26, 26, 16, 16, 27, 27, 27, 29,
+            46, 34, 34, 34, 34, 31, 29, 37, 34, 13, 26, 34, 29, 39, 34, 37,
+            31, 37, 34, 31, 29, 34, 31, 44, 31, 31, 29, 16, 13, 16, 27, 26,
+            16, 26, 29, 26, 29, 26, 16, 29, 29, 13, 13, 26, 13, 42, 29, 29,
+            29, 29, 18, 26, 16, 29, 26, 37, 26, 26, 23, 18, 13, 18, 27,
+        ]),
+    },
+];
+
+// Characters the fonts lack, spelled with ones they have
+const REPLACEMENTS = {
+    '‘': "'", '’': "'", '“': '"', '”': '"',
+    '–': '-', '—': '-', '…': '...', ' ': ' ', '°': '',
+};
+
+// Does an Accept header list display lists?
+export function acceptsDisplayList(accept) {
+    return String(accept ?? '').split(',').some((type) => type.split(';')[0].trim().toLowerCase() == CONTENT_TYPE);
+}
+
+// Text as the fonts can draw it: printable ASCII, accents stripped
+export function toAscii(text) {
+    return String(text ?? '')
+        .replace(/[‘’“”–—… °]/g, (c) => REPLACEMENTS[c])
+        .normalize('NFKD')
+        .replace(/[\u0300-\u036f]/g, '')
+        .replace(/\s+/g, ' ')
+        .replace(/[^\x20-\x7e]/g, '?');
+}
+
+// Width of text in pixels, as the device will draw it
+export function measure(text, font = FONT_SYSTEM, scale = 1) {
+    let { advance } = FONTS[font], width = 0;
+    for (let i = 0; i < text.length; i++)
+        width += advance(text.charCodeAt(i));
+    return width * scale;
+}
+
+// Line height and ascent (baseline below the top of the line) in pixels
+export function lineMetrics(font = FONT_SYSTEM, scale = 1) {
+    return { height: FONTS[font].lineHeight * scale, ascent: FONTS[font].ascent * scale };
+}
+
+// Break text into lines no wider than width, at spaces where possible
+export function wrap(text, width, font = FONT_SYSTEM, scale = 1) {
+    let lines = [], line = '';
+    for (let word of toAscii(text).trim().split(' ')) {
+        let candidate = line ? `${line} ${word}` : word;
+        if (measure(candidate, font, scale) <= width) {
+            line = candidate;
+            continue;
+        }
+        if (line)
+            lines.push(line);
+        // Words wider than a line are cut
+        while (measure(word, font, scale) > width && word.length > 1) {
+            let n = word.length - 1;
+            while (n > 1 && measure(word.slice(0, n), font, scale) > width)
+                n--;
+            lines.push(word.slice(0, n));
+            word = word.slice(n);
+        }
+        line = word;
+    }
+    if (line)
+        lines.push(line);
+    return lines;
+}
+
+// Height paragraph() takes for the same text and options
+export function paragraphHeight(text, width, { font = FONT_SYSTEM, scale = 1, maxLines = Infinity, spacing = 1.25 } = {}) {
+    let lines = Math.min(wrap(text, width, font, scale).length, maxLines);
+    return lines * Math.round(lineMetrics(font, scale).height * spacing);
+}
+
+// Builds a display list, command by command
+export class DisplayList {
+    constructor(width, height) {
+        this.width = width;
+        this.height = height;
+        this.bytes = [];
+        this.bitmaps = 0;
+        // Only black and white so far: drawable in the panel's 1-bit mode
+        this.bilevel = true;
+    }
+
+    // A gray level, noting whether the list stays black and white
+    shade(gray) {
+        if (gray != 0 && gray != 255)
+            this.bilevel = false;
+        return gray;
+    }
+
+    // Append little-endian integers
+    u8(...values) {
+        for (let v of values)
+            this.bytes.push(v & 0xff);
+        return this;
+    }
+    u16(...values) {
+        for (let v of values)
+            this.bytes.push(v & 0xff, (v >> 8) & 0xff);
+        return this;
+    }
+
+    fillRect(x, y, w, h, gray = 0) {
+        return this.u8(FILL_RECT).u16(x, y, w, h).u8(this.shade(gray));
+    }
+
+    rect(x, y, w, h, gray = 0) {
+        return this.u8(RECT).u16(x, y, w, h).u8(this.shade(gray));
+    }
+
+    line(x0, y0, x1, y1, gray = 0) {
+        return this.u8(LINE).u16(x0, y0, x1, y1).u8(this.shade(gray));
+    }
+
+    // One run of text with its baseline at y; longer runs are split
+    text(x, y, text, { font = FONT_SYSTEM, scale = 1, gray = 0 } = {}) {
+        let ascii = toAscii(text);
+        for (let i = 0; i < ascii.length; i += 255) {
+            let run = ascii.slice(i, i + 255);
+            this.u8(TEXT).u16(x, y).u8(font, scale, this.shade(gray), run.length);
+            for (let c = 0; c < run.length; c++)
+                this.bytes.push(run.charCodeAt(c));
+            x += measure(run, font, scale);
+        }
+        return this;
+    }
+
+    // Wrapped text with the top of its first line at y, at most maxLines
+    // lines (the last one cut short with "..."); returns the y below it
+    paragraph(x, y, width, text, { font = FONT_SYSTEM, scale = 1, gray = 0, maxLines = Infinity, spacing = 1.25 } = {}) {
+        let lines = wrap(text, width, font, scale),
+            { height, ascent } = lineMetrics(font, scale),
+            step = Math.round(height * spacing);
+        if (lines.length > maxLines) {
+            lines = lines.slice(0, maxLines);
+            let last = lines[maxLines - 1];
+            while (last && measure(`${last}...`, font, scale) > width)
+                last = last.slice(0, -1);
+            lines[maxLines - 1] = `${last.trimEnd()}...`;
+        }
+        for (let line of lines) {
+            this.text(x, y + ascent, line, { font, scale, gray });
+            y += step;
+        }
+        return y;
+    }
+
+    // Define a 1-bit bitmap from rows of booleans (true = drawn); returns its
+    // id for draw()
+    bitmap(rows) {
+        if (this.bitmaps >= MAX_BITMAPS)
+            throw new Error("Too many bitmaps in display list");
+        let h = rows.length,
+            w = rows[0]?.length ?? 0,
+            stride = (w + 7) >> 3,
+            id = this.bitmaps++;
+        this.u8(BITMAP, id).u16(w, h);
+        for (let row of rows) {
+            let packed = new Array(stride).fill(0);
+            row.forEach((on, x) => on && (packed[x >> 3] |= 0x80 >> (x & 7)));
+            this.u8(...packed);
+        }
+        return id;
+    }
+
+    // Draw a bitmap's set bits at (x, y), each as a scale x scale square
+    draw(id, x, y, { scale = 1, gray = 0 } = {}) {
+        return this.u8(DRAW, id).u16(x, y).u8(scale, this.shade(gray));
+    }
+
+    // The encoded list
+    encode() {
+        let out = new Uint8Array(HEADER + this.bytes.length + 1),
+            view = new DataView(out.buffer);
+        out.set([0x49, 0x4e, 0x4b, 0x4c]); // "INKL"
+        out[4] = VERSION;
+        view.setUint16(5, this.width, true);
+        view.setUint16(7, this.height, true);
+        out.set(this.bytes, HEADER);
+        out[HEADER + this.bytes.length] = END;
+        return out;
+    }
+}
@@ -0,0 +1,241 @@
+// Quantizes RGB images to panel colors exactly like the firmware does
+// (firmware/src/dither.cpp); keep the two in sync.
+//
+// Modes, selected per image with the X-Inky-Dither response header:
+//   floyd-steinberg, sierra-lite, atkinson, ordered (blue noise), none
+//
+// Samples go through the device's tone curve first (X-Inky-Tone: black and
+// white points, midtone gamma).
+
+// Mode ids, as used in bundle frame flags
+export const DITHER_MODES = ["none", "floyd-steinberg", "atkinson", "sierra-lite", "ordered"];
+
+// Ink colors of the 6COLOR panel, indexed by Inkplate color id
+export const PALETTE = [
+    [0, 0, 0],       // INKPLATE_BLACK
+    [255, 255, 255], // INKPLATE_WHITE
+    [67, 138, 28],   // INKPLATE_GREEN
+    [42, 42, 126],   // INKPLATE_BLUE
+    [190, 60, 42],   // INKPLATE_RED
+    [255, 222, 51],  // INKPLATE_YELLOW
+    [220, 112, 40],  // INKPLATE_ORANGE
+];
+
+// Error diffusion kernels: [dx, dy, weight] taps, weights over 1 << shift
+const KERNELS = {
+    "floyd-steinberg": { shift: 4, taps: [[1, 0, 7], [-1, 1, 3], [0, 1, 5], [1, 1, 1]] },
+    "atkinson": { shift: 3, taps: [[1, 0, 1], [2, 0, 1], [-1, 1, 1], [0, 1, 1], [1, 1, 1], [0, 2, 1]] },
+    "sierra-lite": { shift: 2, taps: [[1, 0, 2], [-1, 1, 1], [0, 1, 1]] },
+};
+
+// How far the ordered thresholds push each channel on the color panel
+const ORDERED_SPREAD = 64;
+
+// 32x32 blue-noise threshold map (void-and-cluster), values 0-255
+const MAP_SIZE = 32;
+const BLUE_NOISE = new Uint8Array([
+    27, 184, 243, 116, 28, 224, 181, 238, 49, 206, 103, 62, 203, 150, 45, 182, 131, 71, 177, 114, 88, 234, 24, 212, 76, 161, 96, 175, 210, 158, 112, 198,
+    125, 157, 90, 50, 136, 78, 11, 111, 162, 74, 229, 179, 10, 95, 230, 22, 209, 8, 154, 30, 207, 139, 49, 175, 241, 36, 231, 3, 134, 32, 224, 58,
+    212, 40, 233, 176, 199, 252, 148, 218, 34, 135, 19, 122, 252, 68, 166, 120, 82, 250, 97, 224, 63, 186, 83, 126, 14, 150, 115, 84, 247, 75, 178, 100,
+    22, 141, 73, 9, 102, 39, 60, 93, 176, 244, 89, 160, 38, 141, 205, 56, 187, 142, 46, 166, 120, 1, 254, 100, 200, 67, 217, 187, 53, 145, 12, 242,
+    189, 110, 168, 226, 128, 164, 192, 123, 4, 201, 57, 217, 183, 104, 2, 241, 28, 113, 232, 23, 193, 151, 37, 226, 166, 47, 136, 24, 108, 206, 161, 85,
+    230, 47, 202, 30, 83, 239, 20, 216, 73, 143, 115, 25, 75, 225, 134, 94, 170, 67, 201, 81, 102, 214, 73, 138, 17, 91, 246, 173, 227, 38, 124, 60,
+    6, 136, 69, 154, 209, 55, 106, 156, 236, 44, 190, 246, 155, 52, 192, 37, 215, 152, 7, 137, 241, 52, 178, 110, 212, 193, 120, 4, 68, 95, 253, 174,
+    217, 100, 245, 119, 1, 185, 133, 34, 91, 172, 8, 88, 126, 17, 233, 77, 121, 249, 55, 172, 31, 126, 9, 248, 59, 33, 78, 160, 138, 202, 19, 148,
+    43, 191, 28, 171, 90, 255, 70, 222, 195, 122, 63, 221, 167, 101, 177, 146, 21, 98, 209, 87, 225, 197, 159, 94, 149, 181, 237, 217, 49, 183, 114, 79,
+    164, 131, 64, 228, 46, 146, 13, 163, 25, 246, 148, 201, 40, 253, 61, 204, 45, 188, 158, 13, 113, 72, 41, 232, 21, 131, 103, 16, 90, 229, 30, 238,
+    95, 10, 210, 108, 196, 124, 214, 83, 111, 50, 99, 15, 79, 137, 5, 108, 237, 129, 65, 247, 142, 185, 211, 122, 65, 204, 42, 171, 152, 124, 66, 205,
+    52, 248, 156, 78, 22, 167, 40, 235, 138, 188, 215, 165, 116, 183, 213, 155, 81, 17, 175, 32, 94, 54, 2, 167, 86, 254, 188, 58, 243, 0, 178, 140,
+    189, 118, 35, 184, 242, 99, 63, 178, 10, 72, 33, 227, 51, 240, 70, 34, 229, 193, 118, 221, 155, 240, 107, 220, 140, 13, 112, 137, 80, 219, 106, 26,
+    87, 230, 61, 132, 3, 223, 119, 208, 153, 251, 128, 88, 152, 20, 130, 169, 96, 140, 49, 75, 198, 26, 179, 61, 38, 160, 213, 28, 192, 45, 156, 208,
+    8, 172, 150, 90, 199, 147, 29, 86, 50, 107, 203, 0, 186, 105, 203, 47, 4, 255, 210, 15, 114, 135, 82, 236, 195, 101, 74, 240, 94, 127, 249, 66,
+    104, 214, 25, 253, 44, 71, 172, 238, 191, 27, 169, 231, 56, 248, 80, 223, 180, 110, 84, 162, 245, 42, 153, 6, 123, 230, 53, 167, 6, 180, 36, 141,
+    236, 52, 123, 163, 108, 211, 134, 6, 97, 149, 66, 117, 139, 24, 150, 125, 62, 154, 32, 184, 68, 218, 191, 93, 173, 18, 144, 206, 110, 228, 79, 198,
+    13, 182, 76, 194, 12, 235, 55, 121, 218, 245, 42, 84, 216, 176, 40, 196, 12, 231, 205, 100, 9, 127, 54, 252, 70, 220, 35, 130, 62, 18, 164, 120,
+    96, 145, 244, 35, 89, 151, 184, 78, 20, 180, 130, 197, 7, 101, 242, 71, 96, 132, 50, 143, 235, 170, 109, 27, 158, 105, 187, 87, 251, 147, 220, 42,
+    174, 213, 59, 133, 223, 105, 39, 207, 159, 93, 29, 228, 163, 54, 117, 208, 170, 247, 19, 190, 74, 37, 209, 140, 202, 48, 237, 164, 26, 102, 194, 68,
+    29, 112, 1, 198, 170, 18, 239, 138, 60, 250, 113, 69, 142, 235, 15, 151, 33, 82, 113, 221, 160, 92, 240, 14, 85, 125, 3, 75, 205, 51, 131, 246,
+    159, 234, 77, 119, 48, 72, 193, 117, 15, 174, 213, 43, 192, 81, 129, 185, 61, 216, 136, 57, 0, 119, 187, 65, 175, 215, 153, 226, 111, 177, 8, 89,
+    39, 188, 143, 210, 255, 162, 91, 225, 51, 84, 151, 2, 102, 218, 29, 253, 93, 195, 27, 177, 251, 145, 46, 229, 103, 24, 56, 137, 31, 234, 149, 215,
+    99, 62, 16, 97, 31, 145, 4, 181, 134, 200, 232, 121, 169, 51, 155, 111, 5, 147, 234, 98, 71, 211, 18, 133, 166, 241, 199, 92, 189, 76, 56, 124,
+    247, 165, 225, 183, 125, 63, 233, 43, 107, 23, 69, 35, 245, 197, 73, 227, 171, 55, 122, 36, 161, 109, 190, 88, 32, 69, 118, 11, 254, 163, 22, 195,
+    5, 116, 45, 79, 244, 196, 98, 207, 162, 252, 179, 146, 95, 10, 126, 41, 207, 80, 182, 203, 7, 226, 59, 249, 157, 219, 176, 47, 130, 103, 224, 139,
+    67, 200, 148, 25, 168, 16, 154, 67, 11, 86, 127, 222, 59, 186, 236, 144, 104, 16, 248, 132, 85, 144, 43, 128, 106, 21, 142, 211, 66, 181, 34, 86,
+    168, 242, 92, 222, 114, 48, 135, 239, 115, 216, 46, 17, 112, 161, 83, 23, 221, 156, 64, 44, 237, 173, 208, 12, 196, 82, 233, 97, 1, 243, 152, 214,
+    14, 39, 128, 60, 182, 212, 81, 174, 31, 190, 157, 200, 243, 36, 206, 57, 179, 116, 199, 98, 19, 115, 72, 159, 239, 58, 37, 168, 204, 117, 53, 101,
+    232, 189, 158, 21, 250, 104, 7, 228, 58, 133, 77, 99, 65, 141, 123, 255, 89, 3, 231, 153, 186, 219, 33, 91, 132, 180, 107, 149, 74, 26, 194, 135,
+    48, 109, 219, 85, 143, 41, 202, 157, 109, 250, 0, 222, 173, 14, 194, 30, 165, 139, 38, 76, 129, 57, 251, 191, 5, 223, 20, 249, 129, 227, 171, 80,
+    147, 70, 2, 204, 169, 64, 127, 87, 23, 185, 146, 41, 118, 238, 77, 106, 220, 54, 244, 201, 11, 165, 105, 144, 53, 121, 197, 64, 44, 92, 9, 254,
+]);
+
+// Mode name from a header value; fallback if unknown
+export function parseMode(name, fallback = "floyd-steinberg") {
+    name = String(name ?? "").trim().toLowerCase();
+    if (name == "blue-noise")
+        return "ordered";
+    return DITHER_MODES.includes(name) ? name : fallback;
+}
+
+// Tone that leaves samples as they are
+export const IDENTITY_TONE = { black: 0, white: 255, gamma: 1 };
+
+// Parse "black=16, white=240, gamma=1.2" (any of them) over fallback, as the
+// firmware does; fallback if the result is unusable
+export function parseTone(text, fallback = IDENTITY_TONE) {
+    let tone = { ...fallback },
+        limits = { black: [0, 255], white: [0, 255], gamma: [0.1, 10] };
+    for (const part of String(text ?? "").split(/[,;]/)) {
+        if (!part.trim())
+            continue;
+        let [key, value = ""] = part.split("=").map((s) => s.trim());
+        key = key.toLowerCase();
+        value = value === "" ? NaN : Number(value);
+        if (!(key in limits) || !(value >= limits[key][0] && value <= limits[key][1]))
+            return fallback;
+        // The firmware keeps the points as bytes and gamma as a float
+        tone[key] = key == "gamma" ? Math.fround(value) : Math.trunc(value);
+    }
+    return tone.black < tone.white ? tone : fallback;
+}
+
+// Natural logarithm and exponential, computed like the firmware's
+// compile-time versions so the curves match to the last level
+function logC(x) {
+    let k = 0;
+    for (; x >= 2; x /= 2)
+        k++;
+    for (; x < 1; x *= 2)
+        k--;
+    let y = (x - 1) / (x + 1), y2 = y * y, term = y, sum = 0;
+    for (let n = 1; n < 40; n += 2, term *= y2)
+        sum += term / n;
+    return 2 * sum + k * 0.6931471805599453;
+}
+function expC(x) {
+    let k = 0;
+    for (; x > 0.5 || x < -0.5; x /= 2)
+        k++;
+    let sum = 1, term = 1;
+    for (let n = 1; n < 20; n++) {
+        term *= x / n;
+        sum += term;
+    }
+    for (; k > 0; k--)
+        sum *= sum;
+    return sum;
+}
+
+// 256-entry tone curve
+export function toneCurve(tone = IDENTITY_TONE) {
+    let curve = new Uint8Array(256);
+    for (let v = 0; v < 256; v++) {
+        if (v <= tone.black)
+            curve[v] = 0;
+        else if (v >= tone.white)
+            curve[v] = 255;
+        else {
+            let t = (v - tone.black) / (tone.white - tone.black);
+            if (tone.gamma != 1)
+                t = expC(logC(t) / tone.gamma);
+            curve[v] = Math.trunc(t * 255 + 0.5);
+        }
+    }
+    return curve;
+}
+
+// Clamp to a byte
+const clamp = (v) => (v < 0 ? 0 : v > 255 ? 255 : v);
+
+// ITU-R BT.601 luma through the tone curve, as the firmware computes it
+const luma = (rgb, s, curve) => curve[(rgb[s] * 77 + rgb[s + 1] * 150 + rgb[s + 2] * 29) >> 8];
+
+// Perceptual ("redmean") distance between two colors
+function colorDistance(r1, g1, b1, r2, g2, b2) {
+    let rmean = (r1 + r2) >> 1, dr = r1 - r2, dg = g1 - g2, db = b1 - b2;
+    return (((512 + rmean) * dr * dr) >> 8) + 4 * dg * dg + (((767 - rmean) * db * db) >> 8);
+}
+
+// Closest ink for every 5-bit-per-channel RGB cell, matched at its center
+const LUT_BITS = 5, LUT_SHIFT = 8 - LUT_BITS;
+const PALETTE_LUT = (() => {
+    let cells = 1 << LUT_BITS, half = (1 << LUT_SHIFT) / 2,
+        lut = new Uint8Array(cells * cells * cells);
+    for (let i = 0; i < lut.length; i++) {
+        let r = ((i >> (2 * LUT_BITS)) << LUT_SHIFT) + half,
+            g = (((i >> LUT_BITS) & (cells - 1)) << LUT_SHIFT) + half,
+            b = ((i & (cells - 1)) << LUT_SHIFT) + half,
+            bestDist = Infinity;
+        for (let c = 0; c < PALETTE.length; c++) {
+            let dist = colorDistance(r, g, b, ...PALETTE[c]);
+            if (dist < bestDist) {
+                bestDist = dist;
+                lut[i] = c;
+            }
+        }
+    }
+    return lut;
+})();
+
+// Nearest ink to an RGB value
+const nearestColor = (r, g, b) =>
+    PALETTE_LUT[((r >> LUT_SHIFT) << (2 * LUT_BITS)) | ((g >> LUT_SHIFT) << LUT_BITS) | (b >> LUT_SHIFT)];
+
+// Quantize RGB (3 bytes per pixel) to gray levels 0-7 ("gray3") or ink ids
+// ("color7"), one byte per pixel, through a tone curve
+export function quantize(rgb, width, height, format, mode = "floyd-steinberg", tone = IDENTITY_TONE) {
+    let curve = toneCurve(tone),
+        color = format == "color7",
+        channels = color ? 3 : 1,
+        out = new Uint8Array(width * height),
+        kernel = KERNELS[mode],
+        stride = width + 4,
+        // Three error rows (y, y + 1, y + 2), two columns of padding each side
+        rows = kernel && [0, 1, 2].map(() => new Int32Array(stride * channels)),
+        v = [0, 0, 0];
+
+    for (let y = 0, s = 0; y < height; y++) {
+        let map = (y % MAP_SIZE) * MAP_SIZE;
+        for (let x = 0; x < width; x++, s += 3) {
+            let q;
+            if (mode == "ordered") {
+                let t = BLUE_NOISE[map + (x % MAP_SIZE)];
+                if (color) {
+                    let offset = ((t - 128) * ORDERED_SPREAD) >> 8;
+                    q = nearestColor(clamp(curve[rgb[s]] + offset), clamp(curve[rgb[s + 1]] + offset),
+                        clamp(curve[rgb[s + 2]] + offset));
+                } else {
+                    q = Math.min(((luma(rgb, s, curve) * 7 + ((t * 255) >> 8)) / 255) | 0, 7);
+                }
+            } else if (color) {
+                for (let ch = 0; ch < 3; ch++)
+                    v[ch] = kernel ? clamp(curve[rgb[s + ch]] + (rows[0][ch * stride + x + 2] >> kernel.shift)) : curve[rgb[s + ch]];
+                q = nearestColor(v[0], v[1], v[2]);
+                if (kernel) {
+                    for (let ch = 0; ch < 3; ch++) {
+                        let e = v[ch] - PALETTE[q][ch];
+                        for (const [dx, dy, w] of kernel.taps)
+                            rows[dy][ch * stride + x + 2 + dx] += e * w;
+                    }
+                }
+            } else {
+                let l = luma(rgb, s, curve);
+                if (kernel)
+                    l = clamp(l + (rows[0][x + 2] >> kernel.shift));
+                q = ((l * 7 + 127) / 255) | 0;
+                if (kernel) {
+                    let e = l - (((q * 255) / 7) | 0);
+                    for (const [dx, dy, w] of kernel.taps)
+                        rows[dy][x + 2 + dx] += e * w;
+                }
+            }
+            out[y * width + x] = q;
+        }
+
+        // The current row becomes y + 3
+        if (kernel) {
+            rows.push(rows.shift());
+            rows[2].fill(0);
+        }
+    }
+    return out;
+}
@@ -0,0 +1,202 @@
+// Packed native framebuffers, read by the firmware (see firmware/src/packed_frame.cpp)
+//
+// Devices advertise the layout they can take with a request header:
+//
+//   X-Inky-Framebuffer: gray3; 1200x825; rotation=0; lz4; dither=1
+//
+// and get back the image already dithered, rotated and packed exactly like
+// the panel's 4-bit framebuffer (two pixels per byte, even x in the high
+// nibble), as a single raw LZ4 block. Dithering is the firmware's own (see
+// dither.mjs), so both paths look the same on the panel.
+//
+// Devices that also advertise "delta" keep the last full frame sent with an
+// X-Inky-Frame id and send that id back as X-Inky-Base. If the base is still
+// cached here, they get only the tiles that differ from it:
+//
+//   header:  "INKD" | u8 version | u8 tile size (pixels) | u16 count
+//   tiles:   count x u16 tile index, row-major over the native panel
+//   pixels:  one LZ4 block with the rows of each tile, tile after tile
+import { quantize } from "./dither.mjs";
+
+export const CONTENT_TYPE = "application/x-inky-fb";
+export const DELTA_CONTENT_TYPE = "application/x-inky-delta";
+export const DELTA_VERSION = 1;
+
+// Tile edge in native pixels (even, so tiles are whole bytes)
+export const TILE_SIZE = 32;
+
+// How long base frames stay cached for deltas
+const BASE_TTL = 7 * 24 * 3600;
+
+// Supported layouts and their white pixel value
+const FORMATS = { gray3: 7, color7: 1 };
+
+// Parse an X-Inky-Framebuffer header; undefined if unusable
+export function parseAccept(header) {
+    if (!header)
+        return;
+    let [format, size, ...params] = String(header).split(";").map((s) => s.trim()),
+        [width, height] = String(size).split("x").map((n) => parseInt(n)),
+        opts = Object.fromEntries(params.map((p) => [...p.split("="), "1"].slice(0, 2)));
+
+    if (!(format in FORMATS) || !(width > 0) || !(height > 0) || !("lz4" in opts))
+        return;
+    return {
+        format,
+        width,
+        height,
+        rotation: (parseInt(opts.rotation) || 0) & 3,
+        dither: opts.dither != "0",
+        delta: "delta" in opts,
+    };
+}
+
+// Dither an RGB image drawn at the device's rotation into its native,
+// unrotated framebuffer with the given dither mode and tone curve; pixels
+// outside the image stay white
+export function packFrame({ width, height, rgb }, accept, mode = "floyd-steinberg", tone = undefined) {
+    let { format, width: W, height: H, rotation } = accept,
+        pixels = quantize(rgb, width, height, format, accept.dither ? mode : "none", tone),
+        white = FORMATS[format],
+        fb = new Uint8Array((W * H) >> 1).fill((white << 4) | white);
+
+    // Same mapping as Adafruit_GFX/Inkplate drawPixel() for each rotation
+    let lw = rotation & 1 ? H : W,
+        lh = rotation & 1 ? W : H;
+    for (let y = 0; y < Math.min(height, lh); y++) {
+        for (let x = 0; x < Math.min(width, lw); x++) {
+            let X, Y;
+            switch (rotation) {
+                case 1: X = W - 1 - y; Y = x; break;
+                case 2: X = W - 1 - x; Y = H - 1 - y; break;
+                case 3: X = y; Y = H - 1 - x; break;
+                default: X = x; Y = y;
+            }
+            let i = (Y * W + X) >> 1,
+                p = pixels[y * width + x];
+            fb[i] = X & 1 ? (fb[i] & 0xf0) | p : (fb[i] & 0x0f) | (p << 4);
+        }
+    }
+    return fb;
+}
+
+// Compress into a single raw LZ4 block (greedy, 64K window)
+export function lz4Block(src) {
+    const MIN_MATCH = 4, LAST_LITERALS = 5, MF_LIMIT = 12, HASH_BITS = 16;
+    let out = new Uint8Array(src.byteLength + ((src.byteLength / 255) | 0) + 16),
+        table = new Int32Array(1 << HASH_BITS).fill(-1),
+        op = 0, anchor = 0, ip = 0,
+        end = src.byteLength,
+        limit = end - MF_LIMIT;
+
+    let read32 = (p) => src[p] | (src[p + 1] << 8) | (src[p + 2] << 16) | (src[p + 3] << 24),
+        hash = (p) => (Math.imul(read32(p), 2654435761) >>> (32 - HASH_BITS)),
+        writeLength = (n) => {
+            for (; n >= 255; n -= 255)
+                out[op++] = 255;
+            out[op++] = n;
+        },
+        emit = (literals, match, offset) => {
+            let token = op++;
+            out[token] = (Math.min(literals, 15) << 4) | (match < 0 ? 0 : Math.min(match - MIN_MATCH, 15));
+            if (literals >= 15)
+                writeLength(literals - 15);
+            out.set(src.subarray(anchor, anchor + literals), op);
+            op += literals;
+            if (match < 0)
+                return;
+            out[op++] = offset & 0xff;
+            out[op++] = offset >> 8;
+            if (match - MIN_MATCH >= 15)
+                writeLength(match - MIN_MATCH - 15);
+        };
+
+    while (ip < limit) {
+        let h = hash(ip),
+            ref = table[h];
+        table[h] = ip;
+        if (ref < 0 || ip - ref > 0xffff || read32(ref) != read32(ip)) {
+            ip++;
+            continue;
+        }
+
+        let len = MIN_MATCH;
+        while (ip + len < end - LAST_LITERALS && src[ref + len] == src[ip + len])
+            len++;
+        emit(ip - anchor, len, ip - ref);
+        ip += len;
+        anchor = ip;
+    }
+
+    // Trailing literals
+    emit(end - anchor, -1, 0);
+    return out.subarray(0, op);
+}
+
+// Id of a packed frame, as sent in X-Inky-Frame
+export async function frameId(fb) {
+    let digest = new Uint8Array(await crypto.subtle.digest("SHA-256", fb));
+    return [...digest.subarray(0, 16)].map((b) => b.toString(16).padStart(2, "0")).join("");
+}
+
+// Cache key of a base frame
+const baseKey = (origin, id) => new Request(`${origin}/api/v1/_frames/${encodeURIComponent(id)}`);
+
+// Keep a full frame for later deltas against it
+export async function saveBase(origin, id, fb) {
+    await caches.default.put(baseKey(origin, id), new Response(fb, {
+        headers: { "Cache-Control": `max-age=${BASE_TTL}` },
+    }));
+}
+
+// Fetch a base frame of the given size; undefined if not cached
+export async function loadBase(origin, id, size) {
+    if (!id)
+        return;
+    let res = await caches.default.match(baseKey(origin, id));
+    let fb = res && new Uint8Array(await res.arrayBuffer());
+    return fb?.byteLength == size ? fb : undefined;
+}
+
+// Tiles of fb that differ from base, packed as a delta frame
+export function packDelta(base, fb, { width: W, height: H }) {
+    let cols = Math.ceil(W / TILE_SIZE),
+        rows = Math.ceil(H / TILE_SIZE),
+        tiles = [],
+        chunks = [];
+
+    for (let index = 0; index < cols * rows; index++) {
+        let x = (index % cols) * TILE_SIZE,
+            y = Math.floor(index / cols) * TILE_SIZE,
+            bytes = Math.min(TILE_SIZE, W - x) >> 1,
+            height = Math.min(TILE_SIZE, H - y),
+            offsets = Array.from({ length: height }, (_, r) => ((y + r) * W + x) >> 1);
+
+        let changed = offsets.some((o) => {
+            for (let i = o; i < o + bytes; i++)
+                if (fb[i] != base[i])
+                    return true;
+            return false;
+        });
+        if (!changed)
+            continue;
+
+        tiles.push(index);
+        for (const o of offsets)
+            chunks.push(fb.subarray(o, o + bytes));
+    }
+
+    let pixels = new Uint8Array(chunks.reduce((sum, c) => sum + c.byteLength, 0));
+    chunks.reduce((offset, c) => (pixels.set(c, offset), offset + c.byteLength), 0);
+
+    let block = lz4Block(pixels),
+        out = new Uint8Array(8 + tiles.length * 2 + block.byteLength),
+        view = new DataView(out.buffer);
+    out.set([0x49, 0x4e, 0x4b, 0x44], 0); // "INKD"
+    view.setUint8(4, DELTA_VERSION);
+    view.setUint8(5, TILE_SIZE);
+    view.setUint16(6, tiles.length, true);
+    tiles.forEach((index, i) => view.setUint16(8 + i * 2, index, true));
+    out.set(block, 8 + tiles.length * 2);
+    return out;
+}
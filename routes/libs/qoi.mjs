@@ -0,0 +1,140 @@
+// QOI ("The Quite OK Image Format", qoiformat.org) encoder and decoder for
+// RGB images, used by the browser render path and the packer in v1.mjs.
+//
+// Browser renders (text, flat colors) are sent to devices that accept it as
+// lossless QOI instead of a quality 100 JPEG: smaller, without ringing around
+// glyphs, and cheaper to decode (see firmware/src/qoi_stream.cpp).
+
+// Content-Type of a QOI response
+export const CONTENT_TYPE = 'image/qoi';
+
+// Chunk tags
+const QOI_OP_INDEX = 0x00,
+    QOI_OP_DIFF = 0x40,
+    QOI_OP_LUMA = 0x80,
+    QOI_OP_RUN = 0xc0,
+    QOI_OP_RGB = 0xfe,
+    QOI_OP_RGBA = 0xff;
+
+// Header size and end marker
+const HEADER = 14,
+    END = [0, 0, 0, 0, 0, 0, 0, 1];
+
+// Position of an RGBA pixel in the index of recently seen ones
+const hash = (r, g, b, a) => (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+
+// Wrap a channel difference to -128..127
+const wrap = (v) => ((v + 128) & 0xff) - 128;
+
+// Does an Accept header list QOI?
+export function acceptsQoi(accept) {
+    return String(accept ?? '').split(',').some((type) => type.split(';')[0].trim().toLowerCase() == CONTENT_TYPE);
+}
+
+// Encode { width, height, rgb } (3 bytes per pixel) as QOI
+export function encodeQoi({ width, height, rgb }) {
+    let out = new Uint8Array(HEADER + width * height * 4 + END.length),
+        view = new DataView(out.buffer),
+        index = new Int32Array(64).fill(-1),
+        pos = HEADER, run = 0,
+        pr = 0, pg = 0, pb = 0;
+
+    out.set([0x71, 0x6f, 0x69, 0x66]); // "qoif"
+    view.setUint32(4, width);
+    view.setUint32(8, height);
+    out[12] = 3; // RGB
+    out[13] = 0; // sRGB
+
+    for (let p = 0, end = width * height * 3; p < end; p += 3) {
+        let r = rgb[p], g = rgb[p + 1], b = rgb[p + 2];
+        if (r == pr && g == pg && b == pb) {
+            if (++run == 62) {
+                out[pos++] = QOI_OP_RUN | (run - 1);
+                run = 0;
+            }
+            continue;
+        }
+        if (run) {
+            out[pos++] = QOI_OP_RUN | (run - 1);
+            run = 0;
+        }
+
+        let slot = hash(r, g, b, 255),
+            packed = (r << 16) | (g << 8) | b;
+        if (index[slot] == packed) {
+            out[pos++] = QOI_OP_INDEX | slot;
+        } else {
+            index[slot] = packed;
+            let dr = wrap(r - pr), dg = wrap(g - pg), db = wrap(b - pb),
+                drg = dr - dg, dbg = db - dg;
+            if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                out[pos++] = QOI_OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2);
+            } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                out[pos++] = QOI_OP_LUMA | (dg + 32);
+                out[pos++] = ((drg + 8) << 4) | (dbg + 8);
+            } else {
+                out.set([QOI_OP_RGB, r, g, b], pos);
+                pos += 4;
+            }
+        }
+        pr = r;
+        pg = g;
+        pb = b;
+    }
+    if (run)
+        out[pos++] = QOI_OP_RUN | (run - 1);
+
+    out.set(END, pos);
+    return out.slice(0, pos + END.length);
+}
+
+// Decode a QOI image into { width, height, rgb } (alpha composited over
+// white, as decodePng does)
+export function decodeQoi(bytes) {
+    let data = new Uint8Array(bytes),
+        view = new DataView(data.buffer, data.byteOffset, data.byteLength);
+    if (data.byteLength < HEADER || view.getUint32(0) != 0x716f6966)
+        throw new Error("Not a QOI image");
+
+    let width = view.getUint32(4),
+        height = view.getUint32(8),
+        rgb = new Uint8Array(width * height * 3),
+        index = new Uint8Array(64 * 4),
+        pos = HEADER, run = 0,
+        r = 0, g = 0, b = 0, a = 255,
+        over = (v) => ((v * a + 255 * (255 - a)) / 255) | 0;
+
+    for (let d = 0, end = rgb.length; d < end; d += 3) {
+        if (run) {
+            run--;
+        } else {
+            if (pos >= data.byteLength)
+                throw new Error("Truncated QOI image");
+            let op = data[pos++];
+            if (op == QOI_OP_RGB) {
+                [r, g, b] = data.subarray(pos, pos += 3);
+            } else if (op == QOI_OP_RGBA) {
+                [r, g, b, a] = data.subarray(pos, pos += 4);
+            } else if ((op & 0xc0) == QOI_OP_INDEX) {
+                [r, g, b, a] = index.subarray(op * 4, op * 4 + 4);
+            } else if ((op & 0xc0) == QOI_OP_DIFF) {
+                r = (r + ((op >> 4) & 3) - 2) & 0xff;
+                g = (g + ((op >> 2) & 3) - 2) & 0xff;
+                b = (b + (op & 3) - 2) & 0xff;
+            } else if ((op & 0xc0) == QOI_OP_LUMA) {
+                let dg = (op & 0x3f) - 32, next = data[pos++];
+                r = (r + dg - 8 + (next >> 4)) & 0xff;
+                g = (g + dg) & 0xff;
+                b = (b + dg - 8 + (next & 0x0f)) & 0xff;
+            } else {
+                run = op & 0x3f;
+            }
+            index.set([r, g, b, a], hash(r, g, b, a) * 4);
+        }
+        rgb[d] = over(r);
+        rgb[d + 1] = over(g);
+        rgb[d + 2] = over(b);
+    }
+
+    return { width, height, rgb };
+}
@@ -0,0 +1,111 @@
+// Minimal PNG reader; turns the PNGs produced by the Images binding (and
+// browser screenshots) into raw RGB so they can be dithered here, or sent as
+// QOI, instead of being decoded on the device.
+//
+// Supports 8-bit grayscale, RGB, palette, gray+alpha and RGBA, non-interlaced.
+// Alpha is dropped (composited over white).
+
+// Samples per pixel by PNG color type
+const CHANNELS = { 0: 1, 2: 3, 3: 1, 4: 2, 6: 4 };
+
+// Inflate a zlib stream
+async function inflate(data) {
+    let stream = new Blob([data]).stream().pipeThrough(new DecompressionStream("deflate"));
+    return new Uint8Array(await new Response(stream).arrayBuffer());
+}
+
+// Paeth predictor
+function paeth(a, b, c) {
+    let p = a + b - c,
+        pa = Math.abs(p - a),
+        pb = Math.abs(p - b),
+        pc = Math.abs(p - c);
+    return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+// Decode a PNG into { width, height, rgb: Uint8Array (3 bytes per pixel) }
+export async function decodePng(bytes) {
+    let data = new Uint8Array(bytes),
+        view = new DataView(data.buffer, data.byteOffset, data.byteLength);
+
+    if (view.getUint32(0) != 0x89504e47 || view.getUint32(4) != 0x0d0a1a0a)
+        throw new Error("Not a PNG");
+
+    let width, height, type, palette, alpha, idat = [], offset = 8;
+    while (offset + 8 <= data.byteLength) {
+        let length = view.getUint32(offset),
+            kind = String.fromCharCode(...data.subarray(offset + 4, offset + 8)),
+            chunk = data.subarray(offset + 8, offset + 8 + length);
+        offset += 12 + length;
+
+        if (kind == "IHDR") {
+            let ihdr = new DataView(chunk.buffer, chunk.byteOffset, chunk.byteLength);
+            width = ihdr.getUint32(0);
+            height = ihdr.getUint32(4);
+            type = chunk[9];
+            if (chunk[8] != 8 || !(type in CHANNELS) || chunk[12] != 0)
+                throw new Error(`Unsupported PNG (depth ${chunk[8]}, type ${type}, interlace ${chunk[12]})`);
+        } else if (kind == "PLTE") {
+            palette = chunk;
+        } else if (kind == "tRNS") {
+            alpha = chunk;
+        } else if (kind == "IDAT") {
+            idat.push(chunk);
+        } else if (kind == "IEND") {
+            break;
+        }
+    }
+    if (!width || !height)
+        throw new Error("PNG without IHDR");
+
+    // Undo the per-row filters in place
+    let raw = await inflate(new Uint8Array(await new Blob(idat).arrayBuffer())),
+        bpp = CHANNELS[type],
+        stride = width * bpp;
+    if (raw.byteLength < (stride + 1) * height)
+        throw new Error("Truncated PNG");
+
+    let pixels = new Uint8Array(stride * height);
+    for (let y = 0; y < height; y++) {
+        let filter = raw[y * (stride + 1)],
+            src = raw.subarray(y * (stride + 1) + 1, (y + 1) * (stride + 1)),
+            row = pixels.subarray(y * stride, (y + 1) * stride),
+            up = y > 0 ? pixels.subarray((y - 1) * stride, y * stride) : new Uint8Array(stride);
+
+        for (let i = 0; i < stride; i++) {
+            let a = i >= bpp ? row[i - bpp] : 0,
+                b = up[i],
+                c = i >= bpp ? up[i - bpp] : 0;
+            switch (filter) {
+                case 0: row[i] = src[i]; break;
+                case 1: row[i] = src[i] + a; break;
+                case 2: row[i] = src[i] + b; break;
+                case 3: row[i] = src[i] + ((a + b) >> 1); break;
+                case 4: row[i] = src[i] + paeth(a, b, c); break;
+                default: throw new Error(`Bad PNG filter ${filter}`);
+            }
+        }
+    }
+
+    // Expand to RGB over a white background
+    let rgb = new Uint8Array(width * height * 3),
+        over = (v, a) => ((v * a + 255 * (255 - a)) / 255) | 0;
+    for (let p = 0, s = 0, d = 0; p < width * height; p++, s += bpp, d += 3) {
+        let r, g, b, a = 255;
+        switch (type) {
+            case 0: r = g = b = pixels[s]; break;
+            case 2: r = pixels[s]; g = pixels[s + 1]; b = pixels[s + 2]; break;
+            case 3:
+                r = palette[pixels[s] * 3]; g = palette[pixels[s] * 3 + 1]; b = palette[pixels[s] * 3 + 2];
+                a = alpha?.[pixels[s]] ?? 255;
+                break;
+            case 4: r = g = b = pixels[s]; a = pixels[s + 1]; break;
+            case 6: r = pixels[s]; g = pixels[s + 1]; b = pixels[s + 2]; a = pixels[s + 3]; break;
+        }
+        rgb[d] = over(r, a);
+        rgb[d + 1] = over(g, a);
+        rgb[d + 2] = over(b, a);
+    }
+
+    return { width, height, rgb };
+}
@@ -0,0 +1,264 @@
+// Adds restart markers to baseline JPEGs, losslessly, so the firmware can
+// split decoding between both of its cores (see firmware/src/jpeg_decoder.cpp)
+//
+// The scan is re-encoded with one restart interval per MCU row: RSTn after
+// every row, DC predictors reset. AC codes are copied bit for bit; only the
+// DC differences change. If the image's own DC tables can't code every
+// difference category, they're replaced with the standard ones (ITU T.81
+// Annex K). Anything else (progressive, multi-scan, already restartable or
+// malformed) is returned untouched.
+
+// Standard DC tables: code counts per length 1-16, then symbols
+const STANDARD_DC = [
+    [[0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0], [0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11]],
+    [[0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0], [0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11]],
+];
+
+// Largest DC difference category for 8-bit samples
+const DC_CATEGORIES = 12;
+
+// Decoding lookup (16-bit peek -> length << 8 | symbol) and encoding codes
+function buildTable(counts, values) {
+    let lookup = new Uint16Array(1 << 16),
+        codes = new Uint16Array(256),
+        sizes = new Uint8Array(256),
+        code = 0, k = 0;
+    for (let len = 1; len <= 16; len++) {
+        for (let i = 0; i < counts[len - 1]; i++, k++, code++) {
+            if (code >= 1 << len)
+                return;
+            let first = code << (16 - len);
+            lookup.fill((len << 8) | values[k], first, first + (1 << (16 - len)));
+            codes[values[k]] = code;
+            sizes[values[k]] = len;
+        }
+        code <<= 1;
+    }
+    return { counts, values, lookup, codes, sizes };
+}
+
+// Bits needed for a DC difference
+const category = (v) => (v ? 32 - Math.clz32(Math.abs(v)) : 0);
+
+// Big-endian word
+const word = (data, pos) => (data[pos] << 8) | data[pos + 1];
+
+// Re-encode a baseline JPEG with a restart marker after every MCU row
+export function addRestartMarkers(jpeg) {
+    if (jpeg[0] != 0xFF || jpeg[1] != 0xD8)
+        return jpeg;
+
+    // Headers up to the start of scan
+    let pos = 2, keep = [], tables = {}, frame, scan;
+    while (!scan) {
+        if (pos + 4 > jpeg.length || jpeg[pos] != 0xFF)
+            return jpeg;
+        let marker = jpeg[pos + 1];
+        if (marker == 0xFF) {
+            pos++;
+            continue;
+        }
+        let end = pos + 2 + word(jpeg, pos + 2),
+            body = jpeg.subarray(pos + 4, end);
+        if (end > jpeg.length)
+            return jpeg;
+
+        if (marker == 0xC0 || marker == 0xC1) {
+            let count = body[5], components = [];
+            for (let i = 0; i < count; i++)
+                components.push({ id: body[6 + i * 3], h: body[7 + i * 3] >> 4, v: body[7 + i * 3] & 15 });
+            frame = { height: word(body, 1), width: word(body, 3), components };
+        } else if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            return jpeg;
+        } else if (marker == 0xC4) {
+            // Tables are written back (possibly replaced) just before the scan
+            for (let p = 0; p < body.length;) {
+                let counts = [...body.subarray(p + 1, p + 17)],
+                    total = counts.reduce((a, b) => a + b, 0),
+                    table = buildTable(counts, [...body.subarray(p + 17, p + 17 + total)]);
+                if (!table)
+                    return jpeg;
+                tables[body[p]] = table;
+                p += 17 + total;
+            }
+        } else if (marker == 0xDD) {
+            if (word(body, 0))
+                return jpeg;
+        } else if (marker == 0xDA) {
+            let count = body[0];
+            if (!frame || count != frame.components.length)
+                return jpeg;
+            scan = frame.components.map((c, i) => ({
+                ...c,
+                dc: body[2 + i * 2] >> 4,
+                ac: body[2 + i * 2] & 15,
+            }));
+            if (scan.some((c, i) => c.id != body[1 + i * 2] || !tables[c.dc] || !tables[0x10 | c.ac]))
+                return jpeg;
+        }
+        if (marker != 0xC4 && marker != 0xDD && marker != 0xDA)
+            keep.push(jpeg.subarray(pos, end));
+        if (marker == 0xDA)
+            keep.push(null, jpeg.subarray(pos, end)); // Tables and DRI go here
+        pos = end;
+    }
+
+    // DC tables that can't code every category get the standard ones for
+    // the output (the input is still decoded with the originals)
+    let output = { ...tables };
+    for (const c of scan) {
+        for (let s = 0; s < DC_CATEGORIES; s++) {
+            if (!tables[c.dc].sizes[s]) {
+                output[c.dc] = buildTable(...STANDARD_DC[c.dc ? 1 : 0]);
+                break;
+            }
+        }
+    }
+
+    // MCU layout: single-component scans aren't interleaved
+    let hMax = Math.max(...scan.map((c) => c.h)),
+        vMax = Math.max(...scan.map((c) => c.v));
+    if (scan.length == 1)
+        scan[0].h = scan[0].v = hMax = vMax = 1;
+    let mcusX = Math.ceil(frame.width / (8 * hMax)),
+        mcusY = Math.ceil(frame.height / (8 * vMax));
+
+    // Bit reader over the scan, unstuffing 0xFF00 and feeding zeros at markers
+    let bits = 0, bitCount = 0, atMarker = false;
+    const fill = () => {
+        while (bitCount <= 24) {
+            let b = 0;
+            if (!atMarker && pos < jpeg.length) {
+                b = jpeg[pos];
+                if (b != 0xFF)
+                    pos++;
+                else if (jpeg[pos + 1] == 0)
+                    pos += 2;
+                else {
+                    atMarker = true;
+                    b = 0;
+                }
+            }
+            bits = (bits | (b << (24 - bitCount))) >>> 0;
+            bitCount += 8;
+        }
+    };
+    const receive = (n) => {
+        if (bitCount < n)
+            fill();
+        let v = bits >>> (32 - n);
+        bits = (bits << n) >>> 0;
+        bitCount -= n;
+        return v;
+    };
+    const decode = (table) => {
+        if (bitCount < 16)
+            fill();
+        let hit = table.lookup[bits >>> 16];
+        if (!hit)
+            throw new Error("Invalid Huffman code");
+        bits = (bits << (hit >> 8)) >>> 0;
+        bitCount -= hit >> 8;
+        return hit & 0xFF;
+    };
+
+    // Bit writer, stuffing 0xFF
+    let out = new Uint8Array(jpeg.length + (jpeg.length >> 3) + mcusY * 2 + 1024),
+        length = 0, acc = 0, accBits = 0;
+    const byte = (b) => {
+        if (length >= out.length - 2) {
+            let grown = new Uint8Array(out.length * 2);
+            grown.set(out);
+            out = grown;
+        }
+        out[length++] = b;
+    };
+    const put = (value, n) => {
+        acc = ((acc << n) | value) & 0xFFFFFF;
+        accBits += n;
+        while (accBits >= 8) {
+            accBits -= 8;
+            let b = (acc >> accBits) & 0xFF;
+            byte(b);
+            if (b == 0xFF)
+                byte(0);
+        }
+    };
+    const putCode = (table, symbol) => put(table.codes[symbol], table.sizes[symbol]);
+
+    try {
+        let predictIn = scan.map(() => 0), predictOut = scan.map(() => 0);
+        for (let my = 0; my < mcusY; my++) {
+            // Restart: pad with ones, write RSTn, reset the predictors
+            if (my) {
+                if (accBits)
+                    put((1 << (8 - accBits)) - 1, 8 - accBits);
+                byte(0xFF);
+                byte(0xD0 + ((my - 1) & 7));
+                predictOut.fill(0);
+            }
+            for (let mx = 0; mx < mcusX; mx++) {
+                scan.forEach((c, i) => {
+                    let dcIn = tables[c.dc], dcOut = output[c.dc], ac = tables[0x10 | c.ac];
+                    for (let b = 0; b < c.h * c.v; b++) {
+                        // DC: absolute value in, difference against the new
+                        // predictor out
+                        let s = decode(dcIn), diff = 0;
+                        if (s > 11)
+                            throw new Error("Invalid DC category");
+                        if (s) {
+                            diff = receive(s);
+                            if (diff < 1 << (s - 1))
+                                diff -= (1 << s) - 1;
+                        }
+                        predictIn[i] += diff;
+                        diff = predictIn[i] - predictOut[i];
+                        predictOut[i] = predictIn[i];
+                        s = category(diff);
+                        putCode(dcOut, s);
+                        if (s)
+                            put(diff < 0 ? diff + (1 << s) - 1 : diff, s);
+
+                        // AC: copied code for code
+                        for (let k = 1; k < 64;) {
+                            let rs = decode(ac), size = rs & 15;
+                            putCode(ac, rs);
+                            if (!size) {
+                                if ((rs >> 4) != 15)
+                                    break;
+                                k += 16;
+                                continue;
+                            }
+                            k += (rs >> 4) + 1;
+                            if (k > 64)
+                                throw new Error("Coefficient out of range");
+                            put(receive(size), size);
+                        }
+                    }
+                });
+            }
+        }
+        if (accBits)
+            put((1 << (8 - accBits)) - 1, 8 - accBits);
+    } catch (e) {
+        return jpeg;
+    }
+
+    // Headers, then the tables and restart interval just before the scan
+    let dht = [0xFF, 0xC4, 0, 0];
+    for (const [id, table] of Object.entries(output))
+        dht.push(Number(id), ...table.counts, ...table.values);
+    dht[2] = (dht.length - 2) >> 8;
+    dht[3] = (dht.length - 2) & 0xFF;
+    let dri = [0xFF, 0xDD, 0, 4, mcusX >> 8, mcusX & 0xFF];
+
+    let parts = [jpeg.subarray(0, 2)];
+    for (const part of keep)
+        parts.push(part ?? new Uint8Array([...dht, ...dri]));
+    parts.push(out.subarray(0, length), new Uint8Array([0xFF, 0xD9]));
+
+    let result = new Uint8Array(parts.reduce((n, p) => n + p.length, 0));
+    for (let i = 0, offset = 0; i < parts.length; offset += parts[i++].length)
+        result.set(parts[i], offset);
+    return result;
+}
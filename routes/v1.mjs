@@ -1,9 +1,27 @@
 import { Hono } from 'hono';
 import puppeteer from "@cloudflare/puppeteer";
 import { basicAuth } from 'hono/basic-auth';
+import { etag } from 'hono/etag';
 import allProviders from '../providers/index.mjs';
 import getBrowserSession from './libs/browser.mjs';
 import { patch } from './libs/patches.mjs';
+import { packBundle, FRAME_NO_DITHERING, FRAME_BILEVEL, FRAME_DITHER_SHIFT } from './libs/bundle.mjs';
+import { DITHER_MODES, parseMode, parseTone } from './libs/dither.mjs';
+import {
+    CONTENT_TYPE as FRAMEBUFFER_TYPE,
+    DELTA_CONTENT_TYPE,
+    parseAccept,
+    packFrame,
+    lz4Block,
+    frameId,
+    saveBase,
+    loadBase,
+    packDelta
+} from './libs/framebuffer.mjs';
+import { decodePng } from './libs/raster.mjs';
+import { CONTENT_TYPE as QOI_TYPE, acceptsQoi, encodeQoi, decodeQoi } from './libs/qoi.mjs';
+import { CONTENT_TYPE as DISPLAY_LIST_TYPE, acceptsDisplayList } from './libs/display_list.mjs';
+import { addRestartMarkers } from './libs/restart.mjs';
 import {
     transform,
     getFallbackResponse,
@@ -43,6 +61,134 @@ v1.use("/*", async (c, next) => {
     return basicAuth(...users.map(([username, password]) => ({ username, password })))(c, next)
 });
 
+// Dither mode a render asks for: X-Inky-Dither, or none with X-No-Dithering
+function ditherMode(headers) {
+    if (headers.get('X-No-Dithering') == 'true')
+        return 'none';
+    return parseMode(headers.get('X-Inky-Dither'));
+}
+
+// Does a render ask for the panel's 1-bit mode (X-Inky-Mode: 1bit)?
+function bilevel(headers) {
+    return headers.get('X-Inky-Mode') == '1bit';
+}
+
+// Bundle frame flags for a render's dithering and panel mode; 0 keeps the
+// device defaults
+function frameFlags(headers) {
+    let flags = bilevel(headers) ? FRAME_BILEVEL : 0;
+    if (headers.get('X-No-Dithering') != 'true' && !headers.has('X-Inky-Dither'))
+        return flags;
+    let mode = ditherMode(headers);
+    return flags | (mode == 'none' ? FRAME_NO_DITHERING : DITHER_MODES.indexOf(mode) << FRAME_DITHER_SHIFT);
+}
+
+// Tag renders with a hash of their body; devices send it back as If-None-Match
+// and get a 304 (no body, no refresh) when the image hasn't changed
+v1.use('/render/*', etag());
+
+// Give JPEG renders a restart marker per MCU row, so devices can decode them
+// on both cores; set RESTART_MARKERS to "false" to send them as rendered
+v1.use('/render/*', async (c, next) => {
+    await next();
+
+    if (c.env.RESTART_MARKERS == 'false' || c.res.status != 200)
+        return;
+    if (!String(c.res.headers.get('Content-Type')).startsWith('image/jp'))
+        return;
+
+    let headers = new Headers(c.res.headers),
+        jpeg = new Uint8Array(await c.res.arrayBuffer());
+    headers.delete('Content-Length');
+
+    // Drop the old response first so its headers aren't merged back in
+    c.res = undefined;
+    c.res = new Response(addRestartMarkers(jpeg), { headers });
+});
+
+// Devices that advertise their framebuffer layout (X-Inky-Framebuffer) get the
+// image pre-dithered and packed for the panel instead of a JPEG (or QOI) to
+// decode. Packed frames are 3-bit gray; renders for the 1-bit mode are left
+// for the device to threshold.
+v1.use('/render/*', async (c, next) => {
+    await next();
+
+    let accept = parseAccept(c.req.header('X-Inky-Framebuffer')),
+        type = String(c.res.headers.get('Content-Type')),
+        qoi = type == QOI_TYPE;
+    if (!accept || c.res.status != 200 || bilevel(c.res.headers))
+        return;
+    if (!qoi && !(c.env.IMAGES && type.startsWith('image/jp')))
+        return;
+
+    let headers = new Headers(c.res.headers),
+        image = await c.res.arrayBuffer(),
+        body = image;
+    headers.delete('Content-Length');
+    headers.append('Vary', 'X-Inky-Framebuffer, X-Inky-Tone');
+    try {
+        // QOI is decoded here; Workers can't decode JPEG themselves, so the
+        // Images binding turns it into a PNG, which can be inflated here
+        let pixels = qoi ? decodeQoi(image) : await decodePng(await (await c.env.IMAGES.input(new Blob([image]).stream())
+            .output({ format: 'image/png' })).response().arrayBuffer());
+        // The device's own tone curve (X-Inky-Tone on the request), unless
+        // the render picked another
+        let tone = parseTone(headers.get('X-Inky-Tone'), parseTone(c.req.header('X-Inky-Tone'))),
+            fb = packFrame(pixels, accept, ditherMode(headers), tone);
+        body = lz4Block(fb);
+        headers.set('Content-Type', FRAMEBUFFER_TYPE);
+
+        // Send only the changed tiles when the device's base frame is still
+        // cached and that is actually smaller; otherwise send the full frame
+        // and keep it as the device's next base
+        if (accept.delta) {
+            let origin = new URL(c.req.url).origin,
+                base = await loadBase(origin, c.req.header('X-Inky-Base'), fb.byteLength),
+                delta = base && packDelta(base, fb, accept);
+            if (delta && delta.byteLength < body.byteLength) {
+                body = delta;
+                headers.set('Content-Type', DELTA_CONTENT_TYPE);
+            } else {
+                let id = await frameId(fb);
+                headers.set('X-Inky-Frame', id);
+                c.executionCtx.waitUntil(saveBase(origin, id, fb));
+            }
+            headers.append('Vary', 'X-Inky-Base');
+        }
+    } catch (e) {
+        // Keep the image; the device decodes it itself
+        console.trace(e);
+    }
+
+    // Drop the old response first so its headers aren't merged back in
+    c.res = undefined;
+    c.res = new Response(body, { headers });
+});
+
+// Let any render pick its dithering with ?dither=<mode>, its tone curve with
+// ?tone=<black=..,white=..,gamma=..> and the panel's 1-bit mode with
+// ?panel=1bit (or 3bit to turn it off), passed on to the device (or the packer
+// above) as X-Inky-Dither, X-Inky-Tone and X-Inky-Mode
+v1.use('/render/*', async (c, next) => {
+    await next();
+
+    let mode = c.req.query('dither'),
+        tone = c.req.query('tone'),
+        panel = c.req.query('panel');
+    if ((!mode && !tone && !panel) || c.res.status != 200)
+        return;
+    // Fetched responses have immutable headers; copy before setting
+    let res = new Response(c.res.body, c.res);
+    if (mode)
+        res.headers.set('X-Inky-Dither', parseMode(mode));
+    if (tone)
+        res.headers.set('X-Inky-Tone', tone);
+    if (panel)
+        res.headers.set('X-Inky-Mode', panel == '1bit' ? '1bit' : '3bit');
+    c.res = undefined;
+    c.res = res;
+});
+
 // Create an AI slop endpoint
 v1.get('/_internal/ai-slop/:token?', async (c) => {
     if (c.env.SLOP_ACCESS_TOKEN !== c.req.param('token')) {
@@ -199,6 +345,24 @@ v1.get('/render/:providers?/:raw?', async (c) => {
             // Handle Browser Rendering calls
             case "render":
             case "remote":
+                // Devices that draw display lists get one instead of a
+                // screenshot, when the provider can lay its content out as
+                // one; no browser needed
+                if (provider.displayList && acceptsDisplayList(c.req.header('Accept'))) {
+                    let list = await provider.displayList(data, _mode, c);
+                    return new Response(list.encode(), {
+                        headers: new Headers([
+                            ["Content-Type", DISPLAY_LIST_TYPE],
+                            ["Vary", "Accept"],
+                            ["X-Image-Size", `${_mode.w}x${_mode.h}`],
+                            ["X-Image-Provider", _provider],
+                            // Nothing but black and white: the faster mode
+                            ...(list.bilevel ? [["X-Inky-Mode", "1bit"]] : []),
+                            ...(await provider.headers?.(data, _mode, c.env) ?? []),
+                        ]),
+                    });
+                }
+
                 // Create a browser session
                 let _browser;
                 try {
@@ -238,13 +402,16 @@ v1.get('/render/:providers?/:raw?', async (c) => {
                     /* Falling back to page */
                 }
 
-                // Take a screenshot
-                let screenshot = (await $target.screenshot(Object.assign({
-                    type: "jpeg", // Always use jpeg
-                    quality: 100,
-                    omitBackground: true,
-                    optimizeForSpeed: true,
-                }, (await provider?.options?.(_mode, c) ?? {}))));
+                // Take a screenshot; lossless for devices that accept QOI
+                // (text and flat colors), JPEG otherwise
+                let qoi = acceptsQoi(c.req.header('Accept')),
+                    screenshot = (await $target.screenshot(Object.assign(
+                        qoi ? { type: "png" } : { type: "jpeg", quality: 100 },
+                        {
+                            omitBackground: true,
+                            optimizeForSpeed: true,
+                        },
+                        (await provider?.options?.(_mode, c) ?? {}))));
 
                 // Disconnect or close the browser to free up resources
                 await (c?.env?.USE_BROWSER_SESSIONS === "true"
@@ -253,9 +420,10 @@ v1.get('/render/:providers?/:raw?', async (c) => {
                 );
 
                 // Take the screenshot + return to the client
-                return new Response(screenshot, {
+                return new Response(qoi ? encodeQoi(await decodePng(screenshot)) : screenshot, {
                     headers: new Headers([
-                        ["Content-Type", "image/jpeg"],
+                        ["Content-Type", qoi ? QOI_TYPE : "image/jpeg"],
+                        ["Vary", "Accept"],
                         ["X-Image-Size", `${_mode.w}x${_mode.h}`],
                         ["X-Image-Provider", _provider],
                         ...(await provider.headers?.(data, _mode, c.env) ?? []),
@@ -271,5 +439,73 @@ v1.get('/render/:providers?/:raw?', async (c) => {
     }
 });
 
+// Bundle endpoint; renders the frames for a device's upcoming wakes in one
+// response so it can show them later without turning the radio on
+v1.post('/bundle', async (c) => {
+    let body;
+    try {
+        body = await c.req.json();
+    } catch {
+        return c.json({ error: "Invalid JSON body" }, 400);
+    }
+
+    let _base = new URL(c.req.raw.url),
+        _frames = Array.isArray(body?.frames) ? body.frames.slice(0, 255) : [],
+        _budget = parseInt(body?.budget ?? 0) || Infinity,
+        _used = 8,
+        _stopped,
+        frames = [];
+
+    // Render each wake's endpoint through the regular render route, in order,
+    // stopping at the first frame that fails or doesn't fit the device's budget
+    for (const { at, endpoint } of _frames) {
+        if (!Number.isInteger(at) || typeof endpoint != "string" || !endpoint.startsWith("/render")) {
+            _stopped = "invalid frame";
+            break;
+        }
+
+        let url = new URL(`/api/v1${endpoint}`, _base.origin);
+        for (const key of ["w", "h", "mbh", "dither", "panel"])
+            if (_base.searchParams.has(key))
+                url.searchParams.set(key, _base.searchParams.get(key));
+
+        let res = await fetch(url, {
+            headers: [
+                ["Authorization", c.req.header("Authorization") ?? ""],
+                ["User-Agent", c.req.header("User-Agent") ?? "Inky Renderer/v0.0.1-dev.1"],
+            ],
+        });
+        if (!res.ok || !String(res.headers.get("Content-Type")).startsWith("image/jp")) {
+            _stopped = `render failed (${res.status})`;
+            break;
+        }
+
+        let data = new Uint8Array(await res.arrayBuffer());
+        if (_used + 12 + data.byteLength > _budget) {
+            _stopped = `over budget: ${12 + data.byteLength} bytes, ${_budget - _used} left`;
+            break;
+        }
+        _used += 12 + data.byteLength;
+
+        frames.push({
+            epoch: at,
+            flags: frameFlags(res.headers),
+            data,
+        });
+    }
+
+    // Short bundles mean more wakes with the radio on; say why
+    if (_stopped)
+        console.warn(`Bundle: ${frames.length}/${_frames.length} frames, ${_stopped} at ${_frames[frames.length]?.endpoint}`);
+
+    return new Response(packBundle(frames), {
+        headers: new Headers([
+            ["Content-Type", "application/x-inky-bundle"],
+            ["X-Bundle-Frames", String(frames.length)],
+            ...(_stopped ? [["X-Bundle-Stopped", _stopped]] : []),
+        ]),
+    });
+});
+
 // Export v1
 export { v1 as default, v1 };
\ No newline at end of file